@@ -0,0 +1,323 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! Times parsing, conversion and rendering of each SVG file in a corpus.
+//!
+//! Run via `cargo bench --bench render -- [OPTIONS] [FILTER]`.
+//! See `HELP` for details.
+
+use std::collections::HashMap;
+use std::fs;
+use std::io::Write;
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+
+const HELP: &str = "\
+Times parsing, conversion and rendering of each SVG file in a corpus.
+
+Results are printed to stdout as CSV with the following columns:
+file,width,parse_ms,convert_ms,render_ms
+
+Each value is the minimal time across all iterations.
+
+USAGE:
+  cargo bench --bench render -- [OPTIONS] [FILTER]
+
+OPTIONS:
+  --dir PATH              A directory with SVG files. Can be set multiple times
+                          [default: tests/svg]
+  --sizes LIST            Comma-separated image widths [default: 300]
+  --iterations N          The number of iterations per file [default: 5]
+  --baseline PATH         A previous CSV output to compare with
+  --threshold PERCENT     A slowdown that is reported as a regression [default: 10]
+  --min-time MS           Ignores regressions of faster phases [default: 0.5]
+
+ARGS:
+  FILTER                  Benchmarks only files which names contain this string
+";
+
+struct Args {
+    dirs: Vec<PathBuf>,
+    sizes: Vec<u32>,
+    iterations: usize,
+    baseline: Option<PathBuf>,
+    threshold: f64,
+    min_time: f64,
+    filter: Option<String>,
+}
+
+/// Results of a single file at a single size, in milliseconds.
+#[derive(Clone, Copy)]
+struct Timings {
+    parse: f64,
+    convert: f64,
+    render: f64,
+}
+
+fn main() {
+    let args = match parse_args() {
+        Ok(args) => args,
+        Err(e) => {
+            eprintln!("Error: {}.", e);
+            std::process::exit(1);
+        }
+    };
+
+    let opt = options();
+    let renderer = resvg::Renderer::default();
+
+    let mut results = Vec::new();
+    let stdout = std::io::stdout();
+    let mut out = stdout.lock();
+    writeln!(out, "file,width,parse_ms,convert_ms,render_ms").unwrap();
+
+    for path in collect_files(&args) {
+        let name = path.file_stem().unwrap().to_string_lossy().to_string();
+        let text = match fs::read_to_string(&path) {
+            Ok(text) => text,
+            Err(_) => continue,
+        };
+
+        // Images are referenced relative to the file.
+        let mut file_opt = opt.clone();
+        file_opt.resources_dir = path.parent().map(|p| p.to_path_buf());
+
+        for &width in &args.sizes {
+            if let Some(timings) = bench_file(&text, width, args.iterations, &file_opt, &renderer) {
+                writeln!(out, "{},{},{:.3},{:.3},{:.3}",
+                         name, width, timings.parse, timings.convert, timings.render).unwrap();
+                results.push(((name.clone(), width), timings));
+            }
+        }
+
+        // Render scratch buffers depend on the image size and are not needed for the next file.
+        renderer.clear_cache();
+    }
+
+    if let Some(ref path) = args.baseline {
+        let baseline = match load_results(path) {
+            Ok(v) => v,
+            Err(e) => {
+                eprintln!("Error: failed to load the baseline cause {}.", e);
+                std::process::exit(1);
+            }
+        };
+
+        if !compare(&results, &baseline, args.threshold, args.min_time) {
+            std::process::exit(1);
+        }
+    }
+}
+
+fn parse_args() -> Result<Args, String> {
+    let mut input = pico_args::Arguments::from_env();
+
+    if input.contains(["-h", "--help"]) {
+        print!("{}", HELP);
+        std::process::exit(0);
+    }
+
+    // Passed by `cargo bench`.
+    input.contains("--bench");
+
+    let mut dirs = Vec::new();
+    while let Some(dir) = input.opt_value_from_str::<_, PathBuf>("--dir").map_err(|e| e.to_string())? {
+        dirs.push(dir);
+    }
+
+    if dirs.is_empty() {
+        dirs.push(PathBuf::from("tests/svg"));
+    }
+
+    let sizes: String = input.opt_value_from_str("--sizes").map_err(|e| e.to_string())?
+        .unwrap_or_else(|| "300".to_string());
+    let sizes = sizes.split(',')
+        .map(|s| s.trim().parse::<u32>().ok().filter(|n| *n > 0))
+        .collect::<Option<Vec<_>>>()
+        .ok_or_else(|| "invalid sizes".to_string())?;
+
+    let args = Args {
+        dirs,
+        sizes,
+        iterations: input.opt_value_from_str("--iterations").map_err(|e| e.to_string())?
+            .unwrap_or(5).max(1),
+        baseline: input.opt_value_from_str("--baseline").map_err(|e| e.to_string())?,
+        threshold: input.opt_value_from_str("--threshold").map_err(|e| e.to_string())?
+            .unwrap_or(10.0),
+        min_time: input.opt_value_from_str("--min-time").map_err(|e| e.to_string())?
+            .unwrap_or(0.5),
+        filter: input.opt_free_from_str().map_err(|e| e.to_string())?,
+    };
+
+    Ok(args)
+}
+
+/// Uses the same fonts as the regression tests, so results don't depend on system fonts.
+fn options() -> usvg::Options {
+    let mut opt = usvg::Options::default();
+    opt.font_family = "Noto Sans".to_string();
+    opt.fontdb_mut().load_fonts_dir("tests/fonts");
+    opt.fontdb_mut().set_serif_family("Noto Serif");
+    opt.fontdb_mut().set_sans_serif_family("Noto Sans");
+    opt.fontdb_mut().set_cursive_family("Yellowtail");
+    opt.fontdb_mut().set_fantasy_family("Sedgwick Ave Display");
+    opt.fontdb_mut().set_monospace_family("Noto Mono");
+    opt
+}
+
+fn collect_files(args: &Args) -> Vec<PathBuf> {
+    let mut files = Vec::new();
+    for dir in &args.dirs {
+        let entries = match fs::read_dir(dir) {
+            Ok(v) => v,
+            Err(_) => {
+                eprintln!("Warning: failed to read '{}'.", dir.display());
+                continue;
+            }
+        };
+
+        for entry in entries.flatten() {
+            let path = entry.path();
+            if path.extension().and_then(|e| e.to_str()) != Some("svg") {
+                continue;
+            }
+
+            if let Some(ref filter) = args.filter {
+                if !path.file_stem().unwrap().to_string_lossy().contains(filter.as_str()) {
+                    continue;
+                }
+            }
+
+            files.push(path);
+        }
+    }
+
+    // Directory entries order is not defined.
+    files.sort();
+    files
+}
+
+fn bench_file(
+    text: &str,
+    width: u32,
+    iterations: usize,
+    opt: &usvg::Options,
+    renderer: &resvg::Renderer,
+) -> Option<Timings> {
+    let mut xml_opt = roxmltree::ParsingOptions::default();
+    xml_opt.allow_dtd = true;
+
+    let mut parse = Duration::from_secs(u64::MAX);
+    let mut convert = parse;
+    let mut render = parse;
+
+    for _ in 0..iterations {
+        let now = Instant::now();
+        let doc = roxmltree::Document::parse_with_options(text, xml_opt).ok()?;
+        parse = parse.min(now.elapsed());
+
+        let now = Instant::now();
+        let tree = usvg::Tree::from_xmltree(&doc, opt).ok()?;
+        convert = convert.min(now.elapsed());
+        drop(doc);
+
+        let fit_to = usvg::FitTo::Width(width);
+        let size = fit_to.fit_to(tree.svg_node().size.to_screen_size())?;
+        let mut pixmap = tiny_skia::Pixmap::new(size.width(), size.height())?;
+
+        let now = Instant::now();
+        renderer.render(&tree, fit_to, pixmap.as_mut())?;
+        render = render.min(now.elapsed());
+    }
+
+    Some(Timings {
+        parse: to_ms(parse),
+        convert: to_ms(convert),
+        render: to_ms(render),
+    })
+}
+
+fn to_ms(d: Duration) -> f64 {
+    d.as_secs_f64() * 1000.0
+}
+
+fn load_results(path: &Path) -> Result<HashMap<(String, u32), Timings>, String> {
+    let text = fs::read_to_string(path).map_err(|e| e.to_string())?;
+
+    let mut results = HashMap::new();
+    // Skip the header.
+    for line in text.lines().skip(1) {
+        let cols: Vec<&str> = line.split(',').collect();
+        if cols.len() != 5 {
+            return Err(format!("malformed line '{}'", line));
+        }
+
+        let parse_err = || format!("malformed line '{}'", line);
+        let width = cols[1].parse().map_err(|_| parse_err())?;
+        let timings = Timings {
+            parse: cols[2].parse().map_err(|_| parse_err())?,
+            convert: cols[3].parse().map_err(|_| parse_err())?,
+            render: cols[4].parse().map_err(|_| parse_err())?,
+        };
+
+        results.insert((cols[0].to_string(), width), timings);
+    }
+
+    Ok(results)
+}
+
+/// Prints regressions to stderr.
+///
+/// Returns `false` when at least one regression was found.
+fn compare(
+    results: &[((String, u32), Timings)],
+    baseline: &HashMap<(String, u32), Timings>,
+    threshold: f64,
+    min_time: f64,
+) -> bool {
+    let mut total_new = 0.0;
+    let mut total_old = 0.0;
+    let mut regressions = 0;
+    for (key, new) in results {
+        let old = match baseline.get(key) {
+            Some(v) => v,
+            None => continue,
+        };
+
+        // The C API benchmark cannot measure the conversion separately,
+        // so it reports a zero conversion time and includes it in the parsing one.
+        let mut phases = Vec::with_capacity(3);
+        if old.convert == 0.0 || new.convert == 0.0 {
+            phases.push(("parse+convert", old.parse + old.convert, new.parse + new.convert));
+        } else {
+            phases.push(("parse", old.parse, new.parse));
+            phases.push(("convert", old.convert, new.convert));
+        }
+        phases.push(("render", old.render, new.render));
+
+        for &(phase, old, new) in &phases {
+            total_old += old;
+            total_new += new;
+
+            // Very fast phases are too noisy.
+            if new < min_time || old <= 0.0 {
+                continue;
+            }
+
+            let diff = (new - old) / old * 100.0;
+            if diff > threshold {
+                eprintln!("Regression: {} at {}px, {}: {:.3}ms -> {:.3}ms (+{:.1}%)",
+                          key.0, key.1, phase, old, new, diff);
+                regressions += 1;
+            }
+        }
+    }
+
+    if total_old > 0.0 {
+        eprintln!("Total: {:.1}ms -> {:.1}ms ({:+.1}%)",
+                  total_old, total_new, (total_new - total_old) / total_old * 100.0);
+    }
+
+    regressions == 0
+}
@@ -23,11 +23,14 @@
 #include <QFileInfo>
 #include <QGuiApplication>
 #include <QImage>
+#include <QList>
+#include <QRect>
 #include <QRectF>
 #include <QScopedPointer>
 #include <QScreen>
 #include <QString>
 #include <QTransform>
+#include <QVector>
 
 #include <resvg.h>
 
@@ -67,6 +70,99 @@ private:
     }
 };
 
+static resvg_fit_to fitTo(const QSize &size)
+{
+    resvg_fit_to fit_to = { RESVG_FIT_TO_ORIGINAL, 1 };
+    if (size.isValid()) {
+        // TODO: support height too.
+        fit_to.type = RESVG_FIT_TO_WIDTH;
+        fit_to.value = size.width();
+    }
+
+    return fit_to;
+}
+
+static QImage createImage(const QSize &size)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // QImage::Format_ARGB32_Premultiplied is stored as BGRA on little-endian machines.
+    return QImage(size, QImage::Format_ARGB32_Premultiplied);
+#else
+    return QImage(size, QImage::Format_RGBA8888_Premultiplied);
+#endif
+}
+
+// The image must be created via createImage().
+static resvg_render_target imageToTarget(QImage &qImg, const resvg_fit_to fit_to)
+{
+    resvg_render_target target;
+    target.fit_to = fit_to;
+    target.width = qImg.width();
+    target.height = qImg.height();
+    target.stride = qImg.bytesPerLine();
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    target.format = RESVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED;
+#else
+    target.format = RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED;
+#endif
+    target.data = (char*)qImg.bits();
+    return target;
+}
+
+// Returns false when the format cannot be rendered directly.
+static bool toPixelFormat(const QImage::Format format, resvg_pixel_format &pixelFormat)
+{
+    switch (format) {
+        case QImage::Format_RGBA8888_Premultiplied :
+            pixelFormat = RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED;
+            return true;
+        case QImage::Format_RGBA8888 :
+            pixelFormat = RESVG_PIXEL_FORMAT_RGBA8888;
+            return true;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        // Stored as BGRA on little-endian machines.
+        case QImage::Format_ARGB32_Premultiplied :
+            pixelFormat = RESVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED;
+            return true;
+        case QImage::Format_ARGB32 :
+            pixelFormat = RESVG_PIXEL_FORMAT_BGRA8888;
+            return true;
+#endif
+        default :
+            return false;
+    }
+}
+
+// Describes the `region` of a caller-owned buffer that contains an image of the `size`.
+static bool bufferToTarget(uchar *data, const QSize &size, const int bytesPerLine,
+                           const QImage::Format format, const QRect &region,
+                           resvg_render_target &target)
+{
+    if (!data || size.isEmpty() || region.isEmpty()) {
+        return false;
+    }
+
+    if (!QRect(QPoint(0, 0), size).contains(region)) {
+        return false;
+    }
+
+    const int stride = bytesPerLine > 0 ? bytesPerLine : size.width() * 4;
+    if (stride < size.width() * 4) {
+        return false;
+    }
+
+    if (!toPixelFormat(format, target.format)) {
+        return false;
+    }
+
+    target.fit_to = fitTo(size);
+    target.width = region.width();
+    target.height = region.height();
+    target.stride = stride;
+    target.data = (char*)(data + qint64(region.y()) * stride + qint64(region.x()) * 4);
+    return true;
+}
+
 static QString errorToString(const int err)
 {
     switch (err) {
@@ -84,6 +180,16 @@ static QString errorToString(const int err)
             return QLatin1String("SVG doesn't have a valid size.");
         case RESVG_ERROR_PARSING_FAILED :
             return QLatin1String("Failed to parse an SVG data.");
+        case RESVG_ERROR_INVALID_TARGET :
+            return QLatin1String("Invalid render target.");
+        case RESVG_ERROR_INVALID_BINARY :
+            return QLatin1String("Malformed binary tree data.");
+        case RESVG_ERROR_CANCELED :
+            return QLatin1String("Rendering was canceled.");
+        case RESVG_ERROR_RENDER_LIMIT_REACHED :
+            return QLatin1String("Render limits were reached.");
+        case RESVG_ERROR_TARGET_TOO_LARGE :
+            return QLatin1String("The render target is too large.");
     }
 
     Q_UNREACHABLE();
@@ -91,6 +197,131 @@ static QString errorToString(const int err)
 
 } //ResvgPrivate
 
+/**
+ * @brief A fonts database that can be shared between multiple options.
+ */
+class ResvgFontDatabase {
+public:
+    /**
+     * @brief Constructs a new, empty database.
+     */
+    ResvgFontDatabase()
+        : d(resvg_fontdb_create())
+    {
+    }
+
+    /**
+     * @brief Returns a process-wide database with system fonts.
+     *
+     * System fonts are loaded only once, on the first call.
+     * Can be called from multiple threads.
+     */
+    static const ResvgFontDatabase &system()
+    {
+        static const ResvgFontDatabase *db = [] {
+            auto db = new ResvgFontDatabase();
+            db->loadSystemFonts();
+            return db;
+        }();
+
+        return *db;
+    }
+
+    /**
+     * @brief Loads system fonts into the database.
+     *
+     * This method is very IO intensive.
+     *
+     * Has no effect after the database was set to any options.
+     */
+    void loadSystemFonts()
+    {
+        resvg_fontdb_load_system_fonts(d);
+    }
+
+    /**
+     * @brief Loads a font file into the database.
+     *
+     * Has no effect after the database was set to any options.
+     */
+    bool loadFontFile(const QString &path)
+    {
+        auto pathC = path.toUtf8();
+        pathC.append('\0');
+        return resvg_fontdb_load_font_file(d, pathC.constData()) == RESVG_OK;
+    }
+
+    /**
+     * @brief Destructs the database.
+     */
+    ~ResvgFontDatabase()
+    {
+        resvg_fontdb_destroy(d);
+    }
+
+    friend class ResvgOptions;
+
+private:
+    Q_DISABLE_COPY(ResvgFontDatabase)
+
+    resvg_fontdb * const d;
+};
+
+/**
+ * @brief A render cancellation token.
+ *
+ * Can be canceled from any thread.
+ */
+class ResvgCancelToken {
+public:
+    /**
+     * @brief Constructs a new, not canceled token.
+     */
+    ResvgCancelToken()
+        : d(resvg_cancel_token_create())
+    {
+    }
+
+    /**
+     * @brief Destructs the token.
+     */
+    ~ResvgCancelToken()
+    {
+        resvg_cancel_token_destroy(d);
+    }
+
+    /**
+     * @brief Stops all renders that use this token.
+     */
+    void cancel() const
+    {
+        resvg_cancel_token_cancel(d);
+    }
+
+    /**
+     * @brief Resets the token, so it can be used by a new render.
+     */
+    void reset() const
+    {
+        resvg_cancel_token_reset(d);
+    }
+
+    /**
+     * @brief Checks that the token was canceled.
+     */
+    bool isCanceled() const
+    {
+        return resvg_cancel_token_is_canceled(d);
+    }
+
+    friend class ResvgRenderer;
+
+private:
+    Q_DISABLE_COPY(ResvgCancelToken)
+
+    resvg_cancel_token * const d;
+};
+
 /**
  * @brief SVG parsing options.
  */
@@ -239,6 +470,49 @@ public:
         resvg_options_set_keep_named_groups(d, keep);
     }
 
+    /**
+     * @brief Sets the maximum number of threads used to render a single image.
+     *
+     * 0 indicates the number of available CPUs.
+     *
+     * Default: 1
+     */
+    void setThreads(const uint threads)
+    {
+        resvg_options_set_threads(d, threads);
+    }
+
+    /**
+     * @brief Enables a fast, approximate rendering of large blurs.
+     *
+     * Default: false
+     */
+    void setFastBlur(const bool fast)
+    {
+        resvg_options_set_fast_blur(d, fast);
+    }
+
+    /**
+     * @brief Enables dashed strokes caching between renders.
+     *
+     * Default: false
+     */
+    void setPathCache(const bool enabled)
+    {
+        resvg_options_set_path_cache(d, enabled);
+    }
+
+    /**
+     * @brief Sets a shared fonts database.
+     *
+     * Replaces the internal fonts database. Fonts loading and generic font families
+     * setting methods have no effect afterwards.
+     */
+    void setFontDatabase(const ResvgFontDatabase &db)
+    {
+        resvg_options_set_fontdb(d, db.d);
+    }
+
     /**
      * @brief Loads a font data into the internal fonts database.
      *
@@ -331,11 +605,18 @@ public:
         // Check for Qt resource path.
         if (filePath.startsWith(QLatin1String(":/"))) {
             QFile file(filePath);
-            if (file.open(QFile::ReadOnly)) {
-                return load(file.readAll(), opt);
-            } else {
+            if (!file.open(QFile::ReadOnly)) {
                 return false;
             }
+
+            // Uncompressed resources can be mapped, which doesn't copy the data.
+            // The data is not referenced after loading, so it's safe to unmap it afterwards.
+            if (const uchar *mapped = file.map(0, file.size())) {
+                const auto data = QByteArray::fromRawData((const char*)mapped, int(file.size()));
+                return load(data, opt);
+            }
+
+            return load(file.readAll(), opt);
         }
 
         d->reset();
@@ -411,6 +692,17 @@ public:
             return true;
     }
 
+    /**
+     * @brief Deallocates scratch buffers kept between renders.
+     *
+     * See #resvg_tree_clear_cache for details.
+     */
+    void clearCache()
+    {
+        if (d->tree)
+            resvg_tree_clear_cache(d->tree);
+    }
+
     /**
      * @brief Returns an SVG size.
      *
@@ -530,25 +822,195 @@ public:
      */
     QImage renderToImage(const QSize &size = QSize()) const
     {
-        resvg_fit_to fit_to = { RESVG_FIT_TO_ORIGINAL, 1 };
-        if (size.isValid()) {
-            // TODO: support height too.
-            fit_to.type = RESVG_FIT_TO_WIDTH;
-            fit_to.value = size.width();
+        auto svgSize = size;
+        if (svgSize.isEmpty()) {
+            svgSize = defaultSize();
         }
 
+        QImage qImg = ResvgPrivate::createImage(svgSize);
+        auto target = ResvgPrivate::imageToTarget(qImg, ResvgPrivate::fitTo(size));
+        // An image without the elements that exceeded the render limits is still usable.
+        const auto err = resvg_render_to_target(d->tree, &target);
+        if (err != RESVG_OK && err != RESVG_ERROR_RENDER_LIMIT_REACHED) {
+            qImg.fill(Qt::transparent);
+        }
+
+        return qImg;
+    }
+
+    /**
+     * @brief Renders the SVG data to \b QImage with a specified \b size,
+     *        unless the \b token was canceled.
+     *
+     * The same as renderToImage(), but returns a null \b QImage
+     * when the \b token was canceled during the rendering.
+     */
+    QImage renderToImage(const QSize &size, const ResvgCancelToken &token) const
+    {
+        auto svgSize = size;
+        if (svgSize.isEmpty()) {
+            svgSize = defaultSize();
+        }
+
+        QImage qImg = ResvgPrivate::createImage(svgSize);
+        auto target = ResvgPrivate::imageToTarget(qImg, ResvgPrivate::fitTo(size));
+        const auto err = resvg_render_to_target_with_control(d->tree, &target, token.d,
+                                                             nullptr, nullptr);
+        if (err == RESVG_ERROR_CANCELED) {
+            return QImage();
+        } else if (err != RESVG_OK && err != RESVG_ERROR_RENDER_LIMIT_REACHED) {
+            qImg.fill(Qt::transparent);
+        }
+
+        return qImg;
+    }
+
+    /**
+     * @brief Renders a fast, low quality preview of the SVG data to \b QImage
+     *        with a specified \b size, unless the \b token was canceled.
+     *
+     * The image is rendered at half the resolution and upscaled, anti-aliasing is disabled
+     * and raster images are scaled without smoothing,
+     * so the preview is meant to be shown only until renderToImage() is finished.
+     *
+     * Returns a null \b QImage when the \b token was canceled during the rendering.
+     */
+    QImage renderPreviewToImage(const QSize &size, const ResvgCancelToken &token) const
+    {
         auto svgSize = size;
         if (svgSize.isEmpty()) {
             svgSize = defaultSize();
         }
 
-        QImage qImg(svgSize.width(), svgSize.height(), QImage::Format_ARGB32_Premultiplied);
-        qImg.fill(Qt::transparent);
-        resvg_render(d->tree, fit_to, qImg.width(), qImg.height(), (char*)qImg.bits());
+        QImage qImg = ResvgPrivate::createImage(svgSize);
+        auto target = ResvgPrivate::imageToTarget(qImg, ResvgPrivate::fitTo(size));
+        const auto err = resvg_render_preview_to_target(d->tree, &target, token.d);
+        if (err == RESVG_ERROR_CANCELED) {
+            return QImage();
+        } else if (err != RESVG_OK && err != RESVG_ERROR_RENDER_LIMIT_REACHED) {
+            qImg.fill(Qt::transparent);
+        }
+
+        return qImg;
+    }
+
+    /**
+     * @brief Renders the SVG data to multiple \b QImage at once.
+     *
+     * Each size is handled just like in renderToImage().
+     * The size-independent work is shared between images and they are rendered
+     * in parallel, when ResvgOptions::setThreads() was set to more than one thread.
+     */
+    QList<QImage> renderToImages(const QList<QSize> &sizes) const
+    {
+        QList<QImage> images;
+        if (!d->tree || sizes.isEmpty())
+            return images;
+
+        for (const QSize &size : sizes) {
+            images.append(ResvgPrivate::createImage(size.isEmpty() ? defaultSize() : size));
+        }
+
+        QVector<resvg_render_target> targets;
+        targets.reserve(sizes.size());
+        for (int i = 0; i < sizes.size(); ++i) {
+            targets.append(ResvgPrivate::imageToTarget(images[i], ResvgPrivate::fitTo(sizes[i])));
+        }
+
+        // Images without the elements that exceeded the render limits are still usable.
+        const auto err = resvg_render_batch(d->tree, targets.constData(), targets.size());
+        if (err != RESVG_OK && err != RESVG_ERROR_RENDER_LIMIT_REACHED) {
+            for (QImage &img : images) {
+                img.fill(Qt::transparent);
+            }
+        }
+
+        return images;
+    }
+
+    /**
+     * @brief Renders a region of the SVG data to \b QImage.
+     *
+     * \b size defines the size of the whole image, just like in renderToImage(),
+     * while \b region defines the rendered part of it and the resulting image size.
+     *
+     * Rendering an image by regions requires much less memory than a full render.
+     * The resulting tiles are seamless.
+     */
+    QImage renderRegionToImage(const QRect &region, const QSize &size = QSize()) const
+    {
+        if (!d->tree || region.isEmpty())
+            return QImage();
+
+        QImage qImg = ResvgPrivate::createImage(region.size());
+        auto target = ResvgPrivate::imageToTarget(qImg, ResvgPrivate::fitTo(size));
+        // An image without the elements that exceeded the render limits is still usable.
+        const auto err = resvg_render_region(d->tree, region.x(), region.y(), &target);
+        if (err != RESVG_OK && err != RESVG_ERROR_RENDER_LIMIT_REACHED) {
+            qImg.fill(Qt::transparent);
+        }
+
+        return qImg;
+    }
+
+    /**
+     * @brief Renders the SVG data into a caller-owned pixels buffer.
+     *
+     * Allows rendering into a mapped pixel unpack buffer or a texture staging area,
+     * without an intermediate \b QImage.
+     *
+     * \b format must be QImage::Format_RGBA8888_Premultiplied, QImage::Format_RGBA8888
+     * or, on little-endian machines, QImage::Format_ARGB32_Premultiplied
+     * and QImage::Format_ARGB32. Premultiplied RGBA is the fastest one.
+     *
+     * \b bytesPerLine can include a row padding. 0 indicates no padding.
+     * Only a buffer without a padding is rendered in place. A padded one is rendered
+     * into a temporary image of the same size first and then copied row by row,
+     * which costs an additional allocation and a copy of the whole image.
+     *
+     * The buffer content is overwritten.
+     *
+     * Returns \b false when the buffer is invalid, the SVG data cannot be rendered
+     * or the buffer is larger than the render limits allow.
+     */
+    bool renderToBuffer(uchar *data, const QSize &size, int bytesPerLine,
+                        QImage::Format format) const
+    {
+        return renderRegionToBuffer(QRect(QPoint(0, 0), size), data, size, bytesPerLine, format);
+    }
+
+    /**
+     * @brief Renders a region of the SVG data into a caller-owned pixels buffer.
+     *
+     * \b data, \b size, \b bytesPerLine and \b format describe the whole image,
+     * just like in renderToBuffer(), while only the \b region pixels are overwritten.
+     *
+     * Useful for updating only the dirty tiles of a texture.
+     * The resulting tiles are seamless.
+     *
+     * Only a region that spans the whole width of a buffer without a padding
+     * is rendered in place. Any other region is rendered into a temporary image
+     * of the region size first and then copied row by row.
+     *
+     * Returns \b false when the buffer or the region is invalid, the SVG data cannot be rendered
+     * or the region is larger than the render limits allow.
+     */
+    bool renderRegionToBuffer(const QRect &region, uchar *data, const QSize &size,
+                              int bytesPerLine, QImage::Format format) const
+    {
+        if (!d->tree)
+            return false;
+
+        resvg_render_target target;
+        if (!ResvgPrivate::bufferToTarget(data, size, bytesPerLine, format, region, target))
+            return false;
+
+        const auto err = region == QRect(QPoint(0, 0), size)
+            ? resvg_render_to_target(d->tree, &target)
+            : resvg_render_region(d->tree, region.x(), region.y(), &target);
 
-        // resvg renders onto the RGBA canvas, while QImage is ARGB.
-        // std::move is required to call inplace version of rgbSwapped().
-        return std::move(qImg).rgbSwapped();
+        // An image without the elements that exceeded the render limits is still usable.
+        return err == RESVG_OK || err == RESVG_ERROR_RENDER_LIMIT_REACHED;
     }
 
     /**
@@ -0,0 +1,16 @@
+QT += core gui
+
+TARGET = bench
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+SOURCES += \
+    main.cpp
+
+LIBS += -L$$PWD/../../../target/release/ -lresvg
+
+windows:LIBS += -lWs2_32 -lAdvapi32 -lUserenv
+
+INCLUDEPATH += $$PWD/../..
+DEPENDPATH += $$PWD/../..
@@ -0,0 +1,189 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+#include <limits>
+#include <vector>
+
+#include <resvg.h>
+#include <ResvgQt.h>
+
+struct Timings
+{
+    double parse = std::numeric_limits<double>::max();
+    double render = std::numeric_limits<double>::max();
+};
+
+static double elapsedMs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1000000.0;
+}
+
+// Uses the same fonts as the regression tests, so results don't depend on system fonts.
+static void loadFonts(resvg_fontdb *db, ResvgFontDatabase &qtDb)
+{
+    const QDir dir("tests/fonts");
+    for (const auto &name : dir.entryList({ "*.ttf", "*.otf" }, QDir::Files, QDir::Name)) {
+        const auto path = dir.absoluteFilePath(name);
+        auto pathC = path.toUtf8();
+        resvg_fontdb_load_font_file(db, pathC.constData());
+        qtDb.loadFontFile(path);
+    }
+}
+
+static bool benchC(const QByteArray &data, const resvg_options *opt, int width, int iterations,
+                   Timings &timings)
+{
+    std::vector<char> pixels;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+
+        resvg_render_tree *tree = nullptr;
+        if (resvg_parse_tree_from_data(data.constData(), data.size(), opt, &tree) != RESVG_OK) {
+            return false;
+        }
+
+        timings.parse = qMin(timings.parse, elapsedMs(timer));
+
+        const auto size = resvg_get_image_size(tree);
+        const int height = qMax(1, qRound(size.height * width / size.width));
+        pixels.resize(size_t(width) * size_t(height) * 4);
+
+        resvg_render_target target;
+        target.fit_to.type = RESVG_FIT_TO_WIDTH;
+        target.fit_to.value = width;
+        target.width = width;
+        target.height = height;
+        target.stride = 0;
+        target.format = RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED;
+        target.data = pixels.data();
+
+        timer.restart();
+        const auto err = resvg_render_to_target(tree, &target);
+        timings.render = qMin(timings.render, elapsedMs(timer));
+
+        resvg_tree_destroy(tree);
+
+        if (err != RESVG_OK) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool benchQt(const QByteArray &data, const ResvgOptions &opt, int width, int iterations,
+                    Timings &timings)
+{
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+
+        ResvgRenderer renderer;
+        if (!renderer.load(data, opt)) {
+            return false;
+        }
+
+        timings.parse = qMin(timings.parse, elapsedMs(timer));
+
+        const auto size = renderer.defaultSize();
+        const int height = qMax(1, qRound(size.height() * double(width) / size.width()));
+
+        timer.restart();
+        const auto img = renderer.renderToImage(QSize(width, height));
+        timings.render = qMin(timings.render, elapsedMs(timer));
+
+        if (img.isNull()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    auto args = app.arguments();
+    args.removeFirst();
+
+    const bool useQt = args.removeAll("--qt") > 0;
+
+    int iterations = 5;
+    const int iterIdx = args.indexOf("--iterations");
+    if (iterIdx != -1 && iterIdx + 1 < args.size()) {
+        iterations = qMax(1, args.at(iterIdx + 1).toInt());
+        args.removeAt(iterIdx + 1);
+        args.removeAt(iterIdx);
+    }
+
+    if (args.isEmpty()) {
+        QTextStream(stderr) << "Usage:\n\tbench [--qt] [--iterations N] dir [width...]\n";
+        return 1;
+    }
+
+    const QDir dir(args.takeFirst());
+
+    QVector<int> widths;
+    for (const auto &arg : args) {
+        widths << arg.toInt();
+    }
+
+    if (widths.isEmpty()) {
+        widths << 300;
+    }
+
+    resvg_fontdb *db = resvg_fontdb_create();
+    ResvgFontDatabase qtDb;
+    loadFonts(db, qtDb);
+
+    resvg_options *opt = resvg_options_create();
+    resvg_options_set_font_family(opt, "Noto Sans");
+    resvg_options_set_fontdb(opt, db);
+
+    ResvgOptions qtOpt;
+    qtOpt.setFontFamily("Noto Sans");
+    qtOpt.setFontDatabase(qtDb);
+
+    QTextStream out(stdout);
+    // The same columns as in `cargo bench --bench render`.
+    // The C API cannot convert a tree separately, so the parsing time includes it
+    // and convert_ms is always zero. `cargo bench --bench render -- --baseline`
+    // compares the parsing and conversion time combined in this case.
+    out << "file,width,parse_ms,convert_ms,render_ms\n";
+
+    for (const auto &name : dir.entryList({ "*.svg" }, QDir::Files, QDir::Name)) {
+        QFile file(dir.absoluteFilePath(name));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        const auto data = file.readAll();
+        const auto dirPath = dir.absolutePath().toUtf8();
+        resvg_options_set_resources_dir(opt, dirPath.constData());
+        qtOpt.setResourcesDir(dir.absolutePath());
+
+        for (const int width : widths) {
+            Timings timings;
+            const bool ok = useQt ? benchQt(data, qtOpt, width, iterations, timings)
+                                  : benchC(data, opt, width, iterations, timings);
+            if (ok) {
+                out << QFileInfo(name).completeBaseName() << ',' << width << ','
+                    << QString::number(timings.parse, 'f', 3) << ",0.000,"
+                    << QString::number(timings.render, 'f', 3) << '\n';
+            }
+        }
+    }
+
+    resvg_options_destroy(opt);
+    resvg_fontdb_destroy(db);
+
+    return 0;
+}
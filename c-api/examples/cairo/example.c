@@ -1,6 +1,5 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <assert.h>
 #include <cairo.h>
 #include <resvg.h>
 
@@ -32,22 +31,51 @@ int main(int argc, char **argv)
 
     cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
 
-    /* resvg doesn't support stride, so cairo_surface_t should have no padding */
-    assert(cairo_image_surface_get_stride(surface) == (int)size.width * 4);
+    /*
+     * CAIRO_FORMAT_ARGB32 is a native-endian premultiplied ARGB,
+     * which is stored as BGRA on little-endian machines and as ARGB on big-endian ones.
+     * resvg doesn't support ARGB, so on big-endian machines we render RGBA
+     * and reorder the channels afterwards.
+     */
+    const int endian_check = 1;
+    const int little_endian = *(const char*)&endian_check == 1;
 
-    unsigned char *surface_data = cairo_image_surface_get_data(surface);
+    resvg_render_target target;
+    target.fit_to.type = RESVG_FIT_TO_ORIGINAL;
+    target.fit_to.value = 1;
+    target.width = width;
+    target.height = height;
+    target.stride = cairo_image_surface_get_stride(surface);
+    target.format = little_endian ? RESVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED
+                                  : RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED;
+    target.data = (char*)cairo_image_surface_get_data(surface);
 
-    resvg_fit_to fit_to = { RESVG_FIT_TO_ORIGINAL, 1 };
-    resvg_render(tree, fit_to, width, height, (char*)surface_data);
+    cairo_surface_flush(surface);
+    err = resvg_render_to_target(tree, &target);
+    if (err != RESVG_OK)
+    {
+        printf("Error id: %i\n", err);
+        abort();
+    }
 
-    /* RGBA -> BGRA */
-    for (int i = 0; i < width * height * 4; i += 4)
+    if (!little_endian)
     {
-        unsigned char r = surface_data[i + 0];
-        surface_data[i + 0] = surface_data[i + 2];
-        surface_data[i + 2] = r;
+        for (int y = 0; y < height; ++y)
+        {
+            unsigned char *p = (unsigned char*)target.data + y * target.stride;
+            for (int x = 0; x < width; ++x, p += 4)
+            {
+                unsigned char a = p[3];
+                p[3] = p[2];
+                p[2] = p[1];
+                p[1] = p[0];
+                p[0] = a;
+            }
+        }
     }
 
+    cairo_surface_mark_dirty(surface);
+
     cairo_surface_write_to_png(surface, argv[2]);
     cairo_surface_destroy(surface);
 
@@ -4,9 +4,12 @@
 
 #![allow(non_camel_case_types)]
 
-use std::ffi::CStr;
-use std::os::raw::c_char;
+use std::collections::HashMap;
+use std::ffi::{CStr, CString};
+use std::os::raw::{c_char, c_void};
 use std::slice;
+use std::sync::{Arc, Mutex, MutexGuard};
+use std::sync::atomic::{AtomicUsize, Ordering};
 
 use log::warn;
 use usvg::{NodeExt, SystemFontDB};
@@ -20,6 +23,11 @@ enum ErrorId {
     ElementsLimitReached,
     InvalidSize,
     ParsingFailed,
+    InvalidTarget,
+    InvalidBinary,
+    Canceled,
+    RenderLimitReached,
+    TargetTooLarge,
 }
 
 #[repr(C)]
@@ -65,6 +73,37 @@ pub struct resvg_fit_to {
     value: f32,
 }
 
+#[repr(C)]
+#[derive(Copy, Clone, PartialEq)]
+pub enum resvg_pixel_format {
+    RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED,
+    RESVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED,
+    RESVG_PIXEL_FORMAT_RGBA8888,
+    RESVG_PIXEL_FORMAT_BGRA8888,
+}
+
+#[repr(C)]
+pub struct resvg_render_target {
+    pub fit_to: resvg_fit_to,
+    pub width: u32,
+    pub height: u32,
+    pub stride: u32,
+    pub format: resvg_pixel_format,
+    pub data: *mut c_char,
+}
+
+#[repr(C)]
+pub struct resvg_node_stats {
+    pub kind: *const c_char,
+    pub id: *const c_char,
+    pub count: u32,
+    pub time: f64,
+    pub decode_time: f64,
+    pub layers: u32,
+    pub layers_memory: u64,
+    pub region_pixels: u64,
+}
+
 impl resvg_fit_to {
     #[inline]
     fn to_usvg(&self) -> usvg::FitTo {
@@ -96,20 +135,37 @@ pub extern "C" fn resvg_init_log() {
 }
 
 
-#[repr(C)]
-pub struct resvg_options(usvg::Options);
+pub struct resvg_options {
+    usvg: usvg::Options,
+    resvg: resvg::Options,
+}
 
 #[no_mangle]
 pub extern "C" fn resvg_options_create() -> *mut resvg_options {
-    Box::into_raw(Box::new(resvg_options(usvg::Options::default())))
+    Box::into_raw(Box::new(resvg_options {
+        usvg: usvg::Options::default(),
+        resvg: resvg::Options::default(),
+    }))
 }
 
 #[inline]
 fn cast_opt(opt: *mut resvg_options) -> &'static mut usvg::Options {
     unsafe {
         assert!(!opt.is_null());
-        &mut (*opt).0
+        &mut (*opt).usvg
+    }
+}
+
+/// Returns the options' fonts database for modification.
+///
+/// Returns `None` when the database is shared, since it can be used by other threads.
+fn cast_fontdb(opt: *mut resvg_options) -> Option<&'static mut usvg::fontdb::Database> {
+    let fontdb = Arc::get_mut(&mut cast_opt(opt).fontdb);
+    if fontdb.is_none() {
+        warn!("A shared fonts database cannot be modified.");
     }
+
+    fontdb
 }
 
 #[no_mangle]
@@ -138,27 +194,37 @@ pub extern "C" fn resvg_options_set_font_size(opt: *mut resvg_options, font_size
 
 #[no_mangle]
 pub extern "C" fn resvg_options_set_serif_family(opt: *mut resvg_options, family: *const c_char) {
-    cast_opt(opt).fontdb.set_serif_family(cstr_to_str(family).unwrap().to_string());
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.set_serif_family(cstr_to_str(family).unwrap().to_string());
+    }
 }
 
 #[no_mangle]
 pub extern "C" fn resvg_options_set_sans_serif_family(opt: *mut resvg_options, family: *const c_char) {
-    cast_opt(opt).fontdb.set_sans_serif_family(cstr_to_str(family).unwrap().to_string());
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.set_sans_serif_family(cstr_to_str(family).unwrap().to_string());
+    }
 }
 
 #[no_mangle]
 pub extern "C" fn resvg_options_set_cursive_family(opt: *mut resvg_options, family: *const c_char) {
-    cast_opt(opt).fontdb.set_cursive_family(cstr_to_str(family).unwrap().to_string());
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.set_cursive_family(cstr_to_str(family).unwrap().to_string());
+    }
 }
 
 #[no_mangle]
 pub extern "C" fn resvg_options_set_fantasy_family(opt: *mut resvg_options, family: *const c_char) {
-    cast_opt(opt).fontdb.set_fantasy_family(cstr_to_str(family).unwrap().to_string());
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.set_fantasy_family(cstr_to_str(family).unwrap().to_string());
+    }
 }
 
 #[no_mangle]
 pub extern "C" fn resvg_options_set_monospace_family(opt: *mut resvg_options, family: *const c_char) {
-    cast_opt(opt).fontdb.set_monospace_family(cstr_to_str(family).unwrap().to_string());
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.set_monospace_family(cstr_to_str(family).unwrap().to_string());
+    }
 }
 
 #[no_mangle]
@@ -215,6 +281,141 @@ pub extern "C" fn resvg_options_set_keep_named_groups(opt: *mut resvg_options, k
     cast_opt(opt).keep_named_groups = keep;
 }
 
+#[no_mangle]
+pub extern "C" fn resvg_options_set_threads(opt: *mut resvg_options, threads: u32) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.threads = threads as usize;
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_fast_blur(opt: *mut resvg_options, fast: bool) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.fast_blur = fast;
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_max_pixels(opt: *mut resvg_options, pixels: u64) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.limits.max_pixels = if pixels != 0 { Some(pixels) } else { None };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_max_layers_memory(opt: *mut resvg_options, bytes: usize) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.limits.max_layers_memory = if bytes != 0 { Some(bytes) } else { None };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_max_layers(opt: *mut resvg_options, layers: u32) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.limits.max_layers = if layers != 0 { Some(layers as usize) } else { None };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_max_filter_area(opt: *mut resvg_options, pixels: u64) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.limits.max_filter_area = if pixels != 0 { Some(pixels) } else { None };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_render_timeout(opt: *mut resvg_options, ms: u32) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.limits.timeout = if ms != 0 {
+        Some(std::time::Duration::from_millis(ms as u64))
+    } else {
+        None
+    };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_path_cache(opt: *mut resvg_options, enabled: bool) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.path_cache = enabled;
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_image_cache(
+    opt: *mut resvg_options,
+    cache: *const resvg_image_cache,
+) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.resvg.image_cache = if cache.is_null() {
+        None
+    } else {
+        Some(unsafe { (*cache).0.clone() })
+    };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_glyph_cache(
+    opt: *mut resvg_options,
+    cache: *const resvg_glyph_cache,
+) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.usvg.glyph_cache = if cache.is_null() {
+        None
+    } else {
+        Some(unsafe { (*cache).0.clone() })
+    };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_shaping_cache(
+    opt: *mut resvg_options,
+    cache: *const resvg_shaping_cache,
+) {
+    let opt = unsafe {
+        assert!(!opt.is_null());
+        &mut *opt
+    };
+
+    opt.usvg.shaping_cache = if cache.is_null() {
+        None
+    } else {
+        Some(unsafe { (*cache).0.clone() })
+    };
+}
+
 #[no_mangle]
 pub extern "C" fn resvg_options_load_system_fonts(opt: *mut resvg_options) {
     let opt = unsafe {
@@ -222,8 +423,10 @@ pub extern "C" fn resvg_options_load_system_fonts(opt: *mut resvg_options) {
         &mut *opt
     };
 
-    opt.0.fontdb.load_system_fonts();
-    opt.0.fontdb.set_generic_families();
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.load_system_fonts();
+        fontdb.set_generic_families();
+    }
 }
 
 #[no_mangle]
@@ -236,12 +439,12 @@ pub extern "C" fn resvg_options_load_font_file(
         None => return ErrorId::NotAnUtf8Str as i32,
     };
 
-    let opt = unsafe {
-        assert!(!opt.is_null());
-        &mut *opt
+    let fontdb = match cast_fontdb(opt) {
+        Some(v) => v,
+        None => return ErrorId::FileOpenFailed as i32,
     };
 
-    if opt.0.fontdb.load_font_file(file_path).is_ok() {
+    if fontdb.load_font_file(file_path).is_ok() {
         ErrorId::Ok as i32
     } else {
         ErrorId::FileOpenFailed as i32
@@ -256,12 +459,19 @@ pub extern "C" fn resvg_options_load_font_data(
 ) {
     let data = unsafe { slice::from_raw_parts(data as *const u8, len) };
 
-    let opt = unsafe {
-        assert!(!opt.is_null());
-        &mut *opt
+    if let Some(fontdb) = cast_fontdb(opt) {
+        fontdb.load_font_data(data.to_vec())
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_options_set_fontdb(opt: *mut resvg_options, fontdb: *const resvg_fontdb) {
+    let fontdb = unsafe {
+        assert!(!fontdb.is_null());
+        &*fontdb
     };
 
-    opt.0.fontdb.load_font_data(data.to_vec())
+    cast_opt(opt).fontdb = fontdb.0.clone();
 }
 
 #[no_mangle]
@@ -273,306 +483,1526 @@ pub extern "C" fn resvg_options_destroy(opt: *mut resvg_options) {
 }
 
 
-#[repr(C)]
-pub struct resvg_render_tree(pub usvg::Tree);
+pub struct resvg_fontdb(Arc<usvg::fontdb::Database>);
 
 #[no_mangle]
-pub extern "C" fn resvg_parse_tree_from_file(
+pub extern "C" fn resvg_fontdb_create() -> *mut resvg_fontdb {
+    Box::into_raw(Box::new(resvg_fontdb(Arc::new(usvg::fontdb::Database::new()))))
+}
+
+/// Returns the database for modification.
+///
+/// Returns `None` when the database is already used by options.
+fn cast_shared_fontdb(fontdb: *mut resvg_fontdb) -> Option<&'static mut usvg::fontdb::Database> {
+    let fontdb = unsafe {
+        assert!(!fontdb.is_null());
+        &mut *fontdb
+    };
+
+    let fontdb = Arc::get_mut(&mut fontdb.0);
+    if fontdb.is_none() {
+        warn!("A fonts database cannot be modified after being set to options.");
+    }
+
+    fontdb
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_fontdb_load_system_fonts(fontdb: *mut resvg_fontdb) {
+    if let Some(fontdb) = cast_shared_fontdb(fontdb) {
+        fontdb.load_system_fonts();
+        fontdb.set_generic_families();
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_fontdb_load_font_file(
+    fontdb: *mut resvg_fontdb,
     file_path: *const c_char,
-    opt: *const resvg_options,
-    raw_tree: *mut *mut resvg_render_tree,
 ) -> i32 {
     let file_path = match cstr_to_str(file_path) {
         Some(v) => v,
         None => return ErrorId::NotAnUtf8Str as i32,
     };
 
-    let raw_opt = unsafe {
-        assert!(!opt.is_null());
-        &*opt
+    let fontdb = match cast_shared_fontdb(fontdb) {
+        Some(v) => v,
+        None => return ErrorId::FileOpenFailed as i32,
     };
 
-    let file_data = match std::fs::read(file_path) {
-        Ok(tree) => tree,
-        Err(_) => return ErrorId::FileOpenFailed as i32,
-    };
+    if fontdb.load_font_file(file_path).is_ok() {
+        ErrorId::Ok as i32
+    } else {
+        ErrorId::FileOpenFailed as i32
+    }
+}
 
-    let tree = match usvg::Tree::from_data(&file_data, &raw_opt.0) {
-        Ok(tree) => tree,
-        Err(e) => return convert_error(e) as i32,
+#[no_mangle]
+pub extern "C" fn resvg_fontdb_destroy(fontdb: *mut resvg_fontdb) {
+    unsafe {
+        assert!(!fontdb.is_null());
+        Box::from_raw(fontdb)
     };
+}
 
-    let tree_box = Box::new(resvg_render_tree(tree));
-    unsafe { *raw_tree = Box::into_raw(tree_box); }
 
-    ErrorId::Ok as i32
-}
+pub struct resvg_image_cache(Arc<resvg::ImageCache>);
 
 #[no_mangle]
-pub extern "C" fn resvg_parse_tree_from_data(
-    data: *const c_char,
-    len: usize,
-    opt: *const resvg_options,
-    raw_tree: *mut *mut resvg_render_tree,
-) -> i32 {
-    let data = unsafe { slice::from_raw_parts(data as *const u8, len) };
+pub extern "C" fn resvg_image_cache_create(budget: usize) -> *mut resvg_image_cache {
+    Box::into_raw(Box::new(resvg_image_cache(Arc::new(resvg::ImageCache::new(budget)))))
+}
 
-    let raw_opt = unsafe {
-        assert!(!opt.is_null());
-        &*opt
+#[no_mangle]
+pub extern "C" fn resvg_image_cache_clear(cache: *const resvg_image_cache) {
+    let cache = unsafe {
+        assert!(!cache.is_null());
+        &*cache
     };
 
-    let tree = match usvg::Tree::from_data(data, &raw_opt.0) {
-        Ok(tree) => tree,
-        Err(e) => return convert_error(e) as i32,
+    cache.0.clear();
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_image_cache_destroy(cache: *mut resvg_image_cache) {
+    unsafe {
+        assert!(!cache.is_null());
+        Box::from_raw(cache)
     };
+}
 
-    let tree_box = Box::new(resvg_render_tree(tree));
-    unsafe { *raw_tree = Box::into_raw(tree_box); }
 
-    ErrorId::Ok as i32
+pub struct resvg_cancel_token(resvg::CancelToken);
+
+#[no_mangle]
+pub extern "C" fn resvg_cancel_token_create() -> *mut resvg_cancel_token {
+    Box::into_raw(Box::new(resvg_cancel_token(resvg::CancelToken::new())))
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_tree_destroy(tree: *mut resvg_render_tree) {
-    unsafe {
-        assert!(!tree.is_null());
-        Box::from_raw(tree)
+pub extern "C" fn resvg_cancel_token_cancel(token: *const resvg_cancel_token) {
+    let token = unsafe {
+        assert!(!token.is_null());
+        &*token
     };
+
+    token.0.cancel();
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_is_image_empty(tree: *const resvg_render_tree) -> bool {
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
+pub extern "C" fn resvg_cancel_token_reset(token: *const resvg_cancel_token) {
+    let token = unsafe {
+        assert!(!token.is_null());
+        &*token
     };
 
-    // The root/svg node should have at least two children.
-    // The first child is `defs` and it always present.
-    tree.0.root().children().count() > 1
+    token.0.reset();
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_get_image_size(tree: *const resvg_render_tree) -> resvg_size {
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
+pub extern "C" fn resvg_cancel_token_is_canceled(token: *const resvg_cancel_token) -> bool {
+    let token = unsafe {
+        assert!(!token.is_null());
+        &*token
     };
 
-    let size = tree.0.svg_node().size;
-
-    resvg_size {
-        width: size.width(),
-        height: size.height(),
-    }
+    token.0.is_canceled()
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_get_image_viewbox(tree: *const resvg_render_tree) -> resvg_rect {
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
+pub extern "C" fn resvg_cancel_token_destroy(token: *mut resvg_cancel_token) {
+    unsafe {
+        assert!(!token.is_null());
+        Box::from_raw(token)
     };
+}
 
-    let r = tree.0.svg_node().view_box.rect;
 
-    resvg_rect {
-        x: r.x(),
-        y: r.y(),
-        width: r.width(),
-        height: r.height(),
+pub struct resvg_render_stats {
+    stats: resvg::RenderStats,
+    /// A snapshot of the collected statistics with C strings.
+    ///
+    /// Updated after each render.
+    nodes: Vec<(CString, CString, resvg::NodeStats)>,
+}
+
+impl resvg_render_stats {
+    fn update_snapshot(&mut self) {
+        self.nodes = self.stats.nodes().into_iter().map(|node| {
+            let kind = CString::new(node.kind).unwrap_or_default();
+            let id = CString::new(node.id.as_str()).unwrap_or_default();
+            (kind, id, node)
+        }).collect();
     }
 }
 
+#[no_mangle]
+pub extern "C" fn resvg_render_stats_create() -> *mut resvg_render_stats {
+    Box::into_raw(Box::new(resvg_render_stats {
+        stats: resvg::RenderStats::new(),
+        nodes: Vec::new(),
+    }))
+}
 
 #[no_mangle]
-pub extern "C" fn resvg_get_image_bbox(
-    tree: *const resvg_render_tree,
-    bbox: *mut resvg_rect,
-) -> bool {
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
+pub extern "C" fn resvg_render_stats_count(stats: *const resvg_render_stats) -> usize {
+    let stats = unsafe {
+        assert!(!stats.is_null());
+        &*stats
     };
 
-    if let Some(r) = tree.0.root().calculate_bbox() {
-        unsafe {
-            *bbox = resvg_rect {
-                x: r.x(),
-                y: r.y(),
-                width: r.width(),
-                height: r.height(),
-            }
-        }
-
-        true
-    } else {
-        false
-    }
+    stats.nodes.len()
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_get_node_bbox(
-    tree: *const resvg_render_tree,
-    id: *const c_char,
-    bbox: *mut resvg_rect,
+pub extern "C" fn resvg_render_stats_get(
+    stats: *const resvg_render_stats,
+    index: usize,
+    node: *mut resvg_node_stats,
 ) -> bool {
-    let id = match cstr_to_str(id) {
-        Some(v) => v,
-        None => {
-            warn!("Provided ID is no an UTF-8 string.");
+    let stats = unsafe {
+        assert!(!stats.is_null());
+        &*stats
+    };
+
+    let node = unsafe {
+        assert!(!node.is_null());
+        &mut *node
+    };
+
+    let (kind, id, data) = match stats.nodes.get(index) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    *node = resvg_node_stats {
+        kind: kind.as_ptr(),
+        id: id.as_ptr(),
+        count: data.count as u32,
+        time: data.time.as_secs_f64() * 1000.0,
+        decode_time: data.decode_time.as_secs_f64() * 1000.0,
+        layers: data.layers as u32,
+        layers_memory: data.layers_memory as u64,
+        region_pixels: data.region_pixels,
+    };
+
+    true
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_stats_clear(stats: *mut resvg_render_stats) {
+    let stats = unsafe {
+        assert!(!stats.is_null());
+        &mut *stats
+    };
+
+    stats.stats.clear();
+    stats.nodes.clear();
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_stats_destroy(stats: *mut resvg_render_stats) {
+    unsafe {
+        assert!(!stats.is_null());
+        Box::from_raw(stats)
+    };
+}
+
+
+pub struct resvg_glyph_cache(Arc<usvg::GlyphCache>);
+
+#[no_mangle]
+pub extern "C" fn resvg_glyph_cache_create(budget: usize) -> *mut resvg_glyph_cache {
+    Box::into_raw(Box::new(resvg_glyph_cache(Arc::new(usvg::GlyphCache::new(budget)))))
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_glyph_cache_clear(cache: *const resvg_glyph_cache) {
+    let cache = unsafe {
+        assert!(!cache.is_null());
+        &*cache
+    };
+
+    cache.0.clear();
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_glyph_cache_destroy(cache: *mut resvg_glyph_cache) {
+    unsafe {
+        assert!(!cache.is_null());
+        Box::from_raw(cache)
+    };
+}
+
+
+pub struct resvg_shaping_cache(Arc<usvg::ShapingCache>);
+
+#[no_mangle]
+pub extern "C" fn resvg_shaping_cache_create(budget: usize) -> *mut resvg_shaping_cache {
+    Box::into_raw(Box::new(resvg_shaping_cache(Arc::new(usvg::ShapingCache::new(budget)))))
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_shaping_cache_clear(cache: *const resvg_shaping_cache) {
+    let cache = unsafe {
+        assert!(!cache.is_null());
+        &*cache
+    };
+
+    cache.0.clear();
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_shaping_cache_destroy(cache: *mut resvg_shaping_cache) {
+    unsafe {
+        assert!(!cache.is_null());
+        Box::from_raw(cache)
+    };
+}
+
+
+/// A render tree that can be shared between threads.
+///
+/// `usvg::Tree` is built on top of `Rc` and `RefCell`, therefore it cannot be accessed
+/// from multiple threads at once. Instead, each concurrent render gets its own deep copy
+/// of the tree. Copies are created on contention and reused afterwards.
+///
+/// Copies are created from a separate source tree, which is never rendered,
+/// so creating a copy doesn't wait for a render that uses the primary tree.
+/// The source tree is created by the first concurrent render and refreshed
+/// by the first concurrent render after a node modification. Only these renders
+/// wait for the primary tree, since it's the only up to date one at this point.
+/// A tree that is never rendered concurrently has no copies at all.
+pub struct resvg_render_tree {
+    tree: Mutex<usvg::Tree>,
+    /// A copy of the primary tree that replicas are created from,
+    /// with the generation it was copied at.
+    source: Mutex<Option<(usvg::Tree, usize)>>,
+    /// Replicas with the generation they were copied at.
+    replicas: Mutex<Vec<(usvg::Tree, usize)>>,
+    /// Incremented on each primary tree modification. Modified only under the primary lock.
+    generation: AtomicUsize,
+    /// The binary tree serialized by a `resvg_tree_save` size query,
+    /// with the generation it was serialized at.
+    binary: Mutex<Option<(Vec<u8>, usize)>>,
+    renderer: resvg::Renderer,
+}
+
+// `usvg::Tree` is neither `Send` nor `Sync` only because of the `Rc` reference counters.
+// Each tree here, either the primary one, the source or a replica, is accessed
+// only by a single thread at a time: the primary and the source trees are guarded
+// by mutexes and a replica is removed from the pool while in use. Copies are created
+// via `usvg::Tree::deep_copy`, so they do not share any `Rc` with each other.
+// And none of the `Node` handles outlive a single C API call.
+unsafe impl Send for resvg_render_tree {}
+unsafe impl Sync for resvg_render_tree {}
+
+impl resvg_render_tree {
+    fn new(tree: usvg::Tree, opt: &resvg::Options) -> Self {
+        resvg_render_tree {
+            tree: Mutex::new(tree),
+            source: Mutex::new(None),
+            replicas: Mutex::new(Vec::new()),
+            generation: AtomicUsize::new(0),
+            binary: Mutex::new(None),
+            renderer: resvg::Renderer::new(opt.clone()),
+        }
+    }
+
+    /// Locks the primary tree.
+    fn lock(&self) -> MutexGuard<usvg::Tree> {
+        self.tree.lock().unwrap()
+    }
+
+    /// Marks the source tree and all replicas as outdated.
+    ///
+    /// Must be called while the primary tree is locked.
+    fn invalidate_replicas(&self) {
+        self.generation.fetch_add(1, Ordering::SeqCst);
+        self.replicas.lock().unwrap().clear();
+    }
+
+    /// Returns a tree suitable for rendering.
+    ///
+    /// Returns the primary tree when no one else is using it.
+    /// Otherwise, takes a replica from the pool or creates a new one.
+    fn render_tree(&self) -> RenderTreeGuard {
+        if let Ok(tree) = self.tree.try_lock() {
+            return RenderTreeGuard::Primary(tree);
+        }
+
+        let generation = self.generation.load(Ordering::SeqCst);
+        let replica = {
+            let mut replicas = self.replicas.lock().unwrap();
+            replicas.retain(|r| r.1 == generation);
+            replicas.pop()
+        };
+
+        let replica = match replica {
+            Some(replica) => replica,
+            None => {
+                let source = self.source.lock().unwrap();
+                match *source {
+                    Some((ref tree, g)) if g == generation => (tree.deep_copy(), generation),
+                    _ => {
+                        // The source lock is released first, since a thread that holds
+                        // the primary lock can be waiting for it.
+                        drop(source);
+
+                        let tree = self.lock();
+                        let generation = self.generation.load(Ordering::SeqCst);
+                        let mut source = self.source.lock().unwrap();
+                        let replica = tree.deep_copy();
+                        *source = Some((tree.deep_copy(), generation));
+                        (replica, generation)
+                    }
+                }
+            }
+        };
+
+        RenderTreeGuard::Replica(self, Some(replica))
+    }
+}
+
+enum RenderTreeGuard<'a> {
+    Primary(MutexGuard<'a, usvg::Tree>),
+    Replica(&'a resvg_render_tree, Option<(usvg::Tree, usize)>),
+}
+
+impl std::ops::Deref for RenderTreeGuard<'_> {
+    type Target = usvg::Tree;
+
+    fn deref(&self) -> &Self::Target {
+        match self {
+            RenderTreeGuard::Primary(ref tree) => tree,
+            RenderTreeGuard::Replica(_, ref tree) => &tree.as_ref().unwrap().0,
+        }
+    }
+}
+
+impl Drop for RenderTreeGuard<'_> {
+    fn drop(&mut self) {
+        if let RenderTreeGuard::Replica(owner, ref mut tree) = *self {
+            if let Some(tree) = tree.take() {
+                // Replicas that were copied before a modification are dropped.
+                let mut replicas = owner.replicas.lock().unwrap();
+                if tree.1 == owner.generation.load(Ordering::SeqCst) {
+                    replicas.push(tree);
+                }
+            }
+        }
+    }
+}
+
+/// Files smaller than this are read into memory instead of being mapped.
+///
+/// Mapping a small file is not faster than reading it.
+const MIN_MAPPED_FILE_SIZE: u64 = 1024 * 1024;
+
+/// A file content.
+///
+/// Large regular files are memory-mapped, so the data is read directly from the page cache
+/// instead of being copied into the heap.
+enum FileData {
+    Mapped(memmap2::Mmap),
+    Owned(Vec<u8>),
+}
+
+impl FileData {
+    fn open(path: &str) -> Option<Self> {
+        let file = std::fs::File::open(path).ok()?;
+
+        // Special files, like pipes, cannot be mapped.
+        let is_large = file.metadata()
+            .map(|m| m.is_file() && m.len() >= MIN_MAPPED_FILE_SIZE)
+            .unwrap_or(false);
+        if is_large {
+            // The file can be modified by another process while mapped, which is UB.
+            // A modified content can result only in a parsing error or an invalid image,
+            // since we're not trusting the SVG data anyway. But if the file gets truncated,
+            // accessing the lost pages will raise SIGBUS and kill the process.
+            // This is documented in `resvg_parse_tree_from_file`.
+            if let Ok(mmap) = unsafe { memmap2::Mmap::map(&file) } {
+                return Some(FileData::Mapped(mmap));
+            }
+        }
+
+        std::fs::read(path).ok().map(FileData::Owned)
+    }
+
+    fn as_bytes(&self) -> &[u8] {
+        match self {
+            FileData::Mapped(ref mmap) => &mmap[..],
+            FileData::Owned(ref data) => &data[..],
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_parse_tree_from_file(
+    file_path: *const c_char,
+    opt: *const resvg_options,
+    raw_tree: *mut *mut resvg_render_tree,
+) -> i32 {
+    let file_path = match cstr_to_str(file_path) {
+        Some(v) => v,
+        None => return ErrorId::NotAnUtf8Str as i32,
+    };
+
+    let raw_opt = unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    };
+
+    let file_data = match FileData::open(file_path) {
+        Some(v) => v,
+        None => return ErrorId::FileOpenFailed as i32,
+    };
+
+    let tree = match usvg::Tree::from_data(file_data.as_bytes(), &raw_opt.usvg) {
+        Ok(tree) => tree,
+        Err(e) => return convert_error(e) as i32,
+    };
+
+    let tree_box = Box::new(resvg_render_tree::new(tree, &raw_opt.resvg));
+    unsafe { *raw_tree = Box::into_raw(tree_box); }
+
+    ErrorId::Ok as i32
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_parse_tree_from_data(
+    data: *const c_char,
+    len: usize,
+    opt: *const resvg_options,
+    raw_tree: *mut *mut resvg_render_tree,
+) -> i32 {
+    let data = unsafe {
+        assert!(!data.is_null());
+        slice::from_raw_parts(data as *const u8, len)
+    };
+
+    let raw_opt = unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    };
+
+    let tree = match usvg::Tree::from_data(data, &raw_opt.usvg) {
+        Ok(tree) => tree,
+        Err(e) => return convert_error(e) as i32,
+    };
+
+    let tree_box = Box::new(resvg_render_tree::new(tree, &raw_opt.resvg));
+    unsafe { *raw_tree = Box::into_raw(tree_box); }
+
+    ErrorId::Ok as i32
+}
+
+pub struct resvg_parser(usvg::Parser);
+
+#[no_mangle]
+pub extern "C" fn resvg_parser_create() -> *mut resvg_parser {
+    Box::into_raw(Box::new(resvg_parser(usvg::Parser::new())))
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_parser_feed(
+    parser: *mut resvg_parser,
+    data: *const c_char,
+    len: usize,
+) -> i32 {
+    let parser = unsafe {
+        assert!(!parser.is_null());
+        &mut *parser
+    };
+
+    if len == 0 {
+        return ErrorId::Ok as i32;
+    }
+
+    let data = unsafe { slice::from_raw_parts(data as *const u8, len) };
+    match parser.0.feed(data) {
+        Ok(()) => ErrorId::Ok as i32,
+        Err(e) => convert_error(e) as i32,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_parser_finish(
+    parser: *mut resvg_parser,
+    opt: *const resvg_options,
+    raw_tree: *mut *mut resvg_render_tree,
+) -> i32 {
+    let parser = unsafe {
+        assert!(!parser.is_null());
+        Box::from_raw(parser)
+    };
+
+    let raw_opt = unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    };
+
+    let tree = match parser.0.finish(&raw_opt.usvg) {
+        Ok(tree) => tree,
+        Err(e) => return convert_error(e) as i32,
+    };
+
+    let tree_box = Box::new(resvg_render_tree::new(tree, &raw_opt.resvg));
+    unsafe { *raw_tree = Box::into_raw(tree_box); }
+
+    ErrorId::Ok as i32
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_parser_destroy(parser: *mut resvg_parser) {
+    unsafe {
+        assert!(!parser.is_null());
+        Box::from_raw(parser)
+    };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_tree_load_from_buffer(
+    data: *const c_char,
+    len: usize,
+    opt: *const resvg_options,
+    raw_tree: *mut *mut resvg_render_tree,
+) -> i32 {
+    let data = unsafe {
+        assert!(!data.is_null());
+        slice::from_raw_parts(data as *const u8, len)
+    };
+
+    let raw_opt = unsafe {
+        assert!(!opt.is_null());
+        &*opt
+    };
+
+    let tree = match usvg::Tree::from_binary(data) {
+        Ok(tree) => tree,
+        Err(e) => return convert_error(e) as i32,
+    };
+
+    let tree_box = Box::new(resvg_render_tree::new(tree, &raw_opt.resvg));
+    unsafe { *raw_tree = Box::into_raw(tree_box); }
+
+    ErrorId::Ok as i32
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_tree_save(
+    tree: *const resvg_render_tree,
+    data: *mut c_char,
+    len: usize,
+) -> usize {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    // The binary serialized by a size query is kept for the following call,
+    // so the tree is serialized only once.
+    let mut cached = tree.binary.lock().unwrap();
+    let (binary, generation) = match cached.take() {
+        Some((binary, generation)) if generation == tree.generation.load(Ordering::SeqCst) => {
+            (binary, generation)
+        }
+        _ => {
+            let primary = tree.lock();
+            (primary.to_binary(), tree.generation.load(Ordering::SeqCst))
+        }
+    };
+
+    let binary_len = binary.len();
+    if !data.is_null() && len >= binary_len {
+        let data = unsafe { slice::from_raw_parts_mut(data as *mut u8, binary_len) };
+        data.copy_from_slice(&binary);
+    } else {
+        *cached = Some((binary, generation));
+    }
+
+    binary_len
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_tree_destroy(tree: *mut resvg_render_tree) {
+    unsafe {
+        assert!(!tree.is_null());
+        Box::from_raw(tree)
+    };
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_tree_clear_cache(tree: *const resvg_render_tree) {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    tree.renderer.clear_cache();
+    tree.replicas.lock().unwrap().clear();
+    *tree.source.lock().unwrap() = None;
+    *tree.binary.lock().unwrap() = None;
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_is_image_empty(tree: *const resvg_render_tree) -> bool {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    // The root/svg node should have at least two children.
+    // The first child is `defs` and it always present.
+    tree.lock().root().children().count() > 1
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_get_image_size(tree: *const resvg_render_tree) -> resvg_size {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let size = tree.lock().svg_node().size;
+
+    resvg_size {
+        width: size.width(),
+        height: size.height(),
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_get_image_viewbox(tree: *const resvg_render_tree) -> resvg_rect {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let r = tree.lock().svg_node().view_box.rect;
+
+    resvg_rect {
+        x: r.x(),
+        y: r.y(),
+        width: r.width(),
+        height: r.height(),
+    }
+}
+
+
+#[no_mangle]
+pub extern "C" fn resvg_get_image_bbox(
+    tree: *const resvg_render_tree,
+    bbox: *mut resvg_rect,
+) -> bool {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    if let Some(r) = tree.lock().root().calculate_bbox() {
+        unsafe {
+            *bbox = resvg_rect {
+                x: r.x(),
+                y: r.y(),
+                width: r.width(),
+                height: r.height(),
+            }
+        }
+
+        true
+    } else {
+        false
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_get_node_bbox(
+    tree: *const resvg_render_tree,
+    id: *const c_char,
+    bbox: *mut resvg_rect,
+) -> bool {
+    let id = match cstr_to_str(id) {
+        Some(v) => v,
+        None => {
+            warn!("Provided ID is no an UTF-8 string.");
+            return false;
+        }
+    };
+
+    if id.is_empty() {
+        warn!("Node ID must not be empty.");
+        return false;
+    }
+
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    match tree.lock().node_by_id(id) {
+        Some(node) => {
+            if let Some(r) = node.calculate_bbox() {
+                unsafe {
+                    *bbox = resvg_rect {
+                        x: r.x(),
+                        y: r.y(),
+                        width: r.width(),
+                        height: r.height(),
+                    }
+                }
+
+                true
+            } else {
+                false
+            }
+        }
+        None => {
+            warn!("No node with '{}' ID is in the tree.", id);
+            false
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_node_exists(
+    tree: *const resvg_render_tree,
+    id: *const c_char,
+) -> bool {
+    let id = match cstr_to_str(id) {
+        Some(v) => v,
+        None => {
+            warn!("Provided ID is no an UTF-8 string.");
             return false;
         }
     };
 
-    if id.is_empty() {
-        warn!("Node ID must not be empty.");
-        return false;
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    tree.lock().node_by_id(id).is_some()
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_get_node_transform(
+    tree: *const resvg_render_tree,
+    id: *const c_char,
+    ts: *mut resvg_transform,
+) -> bool {
+    let id = match cstr_to_str(id) {
+        Some(v) => v,
+        None => {
+            warn!("Provided ID is no an UTF-8 string.");
+            return false;
+        }
+    };
+
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    if let Some(node) = tree.lock().node_by_id(id) {
+        let mut abs_ts = node.abs_transform();
+        abs_ts.append(&node.transform());
+
+        unsafe {
+            *ts = resvg_transform {
+                a: abs_ts.a,
+                b: abs_ts.b,
+                c: abs_ts.c,
+                d: abs_ts.d,
+                e: abs_ts.e,
+                f: abs_ts.f,
+            }
+        }
+
+        return true;
+    }
+
+    false
+}
+
+pub fn cstr_to_str(text: *const c_char) -> Option<&'static str> {
+    let text = unsafe {
+        assert!(!text.is_null());
+        CStr::from_ptr(text)
+    };
+
+    text.to_str().ok()
+}
+
+fn convert_error(e: usvg::Error) -> ErrorId {
+    match e {
+        usvg::Error::NotAnUtf8Str => ErrorId::NotAnUtf8Str,
+        usvg::Error::MalformedGZip => ErrorId::MalformedGZip,
+        usvg::Error::ElementsLimitReached => ErrorId::ElementsLimitReached,
+        usvg::Error::InvalidSize => ErrorId::InvalidSize,
+        usvg::Error::ParsingFailed(_) => ErrorId::ParsingFailed,
+        usvg::Error::InvalidBinary => ErrorId::InvalidBinary,
+    }
+}
+
+fn convert_render_error(e: resvg::RenderError) -> ErrorId {
+    match e {
+        resvg::RenderError::InvalidSize => ErrorId::InvalidSize,
+        resvg::RenderError::Canceled => ErrorId::Canceled,
+        resvg::RenderError::TargetTooLarge => ErrorId::TargetTooLarge,
+        resvg::RenderError::LimitReached => ErrorId::RenderLimitReached,
+    }
+}
+
+
+#[no_mangle]
+pub extern "C" fn resvg_render(
+    tree: *const resvg_render_tree,
+    fit_to: resvg_fit_to,
+    width: u32,
+    height: u32,
+    pixmap: *const c_char,
+) {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let pixmap_len = width as usize * height as usize * tiny_skia::BYTES_PER_PIXEL;
+    let pixmap: &mut [u8] = unsafe { std::slice::from_raw_parts_mut(pixmap as *mut u8, pixmap_len) };
+    let pixmap = tiny_skia::PixmapMut::from_bytes(pixmap, width, height).unwrap();
+
+    // There is no way to report an error from this function. Use `resvg_render_to_target*` instead.
+    let res = tree.renderer.render_with_control(&tree.render_tree(), fit_to.to_usvg(), pixmap,
+                                                resvg::RenderControl::default());
+    if let Err(e) = res {
+        warn!("Failed to render an SVG: {}.", e);
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_to_target(
+    tree: *const resvg_render_tree,
+    target: *const resvg_render_target,
+) -> i32 {
+    render_to_target_with_control(tree, target, std::ptr::null(), None, std::ptr::null_mut(),
+                                  std::ptr::null_mut(), false)
+}
+
+/// A render progress callback.
+pub type resvg_progress_callback = Option<extern "C" fn(progress: f64, user_data: *mut c_void)>;
+
+#[no_mangle]
+pub extern "C" fn resvg_render_to_target_with_control(
+    tree: *const resvg_render_tree,
+    target: *const resvg_render_target,
+    cancel: *const resvg_cancel_token,
+    progress: resvg_progress_callback,
+    user_data: *mut c_void,
+) -> i32 {
+    render_to_target_with_control(tree, target, cancel, progress, user_data,
+                                  std::ptr::null_mut(), false)
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_to_target_with_stats(
+    tree: *const resvg_render_tree,
+    target: *const resvg_render_target,
+    stats: *mut resvg_render_stats,
+) -> i32 {
+    assert!(!stats.is_null());
+    render_to_target_with_control(tree, target, std::ptr::null(), None, std::ptr::null_mut(),
+                                  stats, false)
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_preview_to_target(
+    tree: *const resvg_render_tree,
+    target: *const resvg_render_target,
+    cancel: *const resvg_cancel_token,
+) -> i32 {
+    render_to_target_with_control(tree, target, cancel, None, std::ptr::null_mut(),
+                                  std::ptr::null_mut(), true)
+}
+
+fn render_to_target_with_control(
+    tree: *const resvg_render_tree,
+    target: *const resvg_render_target,
+    cancel: *const resvg_cancel_token,
+    progress: resvg_progress_callback,
+    user_data: *mut c_void,
+    stats: *mut resvg_render_stats,
+    preview: bool,
+) -> i32 {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let target = unsafe {
+        assert!(!target.is_null());
+        &*target
+    };
+
+    let cancel = if cancel.is_null() {
+        None
+    } else {
+        Some(unsafe { &(*cancel).0 })
+    };
+
+    let mut stats = if stats.is_null() {
+        None
+    } else {
+        Some(unsafe { &mut *stats })
+    };
+
+    let data = match target_data(target) {
+        Some(v) => v,
+        None => return ErrorId::InvalidTarget as i32,
+    };
+
+    let callback = move |value: f64| {
+        if let Some(progress) = progress {
+            progress(value, user_data);
+        }
+    };
+
+    let control = resvg::RenderControl {
+        cancel,
+        progress: if progress.is_some() { Some(&callback as &dyn Fn(f64)) } else { None },
+        stats: stats.as_ref().map(|s| &s.stats),
+        preview,
+    };
+
+    let renderer = &tree.renderer;
+    let tree = tree.render_tree();
+    let fit_to = target.fit_to.to_usvg();
+    let res = render_to_buffer_checked(target, data, |pixmap| {
+        renderer.render_with_control(&tree, fit_to, pixmap, control)
+    });
+
+    if let Some(ref mut stats) = stats {
+        stats.update_snapshot();
     }
 
+    res
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_region(
+    tree: *const resvg_render_tree,
+    x: i32,
+    y: i32,
+    target: *const resvg_render_target,
+) -> i32 {
+    let tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
+    };
+
+    let target = unsafe {
+        assert!(!target.is_null());
+        &*target
+    };
+
+    let data = match target_data(target) {
+        Some(v) => v,
+        None => return ErrorId::InvalidTarget as i32,
+    };
+
+    let renderer = &tree.renderer;
+    let tree = tree.render_tree();
+    let fit_to = target.fit_to.to_usvg();
+    render_to_buffer_checked(target, data, |pixmap| {
+        renderer.render_region(&tree, fit_to, x, y, pixmap)
+    })
+}
+
+/// An amount of memory that can be used by decoded images during a batch render,
+/// when the tree has no images cache.
+const BATCH_IMAGE_CACHE_BUDGET: usize = 64 * 1024 * 1024;
+
+/// A render target with its validated pixels buffer.
+struct BatchItem<'a> {
+    target: &'a resvg_render_target,
+    data: &'a mut [u8],
+}
+
+// A target data pointer is accessed only via `data`,
+// which is a unique, non-overlapping buffer per target.
+unsafe impl Send for BatchItem<'_> {}
+
+#[no_mangle]
+pub extern "C" fn resvg_render_batch(
+    tree: *const resvg_render_tree,
+    targets: *const resvg_render_target,
+    len: usize,
+) -> i32 {
     let tree = unsafe {
         assert!(!tree.is_null());
         &*tree
     };
 
-    match tree.0.node_by_id(id) {
-        Some(node) => {
-            if let Some(r) = node.calculate_bbox() {
-                unsafe {
-                    *bbox = resvg_rect {
-                        x: r.x(),
-                        y: r.y(),
-                        width: r.width(),
-                        height: r.height(),
-                    }
-                }
+    if len == 0 {
+        return ErrorId::Ok as i32;
+    }
+
+    let targets = unsafe {
+        assert!(!targets.is_null());
+        slice::from_raw_parts(targets, len)
+    };
+
+    // Validate all targets first, so we either render all of them or none.
+    let mut items = Vec::with_capacity(len);
+    for target in targets {
+        match target_data(target) {
+            Some(data) => items.push(BatchItem { target, data }),
+            None => return ErrorId::InvalidTarget as i32,
+        }
+    }
+
+    // Targets are taken from the end, so the biggest images are rendered first
+    // and are not left for the end when multiple threads are used.
+    items.sort_by_key(|item| item.target.width as u64 * item.target.height as u64);
+
+    // Raster images decoding doesn't depend on the image size,
+    // so make sure it's done only once per batch.
+    let mut opt = tree.renderer.options().clone();
+    if opt.image_cache.is_none() {
+        opt.image_cache = Some(Arc::new(resvg::ImageCache::new(BATCH_IMAGE_CACHE_BUDGET)));
+    }
+
+    let threads = match opt.threads {
+        0 => std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1),
+        n => n,
+    };
+    let threads = threads.min(items.len());
+
+    // Targets are already rendered in parallel, so each of them should use a single thread.
+    if threads > 1 {
+        opt.threads = 1;
+    }
+
+    let renderer = resvg::Renderer::new(opt);
+    let items = Mutex::new(items);
+    let result = Mutex::new(ErrorId::Ok as i32);
+
+    let work = || {
+        loop {
+            let item = items.lock().unwrap().pop();
+            let item = match item {
+                Some(v) => v,
+                None => break,
+            };
+
+            let render_tree = tree.render_tree();
+            let fit_to = item.target.fit_to.to_usvg();
+            let res = render_to_buffer_checked(item.target, item.data, |pixmap| {
+                renderer.render_with_control(&render_tree, fit_to, pixmap,
+                                             resvg::RenderControl::default())
+            });
+
+            if res != ErrorId::Ok as i32 {
+                let mut result = result.lock().unwrap();
+                if *result == ErrorId::Ok as i32 {
+                    *result = res;
+                }
+            }
+        }
+    };
+
+    if threads > 1 {
+        let work = &work;
+        std::thread::scope(|s| {
+            for _ in 1..threads {
+                s.spawn(move || work());
+            }
+
+            work();
+        });
+    } else {
+        work();
+    }
+
+    let result = *result.lock().unwrap();
+    result
+}
+
+/// Returns the target's pixels buffer.
+///
+/// Returns `None` when the target has a zero size, a too small stride or no data.
+fn target_data(target: &resvg_render_target) -> Option<&'static mut [u8]> {
+    if target.data.is_null() || target.width == 0 || target.height == 0 {
+        return None;
+    }
+
+    let row_len = target.width as usize * tiny_skia::BYTES_PER_PIXEL;
+    let stride = target_stride(target);
+    if stride < row_len {
+        warn!("Render target stride is smaller than its width.");
+        return None;
+    }
+
+    // The last row doesn't have to include the padding.
+    let len = stride * (target.height as usize - 1) + row_len;
+    Some(unsafe { slice::from_raw_parts_mut(target.data as *mut u8, len) })
+}
+
+#[inline]
+fn target_stride(target: &resvg_render_target) -> usize {
+    if target.stride == 0 {
+        target.width as usize * tiny_skia::BYTES_PER_PIXEL
+    } else {
+        target.stride as usize
+    }
+}
+
+/// Renders into a caller's buffer using the target's stride and pixel format.
+///
+/// `tiny-skia` can render only into a tightly packed premultiplied RGBA buffer.
+///
+/// A tightly packed target is rendered in-place and then converted
+/// into the requested format by a separate pass over the whole buffer.
+/// A target with a padding is rendered into a temporary pixmap first,
+/// which is then copied into the target row by row, converting each row
+/// right after it was copied.
+fn render_to_buffer<F>(target: &resvg_render_target, data: &mut [u8], render: F) -> Option<()>
+    where F: FnOnce(tiny_skia::PixmapMut) -> Option<()>
+{
+    let row_len = target.width as usize * tiny_skia::BYTES_PER_PIXEL;
+    let stride = target_stride(target);
+
+    if stride == row_len {
+        // The target content has an unknown format, so we cannot render on top of it.
+        for p in data.iter_mut() {
+            *p = 0;
+        }
+
+        let pixmap = tiny_skia::PixmapMut::from_bytes(data, target.width, target.height)?;
+        render(pixmap)?;
+        convert_pixels(data, target.format);
+    } else {
+        let mut pixmap = tiny_skia::Pixmap::new(target.width, target.height)?;
+        render(pixmap.as_mut())?;
+
+        for (src, dst) in pixmap.data().chunks_exact(row_len).zip(data.chunks_mut(stride)) {
+            let dst = &mut dst[..row_len];
+            dst.copy_from_slice(src);
+            convert_pixels(dst, target.format);
+        }
+    }
+
+    Some(())
+}
+
+/// Like `render_to_buffer`, but converts the render result into a `resvg_error`.
+///
+/// The image without the elements that exceeded the limits is still copied into the target.
+fn render_to_buffer_checked<F>(target: &resvg_render_target, data: &mut [u8], render: F) -> i32
+    where F: FnOnce(tiny_skia::PixmapMut) -> Result<(), resvg::RenderError>
+{
+    let mut error = None;
+    let res = render_to_buffer(target, data, |pixmap| {
+        match render(pixmap) {
+            Ok(()) => Some(()),
+            Err(resvg::RenderError::LimitReached) => {
+                error = Some(ErrorId::RenderLimitReached);
+                Some(())
+            }
+            Err(e) => {
+                error = Some(convert_render_error(e));
+                None
+            }
+        }
+    });
+
+    match (res, error) {
+        (_, Some(e)) => e as i32,
+        (Some(_), None) => ErrorId::Ok as i32,
+        (None, None) => ErrorId::InvalidSize as i32,
+    }
+}
+
+/// Converts premultiplied RGBA8888 pixels into the specified format in-place.
+fn convert_pixels(data: &mut [u8], format: resvg_pixel_format) {
+    use resvg_pixel_format::*;
 
-                true
-            } else {
-                false
+    match format {
+        RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED => {}
+        RESVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED => {
+            for p in data.chunks_exact_mut(4) {
+                p.swap(0, 2);
             }
         }
-        None => {
-            warn!("No node with '{}' ID is in the tree.", id);
-            false
+        RESVG_PIXEL_FORMAT_RGBA8888 => {
+            for p in data.chunks_exact_mut(4) {
+                demultiply(p);
+            }
+        }
+        RESVG_PIXEL_FORMAT_BGRA8888 => {
+            for p in data.chunks_exact_mut(4) {
+                demultiply(p);
+                p.swap(0, 2);
+            }
+        }
+    }
+}
+
+#[inline]
+fn demultiply(p: &mut [u8]) {
+    let a = p[3] as u32;
+    if a != 0 && a != 255 {
+        for c in &mut p[0..3] {
+            *c = ((*c as u32 * 255 + a / 2) / a).min(255) as u8;
         }
     }
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_node_exists(
+pub extern "C" fn resvg_render_node(
     tree: *const resvg_render_tree,
     id: *const c_char,
+    fit_to: resvg_fit_to,
+    width: u32,
+    height: u32,
+    pixmap: *const c_char,
 ) -> bool {
-    let id = match cstr_to_str(id) {
-        Some(v) => v,
-        None => {
-            warn!("Provided ID is no an UTF-8 string.");
-            return false;
-        }
-    };
-
     let tree = unsafe {
         assert!(!tree.is_null());
         &*tree
     };
 
-    tree.0.node_by_id(id).is_some()
-}
-
-#[no_mangle]
-pub extern "C" fn resvg_get_node_transform(
-    tree: *const resvg_render_tree,
-    id: *const c_char,
-    ts: *mut resvg_transform,
-) -> bool {
     let id = match cstr_to_str(id) {
         Some(v) => v,
-        None => {
-            warn!("Provided ID is no an UTF-8 string.");
-            return false;
-        }
+        None => return false,
     };
 
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
-    };
+    if id.is_empty() {
+        warn!("Node with an empty ID cannot be rendered.");
+        return false;
+    }
 
-    if let Some(node) = tree.0.node_by_id(id) {
-        let mut abs_ts = node.abs_transform();
-        abs_ts.append(&node.transform());
+    let renderer = &tree.renderer;
+    let tree = tree.render_tree();
+    if let Some(node) = tree.node_by_id(id) {
+        let pixmap_len = width as usize * height as usize * tiny_skia::BYTES_PER_PIXEL;
+        let pixmap: &mut [u8] = unsafe { std::slice::from_raw_parts_mut(pixmap as *mut u8, pixmap_len) };
+        let pixmap = tiny_skia::PixmapMut::from_bytes(pixmap, width, height).unwrap();
 
-        unsafe {
-            *ts = resvg_transform {
-                a: abs_ts.a,
-                b: abs_ts.b,
-                c: abs_ts.c,
-                d: abs_ts.d,
-                e: abs_ts.e,
-                f: abs_ts.f,
+        renderer.render_node(&tree, &node, fit_to.to_usvg(), pixmap).is_ok()
+    } else {
+        warn!("A node with '{}' ID wasn't found.", id);
+        false
+    }
+}
+
+
+/// A renderer that keeps the last rendered image.
+///
+/// Node modifications are done through the renderer, so it can track which part
+/// of the image was changed and re-render only it.
+pub struct resvg_retained_renderer {
+    tree: *mut resvg_render_tree,
+    fit_to: usvg::FitTo,
+    pixmap: tiny_skia::Pixmap,
+    damage: Option<usvg::ScreenRect>,
+    /// The original visibility of the descendant paths and images of each hidden node,
+    /// in the `descendants()` order. Restored when the node is shown again.
+    hidden: HashMap<String, Vec<usvg::Visibility>>,
+}
+
+impl resvg_retained_renderer {
+    fn tree(&self) -> &resvg_render_tree {
+        unsafe { &*self.tree }
+    }
+
+    /// Modifies a node and marks both of its old and new rects as damaged.
+    fn modify_node<F>(&mut self, id: &str, f: F) -> bool
+        where F: FnOnce(&usvg::Node)
+    {
+        let tree = unsafe { &*self.tree };
+        let fit_to = self.fit_to;
+        let primary = tree.lock();
+        let node = match primary.node_by_id(id) {
+            Some(node) => node,
+            None => {
+                warn!("No node with '{}' ID is in the tree.", id);
+                return false;
             }
+        };
+
+        let old_rect = resvg::damage_rect(&node, fit_to);
+        f(&node);
+        let new_rect = resvg::damage_rect(&node, fit_to);
+
+        // Replicas are out of date now.
+        tree.invalidate_replicas();
+
+        for r in old_rect.into_iter().chain(new_rect) {
+            self.add_damage(r);
         }
 
-        return true;
+        true
     }
 
-    false
+    fn add_damage(&mut self, r: usvg::ScreenRect) {
+        let d = match self.damage {
+            Some(d) => d,
+            None => {
+                self.damage = Some(r);
+                return;
+            }
+        };
+
+        let x1 = d.left().min(r.left());
+        let y1 = d.top().min(r.top());
+        let x2 = d.right().max(r.right());
+        let y2 = d.bottom().max(r.bottom());
+        self.damage = usvg::ScreenRect::new(x1, y1, (x2 - x1) as u32, (y2 - y1) as u32);
+    }
 }
 
-pub fn cstr_to_str(text: *const c_char) -> Option<&'static str> {
-    let text = unsafe {
-        assert!(!text.is_null());
-        CStr::from_ptr(text)
+#[no_mangle]
+pub extern "C" fn resvg_retained_renderer_create(
+    tree: *mut resvg_render_tree,
+    fit_to: resvg_fit_to,
+) -> *mut resvg_retained_renderer {
+    let raw_tree = unsafe {
+        assert!(!tree.is_null());
+        &*tree
     };
 
-    text.to_str().ok()
+    let fit_to = fit_to.to_usvg();
+    let size = match fit_to.fit_to(raw_tree.lock().svg_node().size.to_screen_size()) {
+        Some(v) => v,
+        None => return std::ptr::null_mut(),
+    };
+
+    let pixmap = match tiny_skia::Pixmap::new(size.width(), size.height()) {
+        Some(v) => v,
+        None => return std::ptr::null_mut(),
+    };
+
+    let renderer = Box::new(resvg_retained_renderer {
+        tree,
+        fit_to,
+        pixmap,
+        damage: usvg::ScreenRect::new(0, 0, size.width(), size.height()),
+        hidden: HashMap::new(),
+    });
+
+    Box::into_raw(renderer)
 }
 
-fn convert_error(e: usvg::Error) -> ErrorId {
-    match e {
-        usvg::Error::NotAnUtf8Str => ErrorId::NotAnUtf8Str,
-        usvg::Error::MalformedGZip => ErrorId::MalformedGZip,
-        usvg::Error::ElementsLimitReached => ErrorId::ElementsLimitReached,
-        usvg::Error::InvalidSize => ErrorId::InvalidSize,
-        usvg::Error::ParsingFailed(_) => ErrorId::ParsingFailed,
-    }
+#[no_mangle]
+pub extern "C" fn resvg_retained_renderer_destroy(renderer: *mut resvg_retained_renderer) {
+    unsafe {
+        assert!(!renderer.is_null());
+        Box::from_raw(renderer)
+    };
 }
 
+#[no_mangle]
+pub extern "C" fn resvg_retained_renderer_set_node_transform(
+    renderer: *mut resvg_retained_renderer,
+    id: *const c_char,
+    ts: resvg_transform,
+) -> bool {
+    let renderer = unsafe {
+        assert!(!renderer.is_null());
+        &mut *renderer
+    };
+
+    let id = match cstr_to_str(id) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    let ts = usvg::Transform::new(ts.a, ts.b, ts.c, ts.d, ts.e, ts.f);
+    renderer.modify_node(id, |node| {
+        match *node.borrow_mut() {
+            usvg::NodeKind::Group(ref mut g) => g.transform = ts,
+            usvg::NodeKind::Path(ref mut path) => path.transform = ts,
+            usvg::NodeKind::Image(ref mut img) => img.transform = ts,
+            _ => {}
+        }
+    })
+}
 
 #[no_mangle]
-pub extern "C" fn resvg_render(
-    tree: *const resvg_render_tree,
-    fit_to: resvg_fit_to,
-    width: u32,
-    height: u32,
-    pixmap: *const c_char,
-) {
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
+pub extern "C" fn resvg_retained_renderer_set_node_visibility(
+    renderer: *mut resvg_retained_renderer,
+    id: *const c_char,
+    visible: bool,
+) -> bool {
+    let renderer = unsafe {
+        assert!(!renderer.is_null());
+        &mut *renderer
     };
 
-    let pixmap_len = width as usize * height as usize * tiny_skia::BYTES_PER_PIXEL;
-    let pixmap: &mut [u8] = unsafe { std::slice::from_raw_parts_mut(pixmap as *mut u8, pixmap_len) };
-    let pixmap = tiny_skia::PixmapMut::from_bytes(pixmap, width, height).unwrap();
+    let id = match cstr_to_str(id) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    let mut hidden = std::mem::take(&mut renderer.hidden);
+    let res = renderer.modify_node(id, |node| {
+        let visibility = |child: &usvg::Node| match *child.borrow() {
+            usvg::NodeKind::Path(ref path) => Some(path.visibility),
+            usvg::NodeKind::Image(ref img) => Some(img.visibility),
+            _ => None,
+        };
+
+        let set_visibility = |child: &usvg::Node, visibility| match *child.borrow_mut() {
+            usvg::NodeKind::Path(ref mut path) => path.visibility = visibility,
+            usvg::NodeKind::Image(ref mut img) => img.visibility = visibility,
+            _ => {}
+        };
+
+        if !visible {
+            // Hiding an already hidden node must not overwrite the original visibility.
+            if !hidden.contains_key(id) {
+                hidden.insert(id.to_string(), node.descendants().filter_map(|n| visibility(&n)).collect());
+            }
 
-    resvg::render(&tree.0, fit_to.to_usvg(), pixmap).unwrap()
+            for child in node.descendants() {
+                set_visibility(&child, usvg::Visibility::Hidden);
+            }
+        } else if let Some(original) = hidden.remove(id) {
+            let children: Vec<_> = node.descendants().filter(|n| visibility(n).is_some()).collect();
+            // Nodes could have been added or removed since. Show everything in this case.
+            if children.len() == original.len() {
+                for (child, visibility) in children.iter().zip(original) {
+                    set_visibility(child, visibility);
+                }
+            } else {
+                for child in &children {
+                    set_visibility(child, usvg::Visibility::Visible);
+                }
+            }
+        } else if visibility(node).is_some() {
+            // A path or an image that was hidden in the SVG itself.
+            set_visibility(node, usvg::Visibility::Visible);
+        }
+    });
+
+    renderer.hidden = hidden;
+    res
 }
 
 #[no_mangle]
-pub extern "C" fn resvg_render_node(
-    tree: *const resvg_render_tree,
+pub extern "C" fn resvg_retained_renderer_set_node_fill_color(
+    renderer: *mut resvg_retained_renderer,
     id: *const c_char,
-    fit_to: resvg_fit_to,
-    width: u32,
-    height: u32,
-    pixmap: *const c_char,
+    red: u8,
+    green: u8,
+    blue: u8,
+    opacity: f64,
 ) -> bool {
-    let tree = unsafe {
-        assert!(!tree.is_null());
-        &*tree
+    let renderer = unsafe {
+        assert!(!renderer.is_null());
+        &mut *renderer
     };
 
     let id = match cstr_to_str(id) {
@@ -580,23 +2010,102 @@ pub extern "C" fn resvg_render_node(
         None => return false,
     };
 
-    if id.is_empty() {
-        warn!("Node with an empty ID cannot be rendered.");
-        return false;
+    renderer.modify_node(id, |node| {
+        for child in node.descendants() {
+            // Stroke-only paths, like outlines, stay unfilled.
+            if let usvg::NodeKind::Path(ref mut path) = *child.borrow_mut() {
+                if let Some(ref mut fill) = path.fill {
+                    fill.paint = usvg::Paint::Color(usvg::Color::new(red, green, blue));
+                    fill.opacity = usvg::Opacity::new(opacity);
+                }
+            }
+        }
+    })
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_retained_renderer_update(
+    renderer: *mut resvg_retained_renderer,
+    damage: *mut resvg_rect,
+) -> bool {
+    let renderer = unsafe {
+        assert!(!renderer.is_null());
+        &mut *renderer
+    };
+
+    let rect = match renderer.damage.take() {
+        Some(v) => v,
+        None => return false,
+    };
+
+    let mut region = match tiny_skia::Pixmap::new(rect.width(), rect.height()) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    {
+        let tree = renderer.tree();
+        let render_tree = tree.render_tree();
+        let res = tree.renderer.render_region(
+            &render_tree, renderer.fit_to, rect.x(), rect.y(), region.as_mut(),
+        );
+
+        // The region without the elements that exceeded the limits is still usable.
+        match res {
+            Ok(()) | Err(resvg::RenderError::LimitReached) => {}
+            Err(_) => return false,
+        }
     }
 
-    if let Some(node) = tree.0.node_by_id(id) {
-        let pixmap_len = width as usize * height as usize * tiny_skia::BYTES_PER_PIXEL;
-        let pixmap: &mut [u8] = unsafe { std::slice::from_raw_parts_mut(pixmap as *mut u8, pixmap_len) };
-        let pixmap = tiny_skia::PixmapMut::from_bytes(pixmap, width, height).unwrap();
+    // Replace the damaged pixels.
+    let row_len = renderer.pixmap.width() as usize * tiny_skia::BYTES_PER_PIXEL;
+    let region_row_len = rect.width() as usize * tiny_skia::BYTES_PER_PIXEL;
+    let offset = rect.x() as usize * tiny_skia::BYTES_PER_PIXEL;
+    let rows = renderer.pixmap.data_mut().chunks_exact_mut(row_len).skip(rect.y() as usize);
+    for (dst, src) in rows.zip(region.data().chunks_exact(region_row_len)) {
+        dst[offset..offset + region_row_len].copy_from_slice(src);
+    }
 
-        resvg::render_node(&node, fit_to.to_usvg(), pixmap).is_some()
-    } else {
-        warn!("A node with '{}' ID wasn't found.", id);
-        false
+    if !damage.is_null() {
+        unsafe {
+            *damage = resvg_rect {
+                x: rect.x() as f64,
+                y: rect.y() as f64,
+                width: rect.width() as f64,
+                height: rect.height() as f64,
+            }
+        }
+    }
+
+    true
+}
+
+#[no_mangle]
+pub extern "C" fn resvg_retained_renderer_size(
+    renderer: *const resvg_retained_renderer,
+) -> resvg_size {
+    let renderer = unsafe {
+        assert!(!renderer.is_null());
+        &*renderer
+    };
+
+    resvg_size {
+        width: renderer.pixmap.width() as f64,
+        height: renderer.pixmap.height() as f64,
     }
 }
 
+#[no_mangle]
+pub extern "C" fn resvg_retained_renderer_data(
+    renderer: *const resvg_retained_renderer,
+) -> *const c_char {
+    let renderer = unsafe {
+        assert!(!renderer.is_null());
+        &*renderer
+    };
+
+    renderer.pixmap.data().as_ptr() as *const c_char
+}
 
 /// A simple stderr logger.
 static LOGGER: SimpleLogger = SimpleLogger;
@@ -628,3 +2137,253 @@ impl log::Log for SimpleLogger {
 
     fn flush(&self) {}
 }
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const SVG: &str = "<svg xmlns='http://www.w3.org/2000/svg' width='20' height='20'>\
+                       <rect id='rect1' width='10' height='10' fill='green'/></svg>";
+
+    fn parse_tree() -> resvg_render_tree {
+        let tree = usvg::Tree::from_str(SVG, &usvg::Options::default()).unwrap();
+        resvg_render_tree::new(tree, &resvg::Options::default())
+    }
+
+    fn target(data: &mut [u8], width: u32, height: u32) -> resvg_render_target {
+        resvg_render_target {
+            fit_to: resvg_fit_to { kind: resvg_fit_to_type::RESVG_FIT_TO_ORIGINAL, value: 0.0 },
+            width,
+            height,
+            stride: 0,
+            format: resvg_pixel_format::RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED,
+            data: data.as_mut_ptr() as *mut c_char,
+        }
+    }
+
+    fn render(tree: &resvg_render_tree) -> tiny_skia::Pixmap {
+        let mut pixmap = tiny_skia::Pixmap::new(20, 20).unwrap();
+        let render_tree = tree.render_tree();
+        tree.renderer.render(&render_tree, usvg::FitTo::Original, pixmap.as_mut()).unwrap();
+        pixmap
+    }
+
+    /// Renders the tree in another thread while the primary tree is locked for a while.
+    fn contended_render(tree: &Arc<resvg_render_tree>) -> tiny_skia::Pixmap {
+        let primary = tree.lock();
+        let thread_tree = tree.clone();
+        let handle = std::thread::spawn(move || render(&thread_tree));
+        std::thread::sleep(std::time::Duration::from_millis(100));
+        drop(primary);
+        handle.join().unwrap()
+    }
+
+    #[test]
+    fn concurrent_render() {
+        let tree = Arc::new(parse_tree());
+        let expected = render(&tree);
+        assert!(tree.source.lock().unwrap().is_none());
+
+        // The first concurrent render waits for the primary tree to create the source one.
+        assert!(contended_render(&tree).data() == expected.data());
+        assert!(tree.source.lock().unwrap().is_some());
+        tree.replicas.lock().unwrap().clear();
+
+        // Keep the primary tree busy, like a long render would.
+        let primary = tree.lock();
+
+        let (tx, rx) = std::sync::mpsc::channel();
+        let thread_tree = tree.clone();
+        std::thread::spawn(move || {
+            tx.send(render(&thread_tree)).unwrap();
+        });
+
+        let pixmap = rx.recv_timeout(std::time::Duration::from_secs(30))
+            .expect("a concurrent render was blocked by the primary tree");
+        assert!(pixmap.data() == expected.data());
+
+        drop(primary);
+    }
+
+    #[test]
+    fn save_and_load() {
+        let tree = parse_tree();
+        let len = resvg_tree_save(&tree, std::ptr::null_mut(), 0);
+        assert!(tree.binary.lock().unwrap().is_some());
+
+        let mut data = vec![0u8; len];
+        assert_eq!(resvg_tree_save(&tree, data.as_mut_ptr() as *mut c_char, len), len);
+        assert!(tree.binary.lock().unwrap().is_none());
+        assert!(data == tree.lock().to_binary());
+
+        let opt = resvg_options_create();
+        let mut loaded: *mut resvg_render_tree = std::ptr::null_mut();
+        let err = resvg_tree_load_from_buffer(data.as_ptr() as *const c_char, len, opt, &mut loaded);
+        assert_eq!(err, ErrorId::Ok as i32);
+        assert!(render(unsafe { &*loaded }).data() == render(&tree).data());
+        resvg_tree_destroy(loaded);
+
+        let err = resvg_tree_load_from_buffer(data.as_ptr() as *const c_char, len - 1, opt, &mut loaded);
+        assert_eq!(err, ErrorId::InvalidBinary as i32);
+        resvg_options_destroy(opt);
+    }
+
+    #[test]
+    fn outdated_replicas() {
+        let tree = Arc::new(parse_tree());
+
+        // Create the source tree and a replica.
+        let _ = contended_render(&tree);
+        assert_eq!(tree.replicas.lock().unwrap().len(), 1);
+
+        {
+            let primary = tree.lock();
+            primary.node_by_id("rect1").unwrap().detach();
+            tree.invalidate_replicas();
+        }
+        assert_eq!(tree.replicas.lock().unwrap().len(), 0);
+
+        // An uncontended render doesn't touch the outdated source tree.
+        let _ = tree.render_tree();
+        assert_eq!(tree.source.lock().unwrap().as_ref().unwrap().1, 0);
+
+        // A concurrent render refreshes it.
+        let expected = render(&tree);
+        assert!(contended_render(&tree).data() == expected.data());
+        assert_eq!(tree.source.lock().unwrap().as_ref().unwrap().1, 1);
+
+        // A replica created after the modification must not have the removed node.
+        let _primary = tree.lock();
+        let replica = tree.render_tree();
+        assert!(replica.node_by_id("rect1").is_none());
+    }
+
+    #[test]
+    fn target_too_large() {
+        let tree = usvg::Tree::from_str(SVG, &usvg::Options::default()).unwrap();
+        let mut opt = resvg::Options::default();
+        opt.limits.max_pixels = Some(100);
+        let tree = resvg_render_tree::new(tree, &opt);
+
+        let mut data = vec![0u8; 20 * 20 * tiny_skia::BYTES_PER_PIXEL];
+        let large = target(&mut data, 20, 20);
+        assert_eq!(resvg_render_to_target(&tree, &large), ErrorId::TargetTooLarge as i32);
+        assert_eq!(resvg_render_region(&tree, 0, 0, &large), ErrorId::TargetTooLarge as i32);
+        assert_eq!(resvg_render_batch(&tree, &large, 1), ErrorId::TargetTooLarge as i32);
+
+        let mut data = vec![0u8; 10 * 10 * tiny_skia::BYTES_PER_PIXEL];
+        let small = target(&mut data, 10, 10);
+        assert_eq!(resvg_render_region(&tree, 0, 0, &small), ErrorId::Ok as i32);
+        assert!(data.iter().any(|c| *c != 0));
+    }
+
+    #[test]
+    fn limit_reached() {
+        const SVG: &str = "<svg xmlns='http://www.w3.org/2000/svg' width='20' height='20'>\
+                           <rect width='10' height='10' fill='green'/>\
+                           <g opacity='0.5'><rect x='10' width='10' height='10'/></g></svg>";
+
+        let tree = usvg::Tree::from_str(SVG, &usvg::Options::default()).unwrap();
+        let mut opt = resvg::Options::default();
+        opt.limits.max_layers = Some(0);
+        let tree = resvg_render_tree::new(tree, &opt);
+
+        // The image without the group is still rendered.
+        let mut data = vec![0u8; 20 * 20 * tiny_skia::BYTES_PER_PIXEL];
+        let full = target(&mut data, 20, 20);
+        assert_eq!(resvg_render_region(&tree, 0, 0, &full), ErrorId::RenderLimitReached as i32);
+        assert!(data.iter().any(|c| *c != 0));
+    }
+
+    #[test]
+    fn padded_target() {
+        const ROW_LEN: usize = 20 * tiny_skia::BYTES_PER_PIXEL;
+        const STRIDE: usize = ROW_LEN + 16;
+
+        let tree = parse_tree();
+        let expected = render(&tree);
+
+        let mut data = vec![0xffu8; STRIDE * 20];
+        let mut padded = target(&mut data, 20, 20);
+        padded.stride = STRIDE as u32;
+        assert_eq!(resvg_render_to_target(&tree, &padded), ErrorId::Ok as i32);
+
+        for (row, expected) in data.chunks(STRIDE).zip(expected.data().chunks(ROW_LEN)) {
+            assert!(&row[..ROW_LEN] == expected);
+            // The padding is left untouched.
+            assert!(row[ROW_LEN..].iter().all(|c| *c == 0xff));
+        }
+    }
+
+    #[test]
+    fn retained_renderer() {
+        let tree = Box::into_raw(Box::new(parse_tree()));
+        let fit_to = resvg_fit_to { kind: resvg_fit_to_type::RESVG_FIT_TO_ORIGINAL, value: 0.0 };
+        let renderer = resvg_retained_renderer_create(tree, fit_to);
+        assert!(!renderer.is_null());
+
+        // The first update renders the whole image.
+        let mut damage = resvg_rect { x: 0.0, y: 0.0, width: 0.0, height: 0.0 };
+        assert!(resvg_retained_renderer_update(renderer, &mut damage));
+        assert_eq!((damage.width, damage.height), (20.0, 20.0));
+        assert!(!resvg_retained_renderer_update(renderer, &mut damage));
+
+        let id = std::ffi::CString::new("rect1").unwrap();
+        assert!(resvg_retained_renderer_set_node_fill_color(renderer, id.as_ptr(), 255, 0, 0, 1.0));
+        assert!(resvg_retained_renderer_update(renderer, &mut damage));
+        assert!(damage.width < 20.0 && damage.height < 20.0);
+
+        // A partial update is identical to a full render of the modified tree.
+        let expected = render(unsafe { &*tree });
+        assert!(unsafe { &*renderer }.pixmap.data() == expected.data());
+
+        resvg_retained_renderer_destroy(renderer);
+        resvg_tree_destroy(tree);
+    }
+
+    #[test]
+    fn retained_renderer_visibility_and_fill() {
+        const SVG: &str = "<svg xmlns='http://www.w3.org/2000/svg' width='20' height='20'>\
+                           <g id='g1'>\
+                           <rect id='rect1' width='10' height='10'/>\
+                           <rect id='rect2' x='10' width='10' height='10' visibility='hidden'/>\
+                           <rect id='rect3' y='10' width='10' height='10' fill='none' stroke='black'/>\
+                           </g></svg>";
+
+        let mut opt = usvg::Options::default();
+        opt.keep_named_groups = true;
+        let tree = usvg::Tree::from_str(SVG, &opt).unwrap();
+        let tree = Box::into_raw(Box::new(resvg_render_tree::new(tree, &resvg::Options::default())));
+        let fit_to = resvg_fit_to { kind: resvg_fit_to_type::RESVG_FIT_TO_ORIGINAL, value: 0.0 };
+        let renderer = resvg_retained_renderer_create(tree, fit_to);
+
+        let path = |id: &str| {
+            let primary = unsafe { &*tree }.lock();
+            let node = primary.node_by_id(id).unwrap();
+            let res = match *node.borrow() {
+                usvg::NodeKind::Path(ref path) => (path.visibility, path.fill.is_some()),
+                _ => unreachable!(),
+            };
+            res
+        };
+
+        let g1 = CString::new("g1").unwrap();
+        assert!(resvg_retained_renderer_set_node_visibility(renderer, g1.as_ptr(), false));
+        assert_eq!(path("rect1").0, usvg::Visibility::Hidden);
+
+        // Showing the group restores the original visibility.
+        assert!(resvg_retained_renderer_set_node_visibility(renderer, g1.as_ptr(), true));
+        assert_eq!(path("rect1").0, usvg::Visibility::Visible);
+        assert_eq!(path("rect2").0, usvg::Visibility::Hidden);
+        assert_eq!(path("rect3").0, usvg::Visibility::Visible);
+
+        // Stroke-only paths stay unfilled.
+        assert!(resvg_retained_renderer_set_node_fill_color(renderer, g1.as_ptr(), 255, 0, 0, 1.0));
+        assert!(path("rect1").1);
+        assert!(!path("rect3").1);
+
+        resvg_retained_renderer_destroy(renderer);
+        resvg_tree_destroy(tree);
+    }
+}
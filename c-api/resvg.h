@@ -36,9 +36,118 @@ typedef struct resvg_options resvg_options;
 
 /**
  * @brief An opaque pointer to the rendering tree.
+ *
+ * The tree can be shared between threads. All functions that take
+ * a `const resvg_render_tree*` can be called concurrently on the same tree.
+ *
+ * Concurrent renders of the same tree do not block each other.
+ * Each additional renderer transparently gets its own copy of the tree,
+ * which is kept and reused by subsequent renders.
+ * Therefore memory usage grows with the number of simultaneous renders.
+ * A tree that is never rendered concurrently has no copies.
+ *
+ * The first concurrent render, as well as the first one after a node modification,
+ * waits for the current render to finish, since copies are made from an up to date tree.
+ *
+ * #resvg_tree_destroy must not be called while the tree is still in use.
  */
 typedef struct resvg_render_tree resvg_render_tree;
 
+/**
+ * @brief An opaque pointer to the decoded images cache.
+ *
+ * Embedded PNG and JPEG images are decoded on each render by default.
+ * With a cache, each image is decoded only once and then reused
+ * by all trees that were parsed with the same cache.
+ *
+ * The cache can be shared between threads.
+ * Trees keep a reference to the cache, so it can be destroyed at any time.
+ */
+typedef struct resvg_image_cache resvg_image_cache;
+
+/**
+ * @brief An opaque pointer to the glyph outlines cache.
+ *
+ * Glyph outlines are extracted from fonts during each text conversion by default.
+ * With a cache, each outline is extracted only once and then reused
+ * by all trees that were parsed with the same cache.
+ *
+ * The cache has to be used with a single fonts database, like a shared #resvg_fontdb.
+ * Otherwise it will be cleared on each database change.
+ *
+ * The cache can be shared between threads.
+ */
+typedef struct resvg_glyph_cache resvg_glyph_cache;
+
+/**
+ * @brief An opaque pointer to the text shaping cache.
+ *
+ * Stores shaped text chunks, so the same labels used by multiple documents
+ * are shaped only once. The same restrictions as for #resvg_glyph_cache apply.
+ *
+ * The cache can be shared between threads.
+ */
+typedef struct resvg_shaping_cache resvg_shaping_cache;
+
+/**
+ * @brief An opaque pointer to the render cancellation token.
+ *
+ * The token can be canceled from any thread,
+ * which stops all renders that use it as soon as possible.
+ */
+typedef struct resvg_cancel_token resvg_cancel_token;
+
+/**
+ * @brief An opaque pointer to the per-element rendering statistics.
+ *
+ * Filled by #resvg_render_to_target_with_stats.
+ * Statistics are accumulated across renders until #resvg_render_stats_clear is called.
+ *
+ * Must not be used by multiple renders at the same time.
+ */
+typedef struct resvg_render_stats resvg_render_stats;
+
+/**
+ * @brief A render progress callback.
+ *
+ * Called by the rendering thread with a progress in a 0..1 range.
+ */
+typedef void (*resvg_progress_callback)(double progress, void *user_data);
+
+/**
+ * @brief An opaque pointer to the fonts database.
+ *
+ * Loading system fonts is very IO intensive, so instead of loading them
+ * into each #resvg_options, the same database can be shared between
+ * multiple options and threads. Font files are memory-mapped on demand.
+ *
+ * The database can be modified only before it was set to any options.
+ * Options keep a reference to the database, so it can be destroyed at any time.
+ */
+typedef struct resvg_fontdb resvg_fontdb;
+
+/**
+ * @brief An opaque pointer to the retained renderer.
+ *
+ * Keeps the last rendered image of a #resvg_render_tree.
+ * Nodes are modified through the renderer, which tracks the changed part of the image,
+ * so #resvg_retained_renderer_update re-renders only it.
+ *
+ * Useful when only a few elements of an otherwise static image are changing.
+ *
+ * The tree must outlive the renderer and must not be rendered by other threads
+ * while its nodes are being modified.
+ */
+typedef struct resvg_retained_renderer resvg_retained_renderer;
+
+/**
+ * @brief An opaque pointer to the incremental SVG parser.
+ *
+ * Accepts SVG data in chunks, so the caller doesn't have to keep a whole file in memory.
+ * A gzip compressed data is decompressed on the fly.
+ */
+typedef struct resvg_parser resvg_parser;
+
 /**
  * @brief List of possible errors.
  */
@@ -64,6 +173,34 @@ typedef enum resvg_error {
     RESVG_ERROR_INVALID_SIZE,
     /** Failed to parse an SVG data. */
     RESVG_ERROR_PARSING_FAILED,
+    /**
+     * A render target is invalid.
+     *
+     * Occurs when the target has a zero size, no data
+     * or a stride smaller than `width * 4`.
+     */
+    RESVG_ERROR_INVALID_TARGET,
+    /**
+     * A binary tree data is malformed.
+     *
+     * Also occurs when the data was saved by a different resvg version.
+     */
+    RESVG_ERROR_INVALID_BINARY,
+    /** A render was canceled via #resvg_cancel_token. */
+    RESVG_ERROR_CANCELED,
+    /**
+     * A render reached one of the render limits, like #resvg_options_set_max_layers.
+     *
+     * The target contains the image without the elements that exceeded the limits.
+     * When the render ran out of time, the elements after the last rendered one are missing.
+     */
+    RESVG_ERROR_RENDER_LIMIT_REACHED,
+    /**
+     * A render target is larger than #resvg_options_set_max_pixels allows.
+     *
+     * Nothing was rendered.
+     */
+    RESVG_ERROR_TARGET_TOO_LARGE,
 } resvg_error;
 
 /**
@@ -94,6 +231,81 @@ typedef struct resvg_fit_to {
     float value;
 } resvg_fit_to;
 
+/**
+ * @brief A pixel format.
+ *
+ * All formats are 8 bits per channel and are stored in memory
+ * in the specified order, regardless of the machine endianness.
+ */
+typedef enum resvg_pixel_format {
+    /** Premultiplied RGBA. The native resvg format, doesn't require any conversion. */
+    RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED,
+    /**
+     * Premultiplied BGRA.
+     *
+     * The same as `CAIRO_FORMAT_ARGB32` and `QImage::Format_ARGB32_Premultiplied`
+     * on little-endian machines.
+     */
+    RESVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED,
+    /** Non-premultiplied RGBA. */
+    RESVG_PIXEL_FORMAT_RGBA8888,
+    /** Non-premultiplied BGRA. */
+    RESVG_PIXEL_FORMAT_BGRA8888,
+} resvg_pixel_format;
+
+/**
+ * @brief A render target.
+ *
+ * Describes a caller-owned pixels buffer.
+ */
+typedef struct resvg_render_target {
+    /** Specifies into which region SVG should be fit. */
+    resvg_fit_to fit_to;
+    /** Buffer width in pixels. Must be > 0. */
+    uint32_t width;
+    /** Buffer height in pixels. Must be > 0. */
+    uint32_t height;
+    /**
+     * Distance between rows in bytes.
+     *
+     * Must be >= `width * 4`. 0 means `width * 4`.
+     *
+     * Only a target without a row padding is rendered in place.
+     * A padded one is rendered into a temporary buffer first
+     * and then copied row by row.
+     */
+    uint32_t stride;
+    /** Pixels format. */
+    resvg_pixel_format format;
+    /** Pixels data. Should have at least `stride * height` size. */
+    char *data;
+} resvg_render_target;
+
+/**
+ * @brief Rendering statistics of a single element.
+ *
+ * Elements with the same kind and ID are merged, so all anonymous paths,
+ * as well as all primitives of the same kind inside a filter, share a single entry.
+ */
+typedef struct resvg_node_stats {
+    /** An element kind, like `path`, `g`, `clipPath`, `mask`, `filter` or `feGaussianBlur`. */
+    const char *kind;
+    /** An element ID. Filter primitives use the ID of their filter. Can be empty. */
+    const char *id;
+    /** How many times the element was rendered. */
+    uint32_t count;
+    /** Time spent on rendering in milliseconds, including child elements. */
+    double time;
+    /** Time spent on decoding raster images in milliseconds. Already included in `time`. */
+    double decode_time;
+    /** The number of allocated layers. */
+    uint32_t layers;
+    /** The memory used by allocated layers, in bytes. */
+    uint64_t layers_memory;
+    /** The total area of filter regions and primitive subregions, in pixels. */
+    uint64_t region_pixels;
+} resvg_node_stats;
+
 /**
  * @brief A shape rendering method.
  */
@@ -303,6 +515,154 @@ void resvg_options_set_image_rendering_mode(resvg_options *opt, resvg_image_rend
  */
 void resvg_options_set_keep_named_groups(resvg_options *opt, bool keep);
 
+/**
+ * @brief Sets the maximum number of threads used to render a single image.
+ *
+ * Large filter regions are split into horizontal bands that are rendered in parallel.
+ * The result is identical to a single-threaded rendering.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * 0 indicates the number of available CPUs.
+ *
+ * Default: 1
+ */
+void resvg_options_set_threads(resvg_options *opt, uint32_t threads);
+
+/**
+ * @brief Enables a fast blur.
+ *
+ * Gaussian blurs with a standard deviation above 20 pixels will be rendered
+ * at a reduced resolution and then upscaled. Much faster for glow and shadow effects,
+ * but the result is not identical to the precise one.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * Default: false
+ */
+void resvg_options_set_fast_blur(resvg_options *opt, bool fast);
+
+/**
+ * @brief Enables dashed strokes caching.
+ *
+ * Dashed paths will be kept by the render tree and reused by the following renders,
+ * as long as the image is only translated or scaled down by up to a factor of two.
+ * Useful for interactive viewers.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * Default: false
+ */
+void resvg_options_set_path_cache(resvg_options *opt, bool enabled);
+
+/**
+ * @brief Sets the maximum number of pixels in a render target.
+ *
+ * A render into a larger target fails with RESVG_ERROR_TARGET_TOO_LARGE.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * 0 indicates no limit.
+ *
+ * Default: 0
+ */
+void resvg_options_set_max_pixels(resvg_options *opt, uint64_t pixels);
+
+/**
+ * @brief Sets the maximum amount of memory used by layers during a single render, in bytes.
+ *
+ * Groups with opacity, filters, clip paths and masks are rendered onto layers.
+ * Elements that require a layer above this limit are not rendered.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * 0 indicates no limit.
+ *
+ * Default: 0
+ */
+void resvg_options_set_max_layers_memory(resvg_options *opt, size_t bytes);
+
+/**
+ * @brief Sets the maximum number of layers used at the same time during a single render.
+ *
+ * Basically, limits the nesting depth of groups that require a layer.
+ * Elements that require a layer above this limit are not rendered.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * 0 indicates no limit.
+ *
+ * Default: 0
+ */
+void resvg_options_set_max_layers(resvg_options *opt, uint32_t layers);
+
+/**
+ * @brief Sets the maximum filter region area in pixels.
+ *
+ * Elements with a larger filter region are not rendered.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * 0 indicates no limit.
+ *
+ * Default: 0
+ */
+void resvg_options_set_max_filter_area(resvg_options *opt, uint64_t pixels);
+
+/**
+ * @brief Sets the maximum duration of a single render in milliseconds.
+ *
+ * The render stops once the time is out and fails with RESVG_ERROR_RENDER_LIMIT_REACHED.
+ * The time is checked between nodes and between filter primitives.
+ *
+ * Affects only trees parsed after this call.
+ *
+ * 0 indicates no limit.
+ *
+ * Default: 0
+ */
+void resvg_options_set_render_timeout(resvg_options *opt, uint32_t ms);
+
+/**
+ * @brief Sets a decoded images cache.
+ *
+ * Affects only trees parsed after this call.
+ * Trees parsed with the same cache share decoded images.
+ *
+ * Can be set to NULL.
+ *
+ * Default: NULL
+ */
+void resvg_options_set_image_cache(resvg_options *opt, const resvg_image_cache *cache);
+
+/**
+ * @brief Sets a glyph outlines cache.
+ *
+ * Can be set to NULL.
+ *
+ * Default: NULL
+ */
+void resvg_options_set_glyph_cache(resvg_options *opt, const resvg_glyph_cache *cache);
+
+/**
+ * @brief Sets a text shaping cache.
+ *
+ * Can be set to NULL.
+ *
+ * Default: NULL
+ */
+void resvg_options_set_shaping_cache(resvg_options *opt, const resvg_shaping_cache *cache);
+
+/**
+ * @brief Sets a shared fonts database.
+ *
+ * Replaces the options' own database, including fonts that were loaded into it.
+ *
+ * Fonts loading and generic font families setting functions
+ * have no effect on options with a shared database.
+ */
+void resvg_options_set_fontdb(resvg_options *opt, const resvg_fontdb *fontdb);
+
 /**
  * @brief Loads a font data into the internal fonts database.
  *
@@ -338,11 +698,184 @@ void resvg_options_load_system_fonts(resvg_options *opt);
  */
 void resvg_options_destroy(resvg_options *opt);
 
+/**
+ * @brief Creates a new, empty #resvg_fontdb.
+ *
+ * Should be destroyed via #resvg_fontdb_destroy.
+ */
+resvg_fontdb* resvg_fontdb_create(void);
+
+/**
+ * @brief Loads system fonts into the #resvg_fontdb.
+ *
+ * Also sets the generic font families.
+ *
+ * Has no effect when the database was already set to options.
+ */
+void resvg_fontdb_load_system_fonts(resvg_fontdb *fontdb);
+
+/**
+ * @brief Loads a font file into the #resvg_fontdb.
+ *
+ * Has no effect when the database was already set to options.
+ *
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_NOT_AN_UTF8_STR or RESVG_ERROR_FILE_OPEN_FAILED
+ */
+int resvg_fontdb_load_font_file(resvg_fontdb *fontdb, const char *file_path);
+
+/**
+ * @brief Destroys the #resvg_fontdb.
+ *
+ * Options that use this database will keep it alive until they are destroyed.
+ */
+void resvg_fontdb_destroy(resvg_fontdb *fontdb);
+
+/**
+ * @brief Creates a new #resvg_image_cache.
+ *
+ * Should be destroyed via #resvg_image_cache_destroy.
+ *
+ * @param budget The maximum amount of memory used by decoded images in bytes.
+ *               The least recently used images are removed first.
+ */
+resvg_image_cache* resvg_image_cache_create(size_t budget);
+
+/**
+ * @brief Removes all images from the #resvg_image_cache.
+ */
+void resvg_image_cache_clear(const resvg_image_cache *cache);
+
+/**
+ * @brief Destroys the #resvg_image_cache.
+ *
+ * Trees that use this cache will keep it alive until they are destroyed.
+ */
+void resvg_image_cache_destroy(resvg_image_cache *cache);
+
+/**
+ * @brief Creates a new #resvg_glyph_cache.
+ *
+ * Should be destroyed via #resvg_glyph_cache_destroy.
+ *
+ * @param budget The maximum amount of memory used by outlines in bytes.
+ *               The cache is flushed when the budget is exceeded.
+ */
+resvg_glyph_cache* resvg_glyph_cache_create(size_t budget);
+
+/**
+ * @brief Removes all outlines from the #resvg_glyph_cache.
+ */
+void resvg_glyph_cache_clear(const resvg_glyph_cache *cache);
+
+/**
+ * @brief Destroys the #resvg_glyph_cache.
+ *
+ * Options that use this cache will keep it alive until they are destroyed.
+ */
+void resvg_glyph_cache_destroy(resvg_glyph_cache *cache);
+
+/**
+ * @brief Creates a new #resvg_shaping_cache.
+ *
+ * Should be destroyed via #resvg_shaping_cache_destroy.
+ *
+ * @param budget The maximum amount of memory used by shaped text in bytes.
+ *               The cache is flushed when the budget is exceeded.
+ */
+resvg_shaping_cache* resvg_shaping_cache_create(size_t budget);
+
+/**
+ * @brief Removes all shaped text from the #resvg_shaping_cache.
+ */
+void resvg_shaping_cache_clear(const resvg_shaping_cache *cache);
+
+/**
+ * @brief Destroys the #resvg_shaping_cache.
+ *
+ * Options that use this cache will keep it alive until they are destroyed.
+ */
+void resvg_shaping_cache_destroy(resvg_shaping_cache *cache);
+
+/**
+ * @brief Creates a new #resvg_cancel_token.
+ *
+ * Should be destroyed via #resvg_cancel_token_destroy.
+ */
+resvg_cancel_token* resvg_cancel_token_create(void);
+
+/**
+ * @brief Cancels all renders that use the #resvg_cancel_token.
+ *
+ * Can be called from any thread.
+ */
+void resvg_cancel_token_cancel(const resvg_cancel_token *token);
+
+/**
+ * @brief Resets the #resvg_cancel_token, so it can be used by a new render.
+ */
+void resvg_cancel_token_reset(const resvg_cancel_token *token);
+
+/**
+ * @brief Checks that the #resvg_cancel_token was canceled.
+ */
+bool resvg_cancel_token_is_canceled(const resvg_cancel_token *token);
+
+/**
+ * @brief Destroys the #resvg_cancel_token.
+ *
+ * Must not be called while the token is still used by a render.
+ */
+void resvg_cancel_token_destroy(resvg_cancel_token *token);
+
+/**
+ * @brief Creates a new, empty #resvg_render_stats.
+ *
+ * Should be destroyed via #resvg_render_stats_destroy.
+ */
+resvg_render_stats* resvg_render_stats_create(void);
+
+/**
+ * @brief Returns the number of elements in the #resvg_render_stats.
+ */
+size_t resvg_render_stats_count(const resvg_render_stats *stats);
+
+/**
+ * @brief Returns the statistics of an element.
+ *
+ * Elements are sorted by time, the slowest one first.
+ * Strings are valid until the next render with these statistics,
+ * #resvg_render_stats_clear or #resvg_render_stats_destroy.
+ *
+ * @param stats Rendering statistics.
+ * @param index An element index. Must be less than #resvg_render_stats_count.
+ * @param node Element statistics.
+ * @return `false` if the index is out of bounds.
+ */
+bool resvg_render_stats_get(const resvg_render_stats *stats,
+                            size_t index,
+                            resvg_node_stats *node);
+
+/**
+ * @brief Removes all collected statistics.
+ */
+void resvg_render_stats_clear(resvg_render_stats *stats);
+
+/**
+ * @brief Destroys the #resvg_render_stats.
+ */
+void resvg_render_stats_destroy(resvg_render_stats *stats);
+
 /**
  * @brief Creates #resvg_render_tree from file.
  *
  * .svg and .svgz files are supported.
  *
+ * Regular files larger than 1MiB are memory-mapped instead of being read into memory.
+ * The file is accessed only during this call. It must not be truncated in the meantime:
+ * on most systems, accessing the truncated part of a mapped file raises SIGBUS,
+ * which terminates the process. Use #resvg_parse_tree_from_data
+ * for files that can be truncated by other processes.
+ *
  * See #resvg_is_image_empty for details.
  *
  * @param file_path UTF-8 file path.
@@ -357,6 +890,9 @@ int resvg_parse_tree_from_file(const char *file_path,
 /**
  * @brief Creates #resvg_render_tree from data.
  *
+ * The data is not copied and is not referenced after this call,
+ * so it can be a memory-mapped file or any other temporary buffer.
+ *
  * See #resvg_is_image_empty for details.
  *
  * @param data SVG data. Can contain SVG string or gzip compressed data.
@@ -370,6 +906,82 @@ int resvg_parse_tree_from_data(const char *data,
                                const resvg_options *opt,
                                resvg_render_tree **tree);
 
+/**
+ * @brief Creates #resvg_render_tree from data saved via #resvg_tree_save.
+ *
+ * Unlike #resvg_parse_tree_from_data, doesn't parse an SVG, which is much faster.
+ * The data is not referenced after loading, so it can be a memory-mapped file.
+ *
+ * @param data Binary tree data.
+ * @param len Data length.
+ * @param opt Rendering options. Only rendering-related options are used.
+ * @param tree Loaded render tree. Should be destroyed via #resvg_tree_destroy.
+ * @return #resvg_error with RESVG_OK or RESVG_ERROR_INVALID_BINARY
+ */
+int resvg_tree_load_from_buffer(const char *data,
+                                const size_t len,
+                                const resvg_options *opt,
+                                resvg_render_tree **tree);
+
+/**
+ * @brief Creates a new #resvg_parser.
+ *
+ * Should be passed to #resvg_parser_finish or destroyed via #resvg_parser_destroy.
+ */
+resvg_parser* resvg_parser_create();
+
+/**
+ * @brief Appends a chunk of SVG data to the #resvg_parser.
+ *
+ * @param parser An incremental parser.
+ * @param data SVG data chunk. Can be a part of an SVG string or of a gzip compressed data.
+ * @param len Data length.
+ * @return #resvg_error with RESVG_OK or RESVG_ERROR_MALFORMED_GZIP
+ */
+int resvg_parser_feed(resvg_parser *parser, const char *data, const size_t len);
+
+/**
+ * @brief Creates #resvg_render_tree from data fed to the #resvg_parser.
+ *
+ * The XML document and the intermediate SVG representation are deallocated
+ * before the render tree construction, so the peak memory usage is lower
+ * than with #resvg_parse_tree_from_data.
+ *
+ * The parser is destroyed by this call regardless of the result.
+ *
+ * See #resvg_is_image_empty for details.
+ *
+ * @param parser An incremental parser.
+ * @param opt Rendering options.
+ * @param tree Parsed render tree. Should be destroyed via #resvg_tree_destroy.
+ * @return #resvg_error
+ */
+int resvg_parser_finish(resvg_parser *parser,
+                        const resvg_options *opt,
+                        resvg_render_tree **tree);
+
+/**
+ * @brief Destroys an unfinished #resvg_parser.
+ */
+void resvg_parser_destroy(resvg_parser *parser);
+
+/**
+ * @brief Saves #resvg_render_tree into a compact binary format.
+ *
+ * The data can be loaded via #resvg_tree_load_from_buffer
+ * by the same resvg version.
+ *
+ * Call with `NULL` data first to get the required buffer size.
+ * The data serialized by this call is kept until the following one,
+ * so the tree is serialized only once.
+ *
+ * @param tree Render tree.
+ * @param data A buffer for the binary data. Can be `NULL`.
+ * @param len Buffer length.
+ * @return The binary data size. Nothing is written when it's bigger than `len`.
+ */
+size_t resvg_tree_save(const resvg_render_tree *tree, char *data, size_t len);
+
 /**
  * @brief Checks that tree has any nodes.
  *
@@ -452,6 +1064,17 @@ bool resvg_get_node_bbox(const resvg_render_tree *tree,
                          const char *id,
                          resvg_rect *bbox);
 
+/**
+ * @brief Deallocates scratch buffers and tree copies kept between renders.
+ *
+ * A tree keeps layers, generated filter images and cached paths between renders,
+ * as well as tree copies used by concurrent renders.
+ * They will be allocated again by the next render.
+ *
+ * Can be called while the tree is being rendered.
+ */
+void resvg_tree_clear_cache(const resvg_render_tree *tree);
+
 /**
  * @brief Destroys the #resvg_render_tree.
  */
@@ -466,6 +1089,10 @@ void resvg_tree_destroy(resvg_render_tree *tree);
  * @param height Pixmap height.
  * @param pixmap Pixmap data. Should have width*height*4 size and contain
  *               premultiplied RGBA8888 pixels.
+ *
+ * Errors, like a reached render limit, are only logged.
+ * Use #resvg_render_to_target to get them.
+ * When the target exceeds the pixels limit, the pixmap is left untouched.
  */
 void resvg_render(const resvg_render_tree *tree,
                   resvg_fit_to fit_to,
@@ -473,6 +1100,133 @@ void resvg_render(const resvg_render_tree *tree,
                   uint32_t height,
                   char* pixmap);
 
+/**
+ * @brief Renders the #resvg_render_tree into the render target.
+ *
+ * Unlike #resvg_render, the target content is not preserved
+ * and will be overwritten.
+ *
+ * Rendering into a target without a row padding
+ * and with the `RESVG_PIXEL_FORMAT_RGBA8888_PREMULTIPLIED` format is the fastest one,
+ * but any other target doesn't require an additional pass from the caller.
+ *
+ * @param tree A render tree.
+ * @param target A render target.
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_INVALID_TARGET, RESVG_ERROR_INVALID_SIZE,
+ *         RESVG_ERROR_RENDER_LIMIT_REACHED or RESVG_ERROR_TARGET_TOO_LARGE
+ */
+int resvg_render_to_target(const resvg_render_tree *tree,
+                           const resvg_render_target *target);
+
+/**
+ * @brief Renders the #resvg_render_tree into the render target
+ *        with a progress reporting and cancellation.
+ *
+ * The same as #resvg_render_to_target, but the render can be stopped
+ * from another thread via #resvg_cancel_token_cancel.
+ * Cancellation is checked between nodes and between filter primitives.
+ * The target content is undefined after a canceled render.
+ *
+ * @param tree A render tree.
+ * @param target A render target.
+ * @param cancel A cancellation token. Can be NULL.
+ * @param progress A progress callback. Can be NULL.
+ * @param user_data A pointer passed to the progress callback.
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_INVALID_TARGET, RESVG_ERROR_INVALID_SIZE,
+ *         RESVG_ERROR_CANCELED, RESVG_ERROR_RENDER_LIMIT_REACHED or RESVG_ERROR_TARGET_TOO_LARGE
+ */
+int resvg_render_to_target_with_control(const resvg_render_tree *tree,
+                                        const resvg_render_target *target,
+                                        const resvg_cancel_token *cancel,
+                                        resvg_progress_callback progress,
+                                        void *user_data);
+
+/**
+ * @brief Renders a fast, low quality preview of the #resvg_render_tree into the render target.
+ *
+ * The image is rendered at half the resolution and upscaled, so filters
+ * cost about a quarter of a normal render. Anti-aliasing is disabled
+ * and raster images and patterns use the nearest filtering.
+ *
+ * Meant for an interactive display: show the preview first and then replace it
+ * with the result of #resvg_render_to_target_with_control.
+ *
+ * @param tree A render tree.
+ * @param target A render target.
+ * @param cancel A cancellation token. Can be NULL.
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_INVALID_TARGET, RESVG_ERROR_INVALID_SIZE,
+ *         RESVG_ERROR_CANCELED, RESVG_ERROR_RENDER_LIMIT_REACHED or RESVG_ERROR_TARGET_TOO_LARGE
+ */
+int resvg_render_preview_to_target(const resvg_render_tree *tree,
+                                   const resvg_render_target *target,
+                                   const resvg_cancel_token *cancel);
+
+/**
+ * @brief Renders the #resvg_render_tree into the render target
+ *        and collects per-element rendering statistics.
+ *
+ * The same as #resvg_render_to_target, but a bit slower,
+ * since each element, layer and filter primitive is measured.
+ *
+ * @param tree A render tree.
+ * @param target A render target.
+ * @param stats Rendering statistics. Must not be NULL.
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_INVALID_TARGET, RESVG_ERROR_INVALID_SIZE,
+ *         RESVG_ERROR_RENDER_LIMIT_REACHED or RESVG_ERROR_TARGET_TOO_LARGE
+ */
+int resvg_render_to_target_with_stats(const resvg_render_tree *tree,
+                                      const resvg_render_target *target,
+                                      resvg_render_stats *stats);
+
+/**
+ * @brief Renders a region of the #resvg_render_tree into the render target.
+ *
+ * The target `fit_to` defines the size of the whole image,
+ * while the target itself contains only a part of it
+ * and has the size of this part.
+ *
+ * Allows rendering huge images tile by tile, while using only a tile-sized memory.
+ * Tiles do not have seams, therefore they can be rendered in parallel
+ * and then combined into a single image.
+ *
+ * The target content is overwritten.
+ *
+ * @param tree A render tree.
+ * @param x Region's left edge position in the image.
+ * @param y Region's top edge position in the image.
+ * @param target A render target.
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_INVALID_TARGET, RESVG_ERROR_INVALID_SIZE,
+ *         RESVG_ERROR_RENDER_LIMIT_REACHED or RESVG_ERROR_TARGET_TOO_LARGE
+ */
+int resvg_render_region(const resvg_render_tree *tree,
+                        int32_t x,
+                        int32_t y,
+                        const resvg_render_target *target);
+
+/**
+ * @brief Renders the #resvg_render_tree into multiple render targets at once.
+ *
+ * Useful for rendering the same image in multiple sizes, like icons.
+ * Size-independent work, like raster images decoding, is done only once per batch,
+ * even when the tree has no images cache.
+ *
+ * When the tree was parsed with more than one thread set via #resvg_options_set_threads,
+ * targets are rendered in parallel.
+ *
+ * All targets are validated before rendering and must not overlap.
+ * The targets content is overwritten.
+ *
+ * @param tree A render tree.
+ * @param targets An array of render targets.
+ * @param len The number of targets.
+ * @return #resvg_error with RESVG_OK, RESVG_ERROR_INVALID_TARGET, RESVG_ERROR_INVALID_SIZE,
+ *         RESVG_ERROR_RENDER_LIMIT_REACHED or RESVG_ERROR_TARGET_TOO_LARGE.
+ *         When multiple targets fail, the error of the first failed one is returned.
+ */
+int resvg_render_batch(const resvg_render_tree *tree,
+                       const resvg_render_target *targets,
+                       size_t len);
+
 /**
  * @brief Renders a Node by ID onto the image.
  *
@@ -486,6 +1240,8 @@ void resvg_render(const resvg_render_tree *tree,
  * @return `false` when `id` is not a non-empty UTF-8 string.
  * @return `false` when the selected `id` is not present.
  * @return `false` when an element has a zero bbox.
+ * @return `false` when the pixmap is larger than #resvg_options_set_max_pixels allows
+ *         or a render limit was reached.
  */
 bool resvg_render_node(const resvg_render_tree *tree,
                        const char *id,
@@ -494,6 +1250,98 @@ bool resvg_render_node(const resvg_render_tree *tree,
                        uint32_t height,
                        char* pixmap);
 
+/**
+ * @brief Creates a new #resvg_retained_renderer.
+ *
+ * The whole image will be rendered on the first #resvg_retained_renderer_update call.
+ *
+ * Should be destroyed via #resvg_retained_renderer_destroy.
+ *
+ * @param tree A render tree.
+ * @param fit_to Specifies into which region the image should be fit.
+ * @return `NULL` when the image size is invalid.
+ */
+resvg_retained_renderer* resvg_retained_renderer_create(resvg_render_tree *tree,
+                                                        resvg_fit_to fit_to);
+
+/**
+ * @brief Sets the node's transform.
+ *
+ * Unlike #resvg_get_node_transform, the transform is relative to the node's parent.
+ *
+ * @param renderer A retained renderer.
+ * @param id Node's ID.
+ * @param ts A new transform.
+ * @return `false` when the selected `id` is not present.
+ */
+bool resvg_retained_renderer_set_node_transform(resvg_retained_renderer *renderer,
+                                                const char *id,
+                                                resvg_transform ts);
+
+/**
+ * @brief Shows or hides the node.
+ *
+ * When the node is a group, affects all its descendants.
+ * Showing a node hidden by this function restores the original visibility
+ * of its descendants, so the ones that were hidden in the SVG stay hidden.
+ *
+ * @param renderer A retained renderer.
+ * @param id Node's ID.
+ * @param visible The node visibility.
+ * @return `false` when the selected `id` is not present.
+ */
+bool resvg_retained_renderer_set_node_visibility(resvg_retained_renderer *renderer,
+                                                 const char *id,
+                                                 bool visible);
+
+/**
+ * @brief Fills the node with a color.
+ *
+ * When the node is a group, affects all its descendant paths.
+ * Only existing fills are replaced, so paths without a fill, like outlines, stay unfilled.
+ *
+ * @param renderer A retained renderer.
+ * @param id Node's ID.
+ * @param red Red component.
+ * @param green Green component.
+ * @param blue Blue component.
+ * @param opacity Fill opacity in a 0..1 range.
+ * @return `false` when the selected `id` is not present.
+ */
+bool resvg_retained_renderer_set_node_fill_color(resvg_retained_renderer *renderer,
+                                                 const char *id,
+                                                 uint8_t red,
+                                                 uint8_t green,
+                                                 uint8_t blue,
+                                                 double opacity);
+
+/**
+ * @brief Re-renders the part of the image changed since the last update.
+ *
+ * @param renderer A retained renderer.
+ * @param damage The re-rendered rect in the image coordinates. Can be `NULL`.
+ * @return `false` when nothing was changed.
+ */
+bool resvg_retained_renderer_update(resvg_retained_renderer *renderer, resvg_rect *damage);
+
+/**
+ * @brief Returns the image size.
+ */
+resvg_size resvg_retained_renderer_size(const resvg_retained_renderer *renderer);
+
+/**
+ * @brief Returns the image pixels.
+ *
+ * Contains width*height*4 bytes of premultiplied RGBA8888 pixels.
+ * The pointer is valid until the renderer is destroyed.
+ */
+const char* resvg_retained_renderer_data(const resvg_retained_renderer *renderer);
+
+/**
+ * @brief Destroys the #resvg_retained_renderer.
+ */
+void resvg_retained_renderer_destroy(resvg_retained_renderer *renderer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,8 +23,8 @@ fn main() {
     // Get file's absolute directory.
     opt.resources_dir = std::fs::canonicalize(&args[1]).ok().and_then(|p| p.parent().map(|p| p.to_path_buf()));
     opt.keep_named_groups = true;
-    opt.fontdb.load_system_fonts();
-    opt.fontdb.set_generic_families();
+    opt.fontdb_mut().load_system_fonts();
+    opt.fontdb_mut().set_generic_families();
     let fit_to = usvg::FitTo::Zoom(zoom);
 
     let svg_data = std::fs::read(&args[1]).unwrap();
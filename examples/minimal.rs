@@ -10,8 +10,8 @@ fn main() {
     let mut opt = usvg::Options::default();
     // Get file's absolute directory.
     opt.resources_dir = std::fs::canonicalize(&args[1]).ok().and_then(|p| p.parent().map(|p| p.to_path_buf()));
-    opt.fontdb.load_system_fonts();
-    opt.fontdb.set_generic_families();
+    opt.fontdb_mut().load_system_fonts();
+    opt.fontdb_mut().set_generic_families();
 
     let svg_data = std::fs::read(&args[1]).unwrap();
     let rtree = usvg::Tree::from_data(&svg_data, &opt).unwrap();
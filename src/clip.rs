@@ -10,11 +10,31 @@ pub fn clip(
     bbox: Rect,
     canvas: &mut Canvas,
 ) {
-    let mut clip_pixmap = try_opt!(tiny_skia::Pixmap::new(canvas.pixmap.width(), canvas.pixmap.height()));
+    canvas.timed("clipPath", node, |canvas| clip_impl(node, cp, bbox, canvas))
+}
+
+fn clip_impl(
+    node: &usvg::Node,
+    cp: &usvg::ClipPath,
+    bbox: Rect,
+    canvas: &mut Canvas,
+) {
+    if clip_rect(node, cp, bbox, canvas) {
+        return;
+    }
+
+    let mut clip_pixmap = match canvas.take_layer(canvas.pixmap.width(), canvas.pixmap.height()) {
+        Some(pixmap) => pixmap,
+        None => {
+            // An element that cannot be clipped should not be rendered at all.
+            canvas.pixmap.fill(tiny_skia::Color::TRANSPARENT);
+            return;
+        }
+    };
+    canvas.record_layer("clipPath", &node.id(), &clip_pixmap);
     clip_pixmap.fill(tiny_skia::Color::BLACK);
 
-    let mut clip_canvas = Canvas::from(clip_pixmap.as_mut());
-    clip_canvas.transform = canvas.transform;
+    let mut clip_canvas = canvas.new_layer(clip_pixmap.as_mut(), 0, 0);
     clip_canvas.apply_transform(cp.transform.to_native());
 
     if cp.units == usvg::Units::ObjectBoundingBox {
@@ -28,7 +48,6 @@ pub fn clip(
         match *node.borrow() {
             usvg::NodeKind::Path(ref path_node) => {
                 crate::path::draw(
-                    &node.tree(),
                     path_node,
                     tiny_skia::BlendMode::Clear,
                     &mut clip_canvas,
@@ -44,7 +63,7 @@ pub fn clip(
     }
 
     if let Some(ref id) = cp.clip_path {
-        if let Some(ref clip_node) = node.tree().defs_by_id(id) {
+        if let Some(ref clip_node) = canvas.tree.defs_by_id(id) {
             if let usvg::NodeKind::ClipPath(ref cp) = *clip_node.borrow() {
                 clip(clip_node, cp, bbox, canvas);
             }
@@ -55,6 +74,93 @@ pub fn clip(
     paint.blend_mode = tiny_skia::BlendMode::DestinationOut;
     canvas.pixmap.draw_pixmap(0, 0, clip_pixmap.as_ref(), &paint,
                               tiny_skia::Transform::identity(), None);
+    canvas.release_layer(clip_pixmap);
+}
+
+/// Clips a canvas by a rectangle without allocating a layer.
+///
+/// Exported artwork uses rectangular clip paths on nearly every element.
+///
+/// Returns `false` when the clip path is not a single axis-aligned rectangle.
+fn clip_rect(
+    node: &usvg::Node,
+    cp: &usvg::ClipPath,
+    bbox: Rect,
+    canvas: &mut Canvas,
+) -> bool {
+    if cp.clip_path.is_some() {
+        return false;
+    }
+
+    let child = match node.first_child() {
+        Some(child) if child.next_sibling().is_none() => child,
+        _ => return false,
+    };
+
+    let mut ts = canvas.transform.pre_concat(cp.transform.to_native());
+    if cp.units == usvg::Units::ObjectBoundingBox {
+        ts = ts.pre_concat(usvg::Transform::from_bbox(bbox).to_native());
+    }
+    ts = ts.pre_concat(child.transform().to_native());
+
+    let (rect, anti_alias) = match *child.borrow() {
+        usvg::NodeKind::Path(ref path) => {
+            // A stroke is drawn into a clip path as well.
+            if path.visibility != usvg::Visibility::Visible
+                || path.fill.is_none() || path.stroke.is_some()
+            {
+                return false;
+            }
+
+            match crate::path::device_rect(&path.data, ts) {
+                Some(rect) => {
+                    let anti_alias = path.rendering_mode.use_shape_antialiasing()
+                        && !canvas.is_preview();
+                    (rect, anti_alias)
+                }
+                None => return false,
+            }
+        }
+        _ => return false,
+    };
+
+    clear_outside(rect, anti_alias, canvas);
+    true
+}
+
+/// Clears a canvas outside of a pixmap rect.
+pub fn clear_outside(rect: tiny_skia::Rect, anti_alias: bool, canvas: &mut Canvas) {
+    let w = canvas.pixmap.width() as f32;
+    let h = canvas.pixmap.height() as f32;
+
+    // Cut the rect out of a slightly larger than the pixmap one.
+    // The rect can be way larger than the pixmap, so it's trimmed as well.
+    let mut pb = tiny_skia::PathBuilder::new();
+    pb.move_to(-1.0, -1.0);
+    pb.line_to(w + 1.0, -1.0);
+    pb.line_to(w + 1.0, h + 1.0);
+    pb.line_to(-1.0, h + 1.0);
+    pb.close();
+
+    let left = rect.left().max(-2.0);
+    let top = rect.top().max(-2.0);
+    let right = rect.right().min(w + 2.0);
+    let bottom = rect.bottom().min(h + 2.0);
+    if left < right && top < bottom {
+        pb.move_to(left, top);
+        pb.line_to(right, top);
+        pb.line_to(right, bottom);
+        pb.line_to(left, bottom);
+        pb.close();
+    }
+
+    let path = try_opt!(pb.finish());
+
+    let mut paint = tiny_skia::Paint::default();
+    paint.anti_alias = anti_alias;
+    paint.blend_mode = tiny_skia::BlendMode::Clear;
+    canvas.pixmap.fill_path(&path, &paint, tiny_skia::FillRule::EvenOdd,
+                            tiny_skia::Transform::identity(), None);
 }
 
 fn clip_group(
@@ -64,15 +170,14 @@ fn clip_group(
     canvas: &mut Canvas,
 ) {
     if let Some(ref id) = g.clip_path {
-        if let Some(ref clip_node) = node.tree().defs_by_id(id) {
+        if let Some(ref clip_node) = canvas.tree.defs_by_id(id) {
             if let usvg::NodeKind::ClipPath(ref cp) = *clip_node.borrow() {
                 // If a `clipPath` child also has a `clip-path`
                 // then we should render this child on a new canvas,
                 // clip it, and only then draw it to the `clipPath`.
 
-                let mut clip_pixmap = try_opt!(tiny_skia::Pixmap::new(canvas.pixmap.width(), canvas.pixmap.height()));
-                let mut clip_canvas = Canvas::from(clip_pixmap.as_mut());
-                clip_canvas.transform = canvas.transform;
+                let mut clip_pixmap = try_opt!(canvas.take_layer(canvas.pixmap.width(), canvas.pixmap.height()));
+                let mut clip_canvas = canvas.new_layer(clip_pixmap.as_mut(), 0, 0);
 
                 draw_group_child(node, &mut clip_canvas);
                 clip(clip_node, cp, bbox, &mut clip_canvas);
@@ -81,6 +186,7 @@ fn clip_group(
                 paint.blend_mode = tiny_skia::BlendMode::Xor;
                 canvas.pixmap.draw_pixmap(0, 0, clip_pixmap.as_ref(), &paint,
                                           tiny_skia::Transform::identity(), None);
+                canvas.release_layer(clip_pixmap);
             }
         }
     }
@@ -91,7 +197,7 @@ fn draw_group_child(node: &usvg::Node, canvas: &mut Canvas) {
         canvas.apply_transform(child.transform().to_native());
 
          if let usvg::NodeKind::Path(ref path_node) = *child.borrow() {
-                crate::path::draw(&child.tree(), path_node, tiny_skia::BlendMode::SourceOver, canvas);
+                crate::path::draw(path_node, tiny_skia::BlendMode::SourceOver, canvas);
         }
     }
 }
@@ -0,0 +1,384 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::cell::Cell;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::time::{Duration, Instant};
+
+use log::warn;
+
+use crate::stats::RenderStats;
+
+/// A render cancellation flag.
+///
+/// Can be shared between threads, so a render running on a worker thread
+/// can be stopped from any other thread.
+#[derive(Default, Debug)]
+pub struct CancelToken {
+    canceled: AtomicBool,
+}
+
+impl CancelToken {
+    /// Creates a new, not canceled token.
+    pub fn new() -> Self {
+        CancelToken::default()
+    }
+
+    /// Requests all renders that use this token to stop.
+    pub fn cancel(&self) {
+        self.canceled.store(true, Ordering::Relaxed);
+    }
+
+    /// Resets the token, so it can be used by a new render.
+    pub fn reset(&self) {
+        self.canceled.store(false, Ordering::Relaxed);
+    }
+
+    /// Checks that the token was canceled.
+    pub fn is_canceled(&self) -> bool {
+        self.canceled.load(Ordering::Relaxed)
+    }
+}
+
+
+/// Per-render resource limits.
+///
+/// Protects against files that are small, but very expensive to render,
+/// like deeply nested groups, huge filter regions or heavy blurs.
+///
+/// Most limits degrade the result instead of failing the whole render:
+/// an element that exceeds a limit is simply not rendered.
+/// `Renderer::render_with_control` reports `RenderError::LimitReached` in this case.
+///
+/// `None` indicates no limit.
+#[derive(Clone, Copy, PartialEq, Default, Debug)]
+pub struct Limits {
+    /// The maximum number of pixels in the target pixmap.
+    ///
+    /// A larger render fails right away with `RenderError::TargetTooLarge`.
+    ///
+    /// Default: None
+    pub max_pixels: Option<u64>,
+
+    /// The maximum amount of memory used by layers at the same time, in bytes.
+    ///
+    /// Groups, clip paths and masks that require a layer above this limit are skipped.
+    /// Pattern tiles are counted as well, both while rendered and while cached.
+    ///
+    /// Default: None
+    pub max_layers_memory: Option<usize>,
+
+    /// The maximum number of layers at the same time.
+    ///
+    /// Basically, limits the nesting depth of groups that require a layer.
+    ///
+    /// Default: None
+    pub max_layers: Option<usize>,
+
+    /// The maximum filter region area in pixels.
+    ///
+    /// Elements with a larger filter region are skipped.
+    ///
+    /// Default: None
+    pub max_filter_area: Option<u64>,
+
+    /// The maximum render duration.
+    ///
+    /// The render stops once it expires, just like when it was canceled.
+    ///
+    /// Default: None
+    pub timeout: Option<Duration>,
+}
+
+
+/// A controlled render error.
+#[derive(Clone, Copy, PartialEq, Debug)]
+pub enum RenderError {
+    /// The target size is zero or cannot be calculated.
+    InvalidSize,
+    /// The render was canceled via `CancelToken`.
+    ///
+    /// The pixmap content is undefined.
+    Canceled,
+    /// The target pixmap exceeds `Limits::max_pixels`.
+    ///
+    /// Nothing was rendered.
+    TargetTooLarge,
+    /// One of the `Limits` was reached during the render.
+    ///
+    /// The pixmap contains the image without the elements that exceeded the limits.
+    /// When the time is out, the elements after the last rendered one are missing.
+    LimitReached,
+}
+
+impl std::fmt::Display for RenderError {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        match *self {
+            RenderError::InvalidSize => write!(f, "invalid target size"),
+            RenderError::Canceled => write!(f, "the render was canceled"),
+            RenderError::TargetTooLarge => write!(f, "the target size exceeds the limit"),
+            RenderError::LimitReached => write!(f, "a render limit was reached"),
+        }
+    }
+}
+
+impl std::error::Error for RenderError {}
+
+
+/// Progress reporting and cancellation of a single render.
+#[derive(Clone, Copy, Default)]
+#[allow(missing_debug_implementations)]
+pub struct RenderControl<'a> {
+    /// Stops the render as soon as the token is canceled.
+    ///
+    /// Checked between nodes and between filter primitives.
+    pub cancel: Option<&'a CancelToken>,
+
+    /// Receives the render progress in a 0..1 range.
+    ///
+    /// Called by the rendering thread on each percent of rendered nodes.
+    pub progress: Option<&'a dyn Fn(f64)>,
+
+    /// Collects per-element rendering statistics.
+    pub stats: Option<&'a RenderStats>,
+
+    /// Renders a fast, low quality preview.
+    ///
+    /// The image is rendered at half the resolution and upscaled, so filters
+    /// and layers cost about a quarter of a normal render.
+    /// Anti-aliasing is disabled, raster images and patterns use the nearest filtering
+    /// and blurs are downsampled further, like `Options::fast_blur` does.
+    ///
+    /// Meant to be followed by a normal render, which can be canceled
+    /// when the preview becomes outdated.
+    pub preview: bool,
+}
+
+/// A state of a single render, shared by all its canvases.
+pub(crate) struct Progress<'a> {
+    control: RenderControl<'a>,
+    limits: Limits,
+    deadline: Option<Instant>,
+    total: usize,
+    done: Cell<usize>,
+    /// The last reported progress in percents.
+    reported: Cell<usize>,
+    /// The number of currently allocated layers.
+    layers: Cell<usize>,
+    /// The memory used by currently allocated layers and cached pattern tiles.
+    layers_memory: Cell<usize>,
+    limit_reached: Cell<bool>,
+    patterns: crate::paint_server::PatternCache,
+}
+
+impl<'a> Progress<'a> {
+    /// `target_memory` is the size of the target pixmap in bytes.
+    /// Cached pattern tiles cannot use more than that.
+    pub fn new(
+        control: RenderControl<'a>,
+        limits: Limits,
+        node: &usvg::Node,
+        target_memory: usize,
+    ) -> Self {
+        // Nodes are counted only when someone is interested in them.
+        let total = if control.progress.is_some() { node.descendants().count() } else { 0 };
+
+        Progress {
+            control,
+            limits,
+            deadline: limits.timeout.map(|d| Instant::now() + d),
+            total,
+            done: Cell::new(0),
+            reported: Cell::new(0),
+            layers: Cell::new(0),
+            layers_memory: Cell::new(0),
+            limit_reached: Cell::new(false),
+            patterns: crate::paint_server::PatternCache::new(target_memory),
+        }
+    }
+
+    /// Checks that a pixmap of the specified size can be rendered.
+    pub fn check_pixels(&self, width: u32, height: u32) -> bool {
+        self.check_limit(self.limits.max_pixels, width as u64 * height as u64, "pixels")
+    }
+
+    /// Checks that a filter region of the specified size can be rendered.
+    pub fn check_filter_area(&self, width: u32, height: u32) -> bool {
+        self.check_limit(self.limits.max_filter_area, width as u64 * height as u64, "filter area")
+    }
+
+    /// Returns a layer from the renderer's pool, unless it exceeds the limits.
+    pub fn take_layer(
+        &self,
+        renderer: &crate::Renderer,
+        width: u32,
+        height: u32,
+    ) -> Option<tiny_skia::Pixmap> {
+        self.take_layer_with(width, height, || renderer.layers.take(width, height))
+    }
+
+    /// Like `take_layer`, but the layer can be larger than requested.
+    ///
+    /// See `LayerPool::take_at_least` for details.
+    pub fn take_layer_at_least(
+        &self,
+        renderer: &crate::Renderer,
+        width: u32,
+        height: u32,
+    ) -> Option<tiny_skia::Pixmap> {
+        self.take_layer_with(width, height, || renderer.layers.take_at_least(width, height))
+    }
+
+    /// Checks the limits using the requested size and then takes a layer.
+    ///
+    /// The taken layer is accounted using its actual size.
+    fn take_layer_with<F>(&self, width: u32, height: u32, take: F) -> Option<tiny_skia::Pixmap>
+        where F: FnOnce() -> Option<tiny_skia::Pixmap>
+    {
+        let layers = self.layers.get() + 1;
+        if !self.check_limit(self.limits.max_layers.map(|n| n as u64), layers as u64, "layers")
+            || !self.check_layers_memory(layer_memory(width, height))
+        {
+            return None;
+        }
+
+        let pixmap = take()?;
+        self.layers.set(layers);
+        self.layers_memory.set(self.layers_memory.get() + pixmap.data().len());
+        Some(pixmap)
+    }
+
+    /// Checks that an additional memory can be allocated under the layers memory limit.
+    fn check_layers_memory(&self, size: usize) -> bool {
+        let memory = self.layers_memory.get() + size;
+        self.check_limit(self.limits.max_layers_memory.map(|n| n as u64), memory as u64, "layers memory")
+    }
+
+    /// Reserves layers memory for a buffer that is not taken from the layers pool,
+    /// like a pattern tile.
+    pub fn reserve_layers_memory(&self, size: usize) -> bool {
+        if !self.check_layers_memory(size) {
+            return false;
+        }
+
+        self.layers_memory.set(self.layers_memory.get() + size);
+        true
+    }
+
+    /// Releases memory reserved via `reserve_layers_memory`.
+    pub fn release_layers_memory(&self, size: usize) {
+        self.layers_memory.set(self.layers_memory.get().saturating_sub(size));
+    }
+
+    /// Returns a layer taken via `take_layer` to the renderer's pool.
+    pub fn release_layer(&self, renderer: &crate::Renderer, pixmap: tiny_skia::Pixmap) {
+        self.layers.set(self.layers.get().saturating_sub(1));
+        self.layers_memory.set(self.layers_memory.get().saturating_sub(pixmap.data().len()));
+        renderer.layers.release(pixmap);
+    }
+
+    pub fn is_limit_reached(&self) -> bool {
+        self.limit_reached.get()
+    }
+
+    fn check_limit(&self, limit: Option<u64>, value: u64, name: &str) -> bool {
+        match limit {
+            Some(limit) if value > limit => {
+                // Warn only once per render.
+                if !self.limit_reached.replace(true) {
+                    warn!("The {} limit was reached. Some elements will not be rendered.", name);
+                }
+
+                false
+            }
+            _ => true,
+        }
+    }
+
+    fn is_timed_out(&self) -> bool {
+        match self.deadline {
+            Some(deadline) if Instant::now() > deadline => {
+                if !self.limit_reached.replace(true) {
+                    warn!("The render time limit was reached.");
+                }
+
+                true
+            }
+            _ => false,
+        }
+    }
+
+    pub fn stats(&self) -> Option<&'a RenderStats> {
+        self.control.stats
+    }
+
+    pub fn is_preview(&self) -> bool {
+        self.control.preview
+    }
+
+    pub fn patterns(&self) -> &crate::paint_server::PatternCache {
+        &self.patterns
+    }
+
+    /// Checks that the render should stop, either because it was canceled
+    /// or because it ran out of time.
+    pub fn is_canceled(&self) -> bool {
+        self.is_token_canceled() || self.is_timed_out()
+    }
+
+    pub fn is_token_canceled(&self) -> bool {
+        self.control.cancel.map(|c| c.is_canceled()).unwrap_or(false)
+    }
+
+    pub fn node_rendered(&self) {
+        self.nodes_rendered(1);
+    }
+
+    /// Counts all descendants of a node that will not be rendered as rendered.
+    ///
+    /// The node itself is counted by its parent.
+    pub fn children_skipped(&self, node: &usvg::Node) {
+        if self.control.progress.is_some() {
+            self.nodes_rendered(node.descendants().count() - 1);
+        }
+    }
+
+    fn nodes_rendered(&self, count: usize) {
+        let callback = match self.control.progress {
+            Some(callback) => callback,
+            None => return,
+        };
+
+        self.done.set(self.done.get() + count);
+
+        // Nodes inside `defs`, like patterns and clip paths, can be rendered multiple times,
+        // so the number of rendered nodes can exceed the total.
+        let percent = (self.done.get() * 100 / self.total.max(1)).min(99);
+        if percent > self.reported.get() {
+            self.reported.set(percent);
+            callback(percent as f64 / 100.0);
+        }
+    }
+
+    /// Returns the result of a finished render.
+    pub fn result(&self) -> Result<(), RenderError> {
+        if self.is_token_canceled() {
+            return Err(RenderError::Canceled);
+        }
+
+        if self.is_limit_reached() {
+            return Err(RenderError::LimitReached);
+        }
+
+        if let Some(callback) = self.control.progress {
+            callback(1.0);
+        }
+
+        Ok(())
+    }
+}
+
+fn layer_memory(width: u32, height: u32) -> usize {
+    width as usize * height as usize * tiny_skia::BYTES_PER_PIXEL
+}
@@ -2,7 +2,8 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use std::rc::Rc;
+use std::cmp;
+use std::sync::{Arc, Mutex};
 
 use rgb::FromSlice;
 use log::warn;
@@ -102,6 +103,7 @@ impl IntoSvgFilters<svgfilters::ColorChannel> for usvg::ColorChannel {
 pub(crate) enum Error {
     InvalidRegion,
     NoResults,
+    Canceled,
 }
 
 
@@ -148,7 +150,7 @@ struct Image {
     /// Filter primitive result.
     ///
     /// All images have the same size which is equal to the current filter region.
-    image: Rc<tiny_skia::Pixmap>,
+    image: Arc<tiny_skia::Pixmap>,
 
     /// Image's region that has actual data.
     ///
@@ -165,9 +167,16 @@ struct Image {
 
 impl Image {
     fn from_image(image: tiny_skia::Pixmap, color_space: ColorSpace) -> Self {
+        Self::from_shared(Arc::new(image), color_space)
+    }
+
+    /// Creates an image from a pixmap shared with a cache.
+    ///
+    /// The pixmap will be copied only when modified.
+    fn from_shared(image: Arc<tiny_skia::Pixmap>, color_space: ColorSpace) -> Self {
         let (w, h) = (image.width(), image.height());
         Image {
-            image: Rc::new(image),
+            image,
             region: ScreenRect::new(0, 0, w, h).unwrap(),
             color_space,
         }
@@ -185,7 +194,7 @@ impl Image {
             }
 
             Ok(Image {
-                image: Rc::new(image),
+                image: Arc::new(image),
                 region,
                 color_space,
             })
@@ -195,7 +204,7 @@ impl Image {
     }
 
     fn take(self) -> Result<tiny_skia::Pixmap, Error> {
-        match Rc::try_unwrap(self.image) {
+        match Arc::try_unwrap(self.image) {
             Ok(v) => Ok(v),
             Err(v) => Ok((*v).clone()),
         }
@@ -226,19 +235,114 @@ struct FilterInputs<'a> {
 struct FilterResult {
     name: String,
     image: Image,
+
+    /// The same image in another color space.
+    ///
+    /// Filled on demand, so a result used by multiple primitives
+    /// will be converted only once.
+    converted: Option<Image>,
+
+    /// The number of primitives that still have to read this result.
+    ///
+    /// The result is moved out of the list on the last use,
+    /// so it can be modified in place and deallocated as soon as possible.
+    uses: usize,
+}
+
+impl FilterResult {
+    fn take(results: &mut Vec<FilterResult>, idx: usize, cs: Option<ColorSpace>) -> Result<Image, Error> {
+        let needs_conversion = match cs {
+            Some(cs) => cs != results[idx].image.color_space,
+            None => false,
+        };
+
+        if results[idx].uses <= 1 {
+            let res = results.remove(idx);
+            return match res.converted {
+                Some(converted) if needs_conversion => Ok(converted),
+                _ => Ok(res.image),
+            };
+        }
+
+        let res = &mut results[idx];
+        res.uses -= 1;
+
+        if let (true, Some(cs)) = (needs_conversion, cs) {
+            // There are only two color spaces, so `converted` is always in `cs`.
+            if res.converted.is_none() {
+                res.converted = Some(res.image.clone().into_color_space(cs)?);
+            }
+
+            if let Some(ref converted) = res.converted {
+                return Ok(converted.clone());
+            }
+        }
+
+        Ok(res.image.clone())
+    }
+}
+
+/// Returns how many times each primitive result is referenced by the following primitives.
+///
+/// A reference is resolved to the closest preceding primitive with the same result name.
+fn count_uses(filter: &usvg::Filter) -> Vec<usize> {
+    let mut uses = vec![0; filter.children.len()];
+    for (i, primitive) in filter.children.iter().enumerate() {
+        for input in primitive_inputs(&primitive.kind) {
+            if let usvg::FilterInput::Reference(ref name) = input {
+                if let Some(idx) = filter.children[..i].iter().rposition(|p| p.result == *name) {
+                    uses[idx] += 1;
+                }
+            }
+        }
+    }
+
+    uses
+}
+
+fn primitive_inputs(kind: &usvg::FilterKind) -> Vec<&usvg::FilterInput> {
+    use usvg::FilterKind;
+
+    match kind {
+        FilterKind::FeBlend(ref fe) => vec![&fe.input1, &fe.input2],
+        FilterKind::FeColorMatrix(ref fe) => vec![&fe.input],
+        FilterKind::FeComponentTransfer(ref fe) => vec![&fe.input],
+        FilterKind::FeComposite(ref fe) => vec![&fe.input1, &fe.input2],
+        FilterKind::FeConvolveMatrix(ref fe) => vec![&fe.input],
+        FilterKind::FeDiffuseLighting(ref fe) => vec![&fe.input],
+        FilterKind::FeDisplacementMap(ref fe) => vec![&fe.input1, &fe.input2],
+        FilterKind::FeFlood(_) => Vec::new(),
+        FilterKind::FeGaussianBlur(ref fe) => vec![&fe.input],
+        FilterKind::FeImage(_) => Vec::new(),
+        FilterKind::FeMerge(ref fe) => fe.inputs.iter().collect(),
+        FilterKind::FeMorphology(ref fe) => vec![&fe.input],
+        FilterKind::FeOffset(ref fe) => vec![&fe.input],
+        FilterKind::FeSpecularLighting(ref fe) => vec![&fe.input],
+        FilterKind::FeTile(ref fe) => vec![&fe.input],
+        FilterKind::FeTurbulence(_) => Vec::new(),
+    }
 }
 
 
+/// Applies a filter to the `source`.
+///
+/// `origin` is the `source` position in the image coordinates.
 pub fn apply(
     filter: &usvg::Filter,
     bbox: Option<Rect>,
     ts: &usvg::Transform,
+    origin: (i32, i32),
     tree: &usvg::Tree,
+    renderer: &crate::Renderer,
+    progress: Option<&crate::control::Progress>,
     background: Option<&tiny_skia::Pixmap>,
     fill_paint: Option<&tiny_skia::Pixmap>,
     stroke_paint: Option<&tiny_skia::Pixmap>,
     source: &mut tiny_skia::Pixmap,
 ) {
+    let stats = progress.and_then(|p| p.stats());
+    let start = stats.map(|_| std::time::Instant::now());
+
     let res = {
         let inputs = FilterInputs {
             source,
@@ -247,7 +351,7 @@ pub fn apply(
             stroke_paint,
         };
 
-        _apply(filter, &inputs, bbox, ts, tree)
+        _apply(filter, &inputs, bbox, ts, origin, tree, renderer, progress)
     };
 
     let res = res.and_then(|(image, region)| apply_to_canvas(image, region, source));
@@ -263,6 +367,14 @@ pub fn apply(
             warn!("Filter '{}' has an invalid region.", filter.id);
         }
         Err(Error::NoResults) => {}
+        Err(Error::Canceled) => {}
+    }
+
+    if let (Some(stats), Some(start)) = (stats, start) {
+        stats.update("filter", &filter.id, |s| {
+            s.count += 1;
+            s.time += start.elapsed();
+        });
     }
 }
 
@@ -271,78 +383,96 @@ fn _apply(
     inputs: &FilterInputs,
     bbox: Option<Rect>,
     ts: &usvg::Transform,
+    origin: (i32, i32),
     tree: &usvg::Tree,
+    renderer: &crate::Renderer,
+    progress: Option<&crate::control::Progress>,
 ) -> Result<(Image, ScreenRect), Error> {
+    let threads = renderer.threads();
     let mut results = Vec::new();
-    let region = calc_region(filter, bbox, ts, inputs.source)?;
+    let uses = count_uses(filter);
+    let canvas_rect = ScreenRect::new(0, 0, inputs.source.width(), inputs.source.height()).unwrap();
+    let region = calc_region(filter, bbox, ts, canvas_rect)?;
+    let fast_blur = renderer.opt.fast_blur || progress.map(|p| p.is_preview()).unwrap_or(false);
+
+    let stats = progress.and_then(|p| p.stats());
+    if let Some(stats) = stats {
+        stats.update("filter", &filter.id, |s| s.region_pixels += region_area(region));
+    }
 
-    for primitive in &filter.children {
+    for (idx, primitive) in filter.children.iter().enumerate() {
+        if progress.map(|p| p.is_canceled()).unwrap_or(false) {
+            return Err(Error::Canceled);
+        }
+
+        let start = stats.map(|_| std::time::Instant::now());
         let cs = primitive.color_interpolation;
         let subregion = calc_subregion(filter, primitive, bbox, region, ts, &results)?;
 
         let mut result = match primitive.kind {
             usvg::FilterKind::FeBlend(ref fe) => {
-                let input1 = get_input(&fe.input1, region, inputs, &results)?;
-                let input2 = get_input(&fe.input2, region, inputs, &results)?;
+                let input1 = get_input(&fe.input1, Some(cs), region, inputs, &mut results)?;
+                let input2 = get_input(&fe.input2, Some(cs), region, inputs, &mut results)?;
                 apply_blend(fe, cs, region, input1, input2)
             }
             usvg::FilterKind::FeFlood(ref fe) => {
                 apply_flood(fe, region)
             }
             usvg::FilterKind::FeGaussianBlur(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
-                apply_blur(fe, filter.primitive_units, cs, bbox, ts, input)
+                let input = get_input(&fe.input, None, region, inputs, &mut results)?;
+                let input_origin = (origin.0 + region.x(), origin.1 + region.y());
+                apply_blur(fe, filter.primitive_units, cs, bbox, ts, fast_blur, input_origin, input)
             }
             usvg::FilterKind::FeOffset(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
+                let input = get_input(&fe.input, None, region, inputs, &mut results)?;
                 apply_offset(fe, filter.primitive_units, bbox, ts, input)
             }
             usvg::FilterKind::FeComposite(ref fe) => {
-                let input1 = get_input(&fe.input1, region, inputs, &results)?;
-                let input2 = get_input(&fe.input2, region, inputs, &results)?;
+                let input1 = get_input(&fe.input1, Some(cs), region, inputs, &mut results)?;
+                let input2 = get_input(&fe.input2, Some(cs), region, inputs, &mut results)?;
                 apply_composite(fe, cs, region, input1, input2)
             }
             usvg::FilterKind::FeMerge(ref fe) => {
-                apply_merge(fe, cs, region, inputs, &results)
+                apply_merge(fe, cs, region, inputs, &mut results)
             }
             usvg::FilterKind::FeTile(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
+                let input = get_input(&fe.input, None, region, inputs, &mut results)?;
                 apply_tile(input, region)
             }
             usvg::FilterKind::FeImage(ref fe) => {
-                apply_image(fe, region, subregion, tree, ts)
+                apply_image(fe, region, subregion, tree, ts, renderer)
             }
             usvg::FilterKind::FeComponentTransfer(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
-                apply_component_transfer(fe, cs, input)
+                let input = get_input(&fe.input, Some(cs), region, inputs, &mut results)?;
+                apply_component_transfer(fe, cs, threads, input)
             }
             usvg::FilterKind::FeColorMatrix(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
-                apply_color_matrix(fe, cs, input)
+                let input = get_input(&fe.input, Some(cs), region, inputs, &mut results)?;
+                apply_color_matrix(fe, cs, threads, input)
             }
             usvg::FilterKind::FeConvolveMatrix(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
+                let input = get_input(&fe.input, Some(cs), region, inputs, &mut results)?;
                 apply_convolve_matrix(fe, cs, input)
             }
             usvg::FilterKind::FeMorphology(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
+                let input = get_input(&fe.input, Some(cs), region, inputs, &mut results)?;
                 apply_morphology(fe, filter.primitive_units, cs, bbox, ts, input)
             }
             usvg::FilterKind::FeDisplacementMap(ref fe) => {
-                let input1 = get_input(&fe.input1, region, inputs, &results)?;
-                let input2 = get_input(&fe.input2, region, inputs, &results)?;
+                let input1 = get_input(&fe.input1, Some(cs), region, inputs, &mut results)?;
+                let input2 = get_input(&fe.input2, Some(cs), region, inputs, &mut results)?;
                 apply_displacement_map(fe, region, filter.primitive_units, cs, bbox, ts, input1, input2)
             }
             usvg::FilterKind::FeTurbulence(ref fe) => {
-                apply_turbulence(fe, region, cs, ts)
+                apply_turbulence(fe, region, origin, cs, ts, renderer)
             }
             usvg::FilterKind::FeDiffuseLighting(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
-                apply_diffuse_lighting(fe, region, cs, ts, input)
+                let input = get_input(&fe.input, None, region, inputs, &mut results)?;
+                apply_diffuse_lighting(fe, region, cs, ts, threads, input)
             }
             usvg::FilterKind::FeSpecularLighting(ref fe) => {
-                let input = get_input(&fe.input, region, inputs, &results)?;
-                apply_specular_lighting(fe, region, cs, ts, input)
+                let input = get_input(&fe.input, None, region, inputs, &mut results)?;
+                apply_specular_lighting(fe, region, cs, ts, threads, input)
             }
         }?;
 
@@ -389,16 +519,30 @@ fn _apply(
             };
 
             result = Image {
-                image: Rc::new(pixmap),
+                image: Arc::new(pixmap),
                 region: subregion,
                 color_space,
             };
         }
 
-        results.push(FilterResult {
-            name: primitive.result.clone(),
-            image: result,
-        });
+        if let (Some(stats), Some(start)) = (stats, start) {
+            stats.update(primitive_name(&primitive.kind), &filter.id, |s| {
+                s.count += 1;
+                s.time += start.elapsed();
+                s.region_pixels += region_area(subregion);
+            });
+        }
+
+        // Results that are not referenced by any of the following primitives
+        // are not needed, unless it's the last one.
+        if uses[idx] != 0 || idx + 1 == filter.children.len() {
+            results.push(FilterResult {
+                name: primitive.result.clone(),
+                image: result,
+                converted: None,
+                uses: uses[idx],
+            });
+        }
     }
 
     if let Some(res) = results.pop() {
@@ -408,11 +552,37 @@ fn _apply(
     }
 }
 
+fn region_area(region: ScreenRect) -> u64 {
+    region.width() as u64 * region.height() as u64
+}
+
+/// Returns an element name of a filter primitive.
+fn primitive_name(kind: &usvg::FilterKind) -> &'static str {
+    match kind {
+        usvg::FilterKind::FeBlend(..) => "feBlend",
+        usvg::FilterKind::FeColorMatrix(..) => "feColorMatrix",
+        usvg::FilterKind::FeComponentTransfer(..) => "feComponentTransfer",
+        usvg::FilterKind::FeComposite(..) => "feComposite",
+        usvg::FilterKind::FeConvolveMatrix(..) => "feConvolveMatrix",
+        usvg::FilterKind::FeDiffuseLighting(..) => "feDiffuseLighting",
+        usvg::FilterKind::FeDisplacementMap(..) => "feDisplacementMap",
+        usvg::FilterKind::FeFlood(..) => "feFlood",
+        usvg::FilterKind::FeGaussianBlur(..) => "feGaussianBlur",
+        usvg::FilterKind::FeImage(..) => "feImage",
+        usvg::FilterKind::FeMerge(..) => "feMerge",
+        usvg::FilterKind::FeMorphology(..) => "feMorphology",
+        usvg::FilterKind::FeOffset(..) => "feOffset",
+        usvg::FilterKind::FeSpecularLighting(..) => "feSpecularLighting",
+        usvg::FilterKind::FeTile(..) => "feTile",
+        usvg::FilterKind::FeTurbulence(..) => "feTurbulence",
+    }
+}
+
 pub(crate) fn calc_region(
     filter: &usvg::Filter,
     bbox: Option<Rect>,
     ts: &usvg::Transform,
-    pixmap: &tiny_skia::Pixmap,
+    canvas_rect: ScreenRect,
 ) -> Result<ScreenRect, Error> {
     let path = usvg::PathData::from_rect(filter.rect);
 
@@ -426,7 +596,6 @@ pub(crate) fn calc_region(
         *ts
     };
 
-    let canvas_rect = ScreenRect::new(0, 0, pixmap.width(), pixmap.height()).unwrap();
     let region = path.bbox_with_transform(region_ts, None)
         .ok_or(Error::InvalidRegion)?
         .to_screen_rect()
@@ -514,11 +683,16 @@ fn calc_subregion(
     Ok(subregion.to_screen_rect())
 }
 
+/// Returns a primitive input.
+///
+/// `cs` is the color space the caller will convert the input into, if any.
+/// Allows sharing a single conversion between multiple primitives.
 fn get_input(
     input: &usvg::FilterInput,
+    cs: Option<ColorSpace>,
     region: ScreenRect,
     inputs: &FilterInputs,
-    results: &[FilterResult],
+    results: &mut Vec<FilterResult>,
 ) -> Result<Image, Error> {
     let convert = |in_image: Option<&tiny_skia::Pixmap>, region| {
         let image = if let Some(image) = in_image {
@@ -528,7 +702,7 @@ fn get_input(
         };
 
         Ok(Image {
-            image: Rc::new(image),
+            image: Arc::new(image),
             region: region.translate_to(0, 0),
             color_space: ColorSpace::SRGB,
         })
@@ -543,7 +717,7 @@ fn get_input(
         }
 
         Ok(Image {
-            image: Rc::new(image),
+            image: Arc::new(image),
             region: region.translate_to(0, 0),
             color_space: ColorSpace::SRGB,
         })
@@ -554,7 +728,7 @@ fn get_input(
             let image = inputs.source.copy_region(region)?;
 
             Ok(Image {
-                image: Rc::new(image),
+                image: Arc::new(image),
                 region: region.translate_to(0, 0),
                 color_space: ColorSpace::SRGB,
             })
@@ -568,7 +742,7 @@ fn get_input(
         }
         usvg::FilterInput::BackgroundAlpha => {
             let image = get_input(
-                &usvg::FilterInput::BackgroundImage, region, inputs, results,
+                &usvg::FilterInput::BackgroundImage, None, region, inputs, results,
             )?;
             convert_alpha(image.take()?)
         }
@@ -579,13 +753,13 @@ fn get_input(
             convert(inputs.stroke_paint, region.translate_to(0, 0))
         }
         usvg::FilterInput::Reference(ref name) => {
-            if let Some(v) = results.iter().rev().find(|v| v.name == *name) {
-                Ok(v.image.clone())
+            if let Some(idx) = results.iter().rposition(|v| v.name == *name) {
+                FilterResult::take(results, idx, cs)
             } else {
                 // Technically unreachable.
                 warn!("Unknown filter primitive reference '{}'.", name);
                 get_input(
-                    &usvg::FilterInput::SourceGraphic, region, inputs, results,
+                    &usvg::FilterInput::SourceGraphic, None, region, inputs, results,
                 )
             }
         }
@@ -598,6 +772,8 @@ fn apply_blur(
     cs: ColorSpace,
     bbox: Option<Rect>,
     ts: &usvg::Transform,
+    fast: bool,
+    origin: (i32, i32),
     input: Image,
 ) -> Result<Image, Error> {
     let (std_dx, std_dy, box_blur)
@@ -605,6 +781,11 @@ fn apply_blur(
 
     let mut pixmap = input.into_color_space(cs)?.take()?;
 
+    if fast && (std_dx > FAST_BLUR_SIGMA_THRESHOLD || std_dy > FAST_BLUR_SIGMA_THRESHOLD) {
+        let pixmap = apply_downsampled_blur(std_dx, std_dy, origin, &pixmap)?;
+        return Ok(Image::from_image(pixmap, cs));
+    }
+
     if box_blur {
         svgfilters::box_blur(std_dx, std_dy, into_svgfilters_image_mut!(pixmap));
     } else {
@@ -749,12 +930,12 @@ fn apply_merge(
     cs: ColorSpace,
     region: ScreenRect,
     inputs: &FilterInputs,
-    results: &[FilterResult],
+    results: &mut Vec<FilterResult>,
 ) -> Result<Image, Error> {
     let mut pixmap = tiny_skia::Pixmap::try_create(region.width(), region.height())?;
 
     for input in &fe.inputs {
-        let input = get_input(input, region, inputs, results)?;
+        let input = get_input(input, Some(cs), region, inputs, results)?;
         let input = input.into_color_space(cs)?;
         pixmap.draw_pixmap(
             0,
@@ -810,9 +991,10 @@ fn apply_image(
     subregion: ScreenRect,
     tree: &usvg::Tree,
     ts: &usvg::Transform,
+    renderer: &crate::Renderer,
 ) -> Result<Image, Error> {
     let mut pixmap = tiny_skia::Pixmap::try_create(region.width(), region.height())?;
-    let mut canvas = Canvas::from(pixmap.as_mut());
+    let mut canvas = Canvas::new(pixmap.as_mut(), tree, renderer);
 
     match fe.data {
         usvg::FeImageKind::Image(ref kind) => {
@@ -825,7 +1007,7 @@ fn apply_image(
                 aspect: fe.aspect,
             };
 
-            crate::image::draw_kind(kind, view_box, fe.rendering_mode, &mut canvas);
+            crate::image::draw_kind(kind, "", view_box, fe.rendering_mode, &mut canvas);
         }
         usvg::FeImageKind::Use(ref id) => {
             if let Some(ref node) = tree.defs_by_id(id).or_else(|| tree.node_by_id(id)) {
@@ -844,21 +1026,28 @@ fn apply_image(
 fn apply_component_transfer(
     fe: &usvg::FeComponentTransfer,
     cs: ColorSpace,
+    threads: usize,
     input: Image,
 ) -> Result<Image, Error> {
     let mut pixmap = input.into_color_space(cs)?.take()?;
 
-    svgfilters::demultiply_alpha(pixmap.data_mut().as_rgba_mut());
+    // A per-pixel operation, so each band can be processed independently.
+    let width = pixmap.width();
+    crate::parallel::for_each_band(threads, width, pixmap.data_mut(), |_, band| {
+        let height = (band.len() / 4) as u32 / width;
 
-    svgfilters::component_transfer(
-        fe.func_b.into_svgf(),
-        fe.func_g.into_svgf(),
-        fe.func_r.into_svgf(),
-        fe.func_a.into_svgf(),
-        into_svgfilters_image_mut!(pixmap),
-    );
+        svgfilters::demultiply_alpha(band.as_rgba_mut());
 
-    svgfilters::multiply_alpha(pixmap.data_mut().as_rgba_mut());
+        svgfilters::component_transfer(
+            fe.func_b.into_svgf(),
+            fe.func_g.into_svgf(),
+            fe.func_r.into_svgf(),
+            fe.func_a.into_svgf(),
+            into_svgfilters_image_mut(width, height, band),
+        );
+
+        svgfilters::multiply_alpha(band.as_rgba_mut());
+    });
 
     Ok(Image::from_image(pixmap, cs))
 }
@@ -866,14 +1055,13 @@ fn apply_component_transfer(
 fn apply_color_matrix(
     fe: &usvg::FeColorMatrix,
     cs: ColorSpace,
+    threads: usize,
     input: Image,
 ) -> Result<Image, Error> {
     use std::convert::TryInto;
 
     let mut pixmap = input.into_color_space(cs)?.take()?;
 
-    svgfilters::demultiply_alpha(pixmap.data_mut().as_rgba_mut());
-
     let kind = match fe.kind {
         usvg::FeColorMatrixKind::Matrix(ref data) =>
             svgfilters::ColorMatrix::Matrix(data.as_slice().try_into().unwrap()),
@@ -885,9 +1073,14 @@ fn apply_color_matrix(
             svgfilters::ColorMatrix::LuminanceToAlpha,
     };
 
-    svgfilters::color_matrix(kind, into_svgfilters_image_mut!(pixmap));
-
-    svgfilters::multiply_alpha(pixmap.data_mut().as_rgba_mut());
+    // A per-pixel operation, so each band can be processed independently.
+    let width = pixmap.width();
+    crate::parallel::for_each_band(threads, width, pixmap.data_mut(), |_, band| {
+        let height = (band.len() / 4) as u32 / width;
+        svgfilters::demultiply_alpha(band.as_rgba_mut());
+        svgfilters::color_matrix(kind, into_svgfilters_image_mut(width, height, band));
+        svgfilters::multiply_alpha(band.as_rgba_mut());
+    });
 
     Ok(Image::from_image(pixmap, cs))
 }
@@ -986,8 +1179,10 @@ fn apply_displacement_map(
 fn apply_turbulence(
     fe: &usvg::FeTurbulence,
     region: ScreenRect,
+    origin: (i32, i32),
     cs: ColorSpace,
     ts: &usvg::Transform,
+    renderer: &crate::Renderer,
 ) -> Result<Image, Error> {
     let mut pixmap = tiny_skia::Pixmap::try_create(region.width(), region.height())?;
 
@@ -996,20 +1191,127 @@ fn apply_turbulence(
         return Ok(Image::from_image(pixmap, cs));
     }
 
-    svgfilters::turbulence(
-        region.x() as f64, region.y() as f64,
-        sx, sy,
-        fe.base_frequency.x.value(), fe.base_frequency.y.value(),
-        fe.num_octaves,
-        fe.seed,
-        fe.stitch_tiles,
-        fe.kind == usvg::FeTurbulenceKind::FractalNoise,
-        into_svgfilters_image_mut!(pixmap),
-    );
+    let key = TurbulenceKey {
+        x: region.x() + origin.0,
+        y: region.y() + origin.1,
+        width: region.width(),
+        height: region.height(),
+        sx: sx.to_bits(),
+        sy: sy.to_bits(),
+        base_frequency_x: fe.base_frequency.x.value().to_bits(),
+        base_frequency_y: fe.base_frequency.y.value().to_bits(),
+        num_octaves: fe.num_octaves,
+        seed: fe.seed,
+        stitch_tiles: fe.stitch_tiles,
+        fractal_noise: fe.kind == usvg::FeTurbulenceKind::FractalNoise,
+    };
 
-    svgfilters::multiply_alpha(pixmap.data_mut().as_rgba_mut());
+    if let Some(pixmap) = renderer.turbulence.get(&key) {
+        return Ok(Image::from_shared(pixmap, cs));
+    }
 
-    Ok(Image::from_image(pixmap, cs))
+    // Tiles stitching depends on the image size, so such turbulence cannot be split.
+    let threads = if fe.stitch_tiles { 1 } else { renderer.threads() };
+
+    let width = pixmap.width();
+    crate::parallel::for_each_band(threads, width, pixmap.data_mut(), |y, band| {
+        let height = (band.len() / 4) as u32 / width;
+
+        svgfilters::turbulence(
+            (region.x() + origin.0) as f64, (region.y() + origin.1 + y as i32) as f64,
+            sx, sy,
+            fe.base_frequency.x.value(), fe.base_frequency.y.value(),
+            fe.num_octaves,
+            fe.seed,
+            fe.stitch_tiles,
+            fe.kind == usvg::FeTurbulenceKind::FractalNoise,
+            into_svgfilters_image_mut(width, height, band),
+        );
+
+        svgfilters::multiply_alpha(band.as_rgba_mut());
+    });
+
+    let pixmap = Arc::new(pixmap);
+    renderer.turbulence.insert(key, pixmap.clone());
+
+    Ok(Image::from_shared(pixmap, cs))
+}
+
+
+/// The maximum total size of turbulence images kept by a cache, in bytes.
+///
+/// Larger images will not be cached.
+const MAX_TURBULENCE_CACHE_SIZE: usize = 64 * 1024 * 1024;
+
+/// `feTurbulence` parameters that affect the generated noise.
+///
+/// Floating point values are stored as bits, since they must be identical.
+#[derive(Clone, Copy, PartialEq, Debug)]
+struct TurbulenceKey {
+    x: i32,
+    y: i32,
+    width: u32,
+    height: u32,
+    sx: u64,
+    sy: u64,
+    base_frequency_x: u64,
+    base_frequency_y: u64,
+    num_octaves: u32,
+    seed: i32,
+    stitch_tiles: bool,
+    fractal_noise: bool,
+}
+
+/// A cache of generated `feTurbulence` images.
+///
+/// Noise depends only on the primitive attributes, the filter region and the canvas scale,
+/// so a re-rendered primitive, like an animated background, doesn't have to be generated again.
+///
+/// Images are shared with filter results and are copied only when a result is modified.
+#[derive(Default)]
+pub struct TurbulenceCache {
+    /// Images in the least recently used first order.
+    images: Mutex<Vec<(TurbulenceKey, Arc<tiny_skia::Pixmap>)>>,
+}
+
+impl TurbulenceCache {
+    fn get(&self, key: &TurbulenceKey) -> Option<Arc<tiny_skia::Pixmap>> {
+        let mut images = self.images.lock().ok()?;
+        let idx = images.iter().position(|(k, _)| k == key)?;
+
+        // Mark as recently used.
+        let item = images.remove(idx);
+        let pixmap = item.1.clone();
+        images.push(item);
+        Some(pixmap)
+    }
+
+    fn insert(&self, key: TurbulenceKey, pixmap: Arc<tiny_skia::Pixmap>) {
+        let size = pixmap.data().len();
+        if size > MAX_TURBULENCE_CACHE_SIZE {
+            return;
+        }
+
+        if let Ok(mut images) = self.images.lock() {
+            if images.iter().any(|(k, _)| *k == key) {
+                return;
+            }
+
+            let mut total: usize = images.iter().map(|(_, p)| p.data().len()).sum();
+            while total + size > MAX_TURBULENCE_CACHE_SIZE {
+                total -= images.remove(0).1.data().len();
+            }
+
+            images.push((key, pixmap));
+        }
+    }
+
+    /// Deallocates all images.
+    pub fn clear(&self) {
+        if let Ok(mut images) = self.images.lock() {
+            images.clear();
+        }
+    }
 }
 
 fn apply_diffuse_lighting(
@@ -1017,20 +1319,21 @@ fn apply_diffuse_lighting(
     region: ScreenRect,
     cs: ColorSpace,
     ts: &usvg::Transform,
+    threads: usize,
     input: Image,
 ) -> Result<Image, Error> {
-    let mut pixmap = tiny_skia::Pixmap::try_create(region.width(), region.height())?;
-
-    let light_source = fe.light_source.transform(region, ts);
-
-    svgfilters::diffuse_lighting(
-        fe.surface_scale,
-        fe.diffuse_constant,
-        fe.lighting_color.into_svgf(),
-        light_source.into_svgf(),
-        into_svgfilters_image!(input.as_ref()),
-        into_svgfilters_image_mut!(pixmap),
-    );
+    let light_source = fe.light_source.transform(region, ts).into_svgf();
+
+    let pixmap = apply_lighting(region, light_source, threads, input.as_ref(), |light_source, src, dest| {
+        svgfilters::diffuse_lighting(
+            fe.surface_scale,
+            fe.diffuse_constant,
+            fe.lighting_color.into_svgf(),
+            light_source,
+            src,
+            dest,
+        );
+    })?;
 
     Ok(Image::from_image(pixmap, cs))
 }
@@ -1040,23 +1343,91 @@ fn apply_specular_lighting(
     region: ScreenRect,
     cs: ColorSpace,
     ts: &usvg::Transform,
+    threads: usize,
     input: Image,
 ) -> Result<Image, Error> {
+    let light_source = fe.light_source.transform(region, ts).into_svgf();
+
+    let pixmap = apply_lighting(region, light_source, threads, input.as_ref(), |light_source, src, dest| {
+        svgfilters::specular_lighting(
+            fe.surface_scale,
+            fe.specular_constant,
+            fe.specular_exponent,
+            fe.lighting_color.into_svgf(),
+            light_source,
+            src,
+            dest,
+        );
+    })?;
+
+    Ok(Image::from_image(pixmap, cs))
+}
+
+/// Renders a lighting filter in horizontal bands.
+///
+/// Surface normals depend on the neighbour pixels, so each band is rendered
+/// using an input with an extra row above and below it, which are discarded afterwards.
+/// The light source position is relative to the image, so it's shifted for each band.
+fn apply_lighting<F>(
+    region: ScreenRect,
+    light_source: svgfilters::LightSource,
+    threads: usize,
+    input: &tiny_skia::Pixmap,
+    f: F,
+) -> Result<tiny_skia::Pixmap, Error>
+    where F: Fn(svgfilters::LightSource, svgfilters::ImageRef, svgfilters::ImageRefMut) + Sync
+{
     let mut pixmap = tiny_skia::Pixmap::try_create(region.width(), region.height())?;
+    let width = pixmap.width();
+    let height = pixmap.height();
 
-    let light_source = fe.light_source.transform(region, ts);
+    if crate::parallel::band_height(threads, width, height) == height {
+        f(light_source, into_svgfilters_image!(input), into_svgfilters_image_mut!(pixmap));
+        return Ok(pixmap);
+    }
 
-    svgfilters::specular_lighting(
-        fe.surface_scale,
-        fe.specular_constant,
-        fe.specular_exponent,
-        fe.lighting_color.into_svgf(),
-        light_source.into_svgf(),
-        into_svgfilters_image!(input.as_ref()),
-        into_svgfilters_image_mut!(pixmap),
-    );
+    let row_len = width as usize * tiny_skia::BYTES_PER_PIXEL;
+    crate::parallel::for_each_band(threads, width, pixmap.data_mut(), |y, band| {
+        let band_height = (band.len() / row_len) as u32;
 
-    Ok(Image::from_image(pixmap, cs))
+        // Band rows with margins. Lighting requires at least 3 rows.
+        let y2 = (y + band_height + 1).min(height);
+        let y1 = y.saturating_sub(1).min(y2.saturating_sub(3));
+
+        let src = &input.data()[y1 as usize * row_len .. y2 as usize * row_len];
+        let mut dest = vec![0; src.len()];
+        f(
+            shift_light_source(light_source, y1 as f64),
+            svgfilters::ImageRef::new(src.as_rgba(), width, y2 - y1),
+            into_svgfilters_image_mut(width, y2 - y1, &mut dest),
+        );
+
+        let offset = (y - y1) as usize * row_len;
+        band.copy_from_slice(&dest[offset .. offset + band.len()]);
+    });
+
+    Ok(pixmap)
+}
+
+fn shift_light_source(light_source: svgfilters::LightSource, dy: f64) -> svgfilters::LightSource {
+    use svgfilters::LightSource;
+
+    match light_source {
+        LightSource::DistantLight { .. } => light_source,
+        LightSource::PointLight { x, y, z } => {
+            LightSource::PointLight { x, y: y - dy, z }
+        }
+        LightSource::SpotLight {
+            x, y, z, points_at_x, points_at_y, points_at_z, specular_exponent, limiting_cone_angle
+        } => {
+            LightSource::SpotLight {
+                x, y: y - dy, z,
+                points_at_x, points_at_y: points_at_y - dy, points_at_z,
+                specular_exponent,
+                limiting_cone_angle,
+            }
+        }
+    }
 }
 
 fn apply_to_canvas(
@@ -1079,6 +1450,101 @@ fn apply_to_canvas(
     Ok(())
 }
 
+/// The minimal standard deviation, in pixels, that will be blurred
+/// at a reduced resolution when `Options::fast_blur` is set.
+const FAST_BLUR_SIGMA_THRESHOLD: f64 = 20.0;
+
+/// The minimal standard deviation, in pixels, at a reduced resolution.
+///
+/// Guarantees that the downsampled blur is still smooth enough
+/// to hide the bilinear upsampling.
+const FAST_BLUR_MIN_SIGMA: f64 = 8.0;
+
+/// The maximal difference of a pixel channel between the downsampled blur and the box blur.
+#[cfg(test)]
+const FAST_BLUR_TOLERANCE: i32 = 4;
+
+/// Blurs an image at a reduced resolution.
+///
+/// The image is downsampled by a power of two factor on each axis by averaging pixel blocks,
+/// blurred using a box blur and then upscaled back using a bilinear filtering.
+///
+/// Blocks are aligned to the image coordinates using `origin`, which is the `pixmap` position
+/// in the image. This way, the same image rendered in tiles is downsampled the same way.
+///
+/// Since the reduced standard deviation is at least `FAST_BLUR_MIN_SIGMA`,
+/// each channel differs from a full resolution box blur by at most 4 of 255,
+/// which is checked by the `downsampled_blur_tolerance` test.
+fn apply_downsampled_blur(
+    std_dx: f64,
+    std_dy: f64,
+    origin: (i32, i32),
+    pixmap: &tiny_skia::Pixmap,
+) -> Result<tiny_skia::Pixmap, Error> {
+    let factor = |std_dev: f64| {
+        let mut k = 1;
+        while std_dev / ((k * 2) as f64) >= FAST_BLUR_MIN_SIGMA {
+            k *= 2;
+        }
+
+        k
+    };
+
+    let kx = factor(std_dx);
+    let ky = factor(std_dy);
+
+    // The offset of the first pixel in its block. The first block is partial then.
+    let px = origin.0.rem_euclid(kx as i32) as u32;
+    let py = origin.1.rem_euclid(ky as i32) as u32;
+
+    let (width, height) = (pixmap.width(), pixmap.height());
+    let small_width = (width + px + kx - 1) / kx;
+    let small_height = (height + py + ky - 1) / ky;
+    let mut small = tiny_skia::Pixmap::try_create(small_width, small_height)?;
+
+    {
+        // Pixels are premultiplied, so they can be averaged as is.
+        let src = pixmap.data();
+        let dst = small.data_mut();
+        for y in 0..small_height {
+            for x in 0..small_width {
+                let mut sum = [0u32; 4];
+                let mut count = 0;
+                for sy in (y * ky).saturating_sub(py)..cmp::min((y + 1) * ky - py, height) {
+                    for sx in (x * kx).saturating_sub(px)..cmp::min((x + 1) * kx - px, width) {
+                        let idx = ((sy * width + sx) * 4) as usize;
+                        for c in 0..4 {
+                            sum[c] += src[idx + c] as u32;
+                        }
+                        count += 1;
+                    }
+                }
+
+                let idx = ((y * small_width + x) * 4) as usize;
+                for c in 0..4 {
+                    dst[idx + c] = ((sum[c] + count / 2) / count) as u8;
+                }
+            }
+        }
+    }
+
+    svgfilters::box_blur(std_dx / kx as f64, std_dy / ky as f64, into_svgfilters_image_mut!(small));
+
+    let mut result = tiny_skia::Pixmap::try_create(width, height)?;
+    let mut paint = tiny_skia::PixmapPaint::default();
+    paint.quality = tiny_skia::FilterQuality::Bilinear;
+    result.draw_pixmap(
+        0,
+        0,
+        small.as_ref(),
+        &paint,
+        tiny_skia::Transform::from_row(kx as f32, 0.0, 0.0, ky as f32, -(px as f32), -(py as f32)),
+        None,
+    );
+
+    Ok(result)
+}
+
 /// Calculates Gaussian blur sigmas for the current world transform.
 ///
 /// If the last flag is set, then a box blur should be used. Or IIR otherwise.
@@ -1134,3 +1600,96 @@ fn scale_coordinates(
         Some((x * sx, y * sy))
     }
 }
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn turbulence_key(seed: i32) -> TurbulenceKey {
+        TurbulenceKey {
+            x: 0, y: 0, width: 10, height: 10, sx: 1.0f64.to_bits(), sy: 1.0f64.to_bits(),
+            base_frequency_x: 0.05f64.to_bits(), base_frequency_y: 0.05f64.to_bits(),
+            num_octaves: 1, seed, stitch_tiles: false, fractal_noise: false,
+        }
+    }
+
+    #[test]
+    fn turbulence_cache() {
+        let cache = TurbulenceCache::default();
+        let pixmap = Arc::new(tiny_skia::Pixmap::new(10, 10).unwrap());
+        cache.insert(turbulence_key(1), pixmap.clone());
+
+        // A hit shares the cached pixmap instead of copying it.
+        assert!(Arc::ptr_eq(&cache.get(&turbulence_key(1)).unwrap(), &pixmap));
+        assert!(cache.get(&turbulence_key(2)).is_none());
+
+        // Fills the whole cache, so the first image is evicted.
+        let large = Arc::new(tiny_skia::Pixmap::new(4096, 4096).unwrap());
+        cache.insert(turbulence_key(3), large);
+        assert!(cache.get(&turbulence_key(1)).is_none());
+        assert!(cache.get(&turbulence_key(3)).is_some());
+
+        cache.clear();
+        assert!(cache.get(&turbulence_key(3)).is_none());
+    }
+
+    #[test]
+    fn downsampled_blur_tolerance() {
+        // An opaque square and a thin stripe, which are far enough from the edges.
+        let mut pixmap = tiny_skia::Pixmap::new(400, 400).unwrap();
+        let width = pixmap.width() as usize;
+        for (i, p) in pixmap.data_mut().chunks_exact_mut(4).enumerate() {
+            let (x, y) = (i % width, i / width);
+            if (100..250).contains(&x) && (100..300).contains(&y) {
+                p.copy_from_slice(&[50, 150, 250, 255]);
+            } else if (270..273).contains(&x) && (100..300).contains(&y) {
+                p.copy_from_slice(&[0, 0, 128, 128]);
+            }
+        }
+
+        for &(std_dx, std_dy) in &[(24.0, 24.0), (40.0, 21.0), (33.0, 0.0)] {
+            let fast = apply_downsampled_blur(std_dx, std_dy, (0, 0), &pixmap).unwrap();
+
+            let mut exact = pixmap.clone();
+            svgfilters::box_blur(std_dx, std_dy, into_svgfilters_image_mut!(exact));
+
+            let max_diff = fast.data().iter().zip(exact.data())
+                .map(|(a, b)| (*a as i32 - *b as i32).abs())
+                .max().unwrap();
+            assert!(max_diff <= FAST_BLUR_TOLERANCE, "{} for {}x{}", max_diff, std_dx, std_dy);
+        }
+    }
+
+    #[test]
+    fn downsampled_blur_is_tile_stable() {
+        let mut pixmap = tiny_skia::Pixmap::new(400, 400).unwrap();
+        let width = pixmap.width() as usize;
+        for (i, p) in pixmap.data_mut().chunks_exact_mut(4).enumerate() {
+            let (x, y) = (i % width, i / width);
+            if (100..250).contains(&x) && (100..300).contains(&y) {
+                p.copy_from_slice(&[50, 150, 250, 255]);
+            }
+        }
+
+        let full = apply_downsampled_blur(24.0, 24.0, (0, 0), &pixmap).unwrap();
+
+        // The same image without the first 21 transparent columns,
+        // which is not a multiple of the downsampling factor.
+        const OFFSET: usize = 21;
+        let tile_width = width - OFFSET;
+        let mut tile = tiny_skia::Pixmap::new(tile_width as u32, 400).unwrap();
+        for (dst, src) in tile.data_mut().chunks_exact_mut(tile_width * 4)
+            .zip(pixmap.data().chunks_exact(width * 4))
+        {
+            dst.copy_from_slice(&src[OFFSET * 4..]);
+        }
+
+        let tile = apply_downsampled_blur(24.0, 24.0, (OFFSET as i32, 0), &tile).unwrap();
+        for (dst, src) in tile.data().chunks_exact(tile_width * 4)
+            .zip(full.data().chunks_exact(width * 4))
+        {
+            assert!(dst == &src[OFFSET * 4..]);
+        }
+    }
+}
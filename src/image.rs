@@ -2,9 +2,174 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+use std::collections::hash_map::DefaultHasher;
+use std::collections::{BTreeMap, HashMap};
+use std::hash::{Hash, Hasher};
+use std::sync::{Arc, Mutex};
+
 use log::warn;
 use crate::render::prelude::*;
 
+
+/// A decoded raster images cache.
+///
+/// Embedded PNG and JPEG images are decoded on each render by default.
+/// With a cache, an image is decoded only once and then reused by all renders
+/// of all trees that have the same cache, as long as it fits the memory budget.
+///
+/// Images are identified by their content, so the same image
+/// referenced multiple times or stored in different trees is decoded only once.
+///
+/// Can be shared between threads.
+pub struct ImageCache {
+    budget: usize,
+    data: Mutex<ImageCacheData>,
+}
+
+#[derive(Default)]
+struct ImageCacheData {
+    /// Images grouped by their data hash.
+    images: HashMap<u64, Vec<CachedImage>>,
+    /// Hashes of images by their last use tick, in the least recently used first order.
+    lru: BTreeMap<u64, u64>,
+    /// Hashes of cached buffers by their address and length.
+    ///
+    /// Allows to skip hashing the same buffer on each render. Cached buffers are kept alive
+    /// by the cache, so their addresses cannot be reused by a different data.
+    hashes: HashMap<(usize, usize), u64>,
+    tick: u64,
+    size: usize,
+}
+
+struct CachedImage {
+    /// The encoded image data. Compared on each lookup, so hash collisions are harmless.
+    data: Arc<Vec<u8>>,
+    pixmap: Arc<tiny_skia::Pixmap>,
+    /// The last use tick.
+    tick: u64,
+}
+
+impl ImageCacheData {
+    fn find(&mut self, hash: u64, data: &Arc<Vec<u8>>) -> Option<&mut CachedImage> {
+        self.images.get_mut(&hash)?.iter_mut()
+            .find(|image| Arc::ptr_eq(&image.data, data) || image.data == *data)
+    }
+
+    fn next_tick(&mut self) -> u64 {
+        self.tick += 1;
+        self.tick
+    }
+
+    /// Removes the least recently used image.
+    fn pop_lru(&mut self) -> Option<()> {
+        let (&tick, &hash) = self.lru.iter().next()?;
+        self.lru.remove(&tick);
+
+        let images = self.images.get_mut(&hash)?;
+        let idx = images.iter().position(|image| image.tick == tick)?;
+        let image = images.remove(idx);
+        if images.is_empty() {
+            self.images.remove(&hash);
+        }
+
+        self.hashes.remove(&buffer_key(&image.data));
+        self.size -= image.pixmap.data().len();
+        Some(())
+    }
+}
+
+fn buffer_key(data: &Arc<Vec<u8>>) -> (usize, usize) {
+    (Arc::as_ptr(data) as usize, data.len())
+}
+
+fn hash_data(data: &[u8]) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    data.hash(&mut hasher);
+    hasher.finish()
+}
+
+impl ImageCache {
+    /// Creates a new cache that can hold up to `budget` bytes of decoded images.
+    pub fn new(budget: usize) -> Self {
+        ImageCache {
+            budget,
+            data: Mutex::new(ImageCacheData::default()),
+        }
+    }
+
+    /// Returns the memory budget in bytes.
+    pub fn budget(&self) -> usize {
+        self.budget
+    }
+
+    /// Returns the amount of memory used by decoded images in bytes.
+    pub fn size(&self) -> usize {
+        self.data.lock().map(|d| d.size).unwrap_or(0)
+    }
+
+    /// Removes all images from the cache.
+    pub fn clear(&self) {
+        if let Ok(mut data) = self.data.lock() {
+            *data = ImageCacheData::default();
+        }
+    }
+
+    /// Returns the data hash.
+    ///
+    /// The whole buffer is hashed only when this exact buffer is not in the cache.
+    fn hash(&self, key: &Arc<Vec<u8>>) -> u64 {
+        let hash = self.data.lock().ok()
+            .and_then(|data| data.hashes.get(&buffer_key(key)).cloned());
+        hash.unwrap_or_else(|| hash_data(key))
+    }
+
+    fn get(&self, hash: u64, key: &Arc<Vec<u8>>) -> Option<Arc<tiny_skia::Pixmap>> {
+        let mut data = self.data.lock().ok()?;
+        let tick = data.next_tick();
+        let image = data.find(hash, key)?;
+        let old_tick = std::mem::replace(&mut image.tick, tick);
+        let pixmap = image.pixmap.clone();
+
+        // Mark as recently used.
+        data.lru.remove(&old_tick);
+        data.lru.insert(tick, hash);
+        Some(pixmap)
+    }
+
+    fn insert(&self, hash: u64, key: Arc<Vec<u8>>, pixmap: Arc<tiny_skia::Pixmap>) {
+        let image_size = pixmap.data().len();
+        if image_size > self.budget {
+            return;
+        }
+
+        if let Ok(mut data) = self.data.lock() {
+            // The same image could be decoded by another thread in the meantime.
+            if data.find(hash, &key).is_some() {
+                return;
+            }
+
+            while data.size + image_size > self.budget {
+                if data.pop_lru().is_none() {
+                    break;
+                }
+            }
+
+            let tick = data.next_tick();
+            data.hashes.insert(buffer_key(&key), hash);
+            data.images.entry(hash).or_insert_with(Vec::new)
+                .push(CachedImage { data: key, pixmap, tick });
+            data.lru.insert(tick, hash);
+            data.size += image_size;
+        }
+    }
+}
+
+impl std::fmt::Debug for ImageCache {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "ImageCache({}/{})", self.size(), self.budget)
+    }
+}
+
 pub fn draw(
     image: &usvg::Image,
     canvas: &mut Canvas,
@@ -13,26 +178,30 @@ pub fn draw(
         return image.view_box.rect;
     }
 
-    draw_kind(&image.kind, image.view_box, image.rendering_mode, canvas);
+    draw_kind(&image.kind, &image.id, image.view_box, image.rendering_mode, canvas);
     image.view_box.rect
 }
 
+/// Draws an image.
+///
+/// `id` is used only for the rendering statistics.
 pub fn draw_kind(
     kind: &usvg::ImageKind,
+    id: &str,
     view_box: usvg::ViewBox,
     rendering_mode: usvg::ImageRendering,
     canvas: &mut Canvas,
 ) {
     match kind {
-        usvg::ImageKind::JPEG(ref data) => {
-            match read_jpeg(data) {
-                Some(image) => { draw_raster(&image, view_box, rendering_mode, canvas); }
-                None => warn!("Failed to load an embedded image."),
+        usvg::ImageKind::JPEG(ref data) | usvg::ImageKind::PNG(ref data) => {
+            let start = canvas.stats().map(|_| std::time::Instant::now());
+            let pixmap = decode_raster(kind, &data.data(), canvas.renderer);
+            if let (Some(stats), Some(start)) = (canvas.stats(), start) {
+                stats.update("image", id, |s| s.decode_time += start.elapsed());
             }
-        }
-        usvg::ImageKind::PNG(ref data) => {
-            match read_png(data) {
-                Some(image) => { draw_raster(&image, view_box, rendering_mode, canvas); }
+
+            match pixmap {
+                Some(pixmap) => { draw_raster(&pixmap, view_box, rendering_mode, canvas); }
                 None => warn!("Failed to load an embedded image."),
             }
         }
@@ -42,22 +211,53 @@ pub fn draw_kind(
     }
 }
 
+/// Decodes a raster image or takes it from the renderer's images cache.
+fn decode_raster(
+    kind: &usvg::ImageKind,
+    data: &Arc<Vec<u8>>,
+    renderer: &crate::Renderer,
+) -> Option<Arc<tiny_skia::Pixmap>> {
+    let decode = || {
+        let img = match kind {
+            usvg::ImageKind::JPEG(_) => read_jpeg(data)?,
+            _ => read_png(data)?,
+        };
+
+        let (w, h) = img.size.dimensions();
+        let mut pixmap = tiny_skia::Pixmap::new(w, h)?;
+        image_to_pixmap(&img, pixmap.data_mut());
+        Some(Arc::new(pixmap))
+    };
+
+    let cache = match renderer.options().image_cache {
+        Some(ref cache) => cache,
+        None => return decode(),
+    };
+
+    let hash = cache.hash(data);
+    if let Some(pixmap) = cache.get(hash, data) {
+        return Some(pixmap);
+    }
+
+    let pixmap = decode()?;
+    cache.insert(hash, data.clone(), pixmap.clone());
+    Some(pixmap)
+}
+
 fn draw_raster(
-    img: &Image,
+    pixmap: &tiny_skia::Pixmap,
     view_box: usvg::ViewBox,
     rendering_mode: usvg::ImageRendering,
     canvas: &mut Canvas,
 ) -> Option<()> {
-    let (w, h) = img.size.dimensions();
-    let mut pixmap = tiny_skia::Pixmap::new(w, h)?;
-    image_to_pixmap(img, pixmap.data_mut());
+    let img_size = ScreenSize::new(pixmap.width(), pixmap.height())?;
 
     let mut filter = tiny_skia::FilterQuality::Bicubic;
-    if rendering_mode == usvg::ImageRendering::OptimizeSpeed {
+    if rendering_mode == usvg::ImageRendering::OptimizeSpeed || canvas.is_preview() {
         filter = tiny_skia::FilterQuality::Nearest;
     }
 
-    let r = image_rect(&view_box, img.size);
+    let r = image_rect(&view_box, img_size);
     let rect = tiny_skia::Rect::from_xywh(
         r.x() as f32, r.y() as f32,
         r.width() as f32, r.height() as f32,
@@ -138,8 +338,8 @@ fn draw_svg(
 
     let mut sub_pixmap = canvas.pixmap.to_owned();
     sub_pixmap.fill(tiny_skia::Color::TRANSPARENT);
-    let mut sub_canvas = Canvas::from(sub_pixmap.as_mut());
-    sub_canvas.transform = canvas.transform;
+    let mut sub_canvas = canvas.new_layer(sub_pixmap.as_mut(), 0, 0);
+    sub_canvas.tree = tree.clone();
     sub_canvas.apply_transform(ts.to_native());
     render_to_canvas(tree, img_size, &mut sub_canvas);
 
@@ -266,3 +466,86 @@ fn image_rect(
 
     new_size.to_rect(x, y)
 }
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn pixmap(size: u32) -> Arc<tiny_skia::Pixmap> {
+        Arc::new(tiny_skia::Pixmap::new(size, size).unwrap())
+    }
+
+    #[test]
+    fn hit_and_miss() {
+        let cache = ImageCache::new(1024 * 1024);
+        let data = Arc::new(vec![1, 2, 3]);
+        let image = pixmap(10);
+        cache.insert(hash_data(&data), data.clone(), image.clone());
+
+        assert!(Arc::ptr_eq(&cache.get(hash_data(&data), &data).unwrap(), &image));
+        // The same content in a different buffer.
+        let copy = Arc::new(vec![1, 2, 3]);
+        assert!(Arc::ptr_eq(&cache.get(hash_data(&copy), &copy).unwrap(), &image));
+        assert!(cache.get(hash_data(&[3, 2, 1]), &Arc::new(vec![3, 2, 1])).is_none());
+        assert_eq!(cache.size(), image.data().len());
+    }
+
+    #[test]
+    fn hash_collision() {
+        let cache = ImageCache::new(1024 * 1024);
+        cache.insert(1, Arc::new(vec![1, 2, 3]), pixmap(10));
+
+        // Same hash and length, but a different content.
+        assert!(cache.get(1, &Arc::new(vec![3, 2, 1])).is_none());
+
+        // Both images can be stored under the same hash.
+        let image = pixmap(20);
+        cache.insert(1, Arc::new(vec![3, 2, 1]), image.clone());
+        assert!(Arc::ptr_eq(&cache.get(1, &Arc::new(vec![3, 2, 1])).unwrap(), &image));
+        assert!(cache.get(1, &Arc::new(vec![1, 2, 3])).is_some());
+    }
+
+    #[test]
+    fn hash_cached_buffer_once() {
+        let cache = ImageCache::new(1024 * 1024);
+        let data = Arc::new(vec![1, 2, 3]);
+        assert_eq!(cache.hash(&data), hash_data(&data));
+
+        // A cached buffer is looked up by its address, not hashed again.
+        cache.insert(1, data.clone(), pixmap(10));
+        assert_eq!(cache.hash(&data), 1);
+        assert!(cache.get(cache.hash(&data), &data).is_some());
+
+        // The same content in a different buffer is hashed.
+        let copy = Arc::new(vec![1, 2, 3]);
+        assert_eq!(cache.hash(&copy), hash_data(&copy));
+
+        cache.clear();
+        assert_eq!(cache.hash(&data), hash_data(&data));
+    }
+
+    #[test]
+    fn evict_least_recently_used() {
+        // Fits two 10x10 images.
+        let cache = ImageCache::new(800);
+        let data: Vec<_> = (0..3).map(|n| Arc::new(vec![n])).collect();
+        cache.insert(hash_data(&data[0]), data[0].clone(), pixmap(10));
+        cache.insert(hash_data(&data[1]), data[1].clone(), pixmap(10));
+        assert!(cache.get(hash_data(&data[0]), &data[0]).is_some());
+
+        cache.insert(hash_data(&data[2]), data[2].clone(), pixmap(10));
+        assert!(cache.get(hash_data(&data[0]), &data[0]).is_some());
+        assert!(cache.get(hash_data(&data[1]), &data[1]).is_none());
+        assert!(cache.get(hash_data(&data[2]), &data[2]).is_some());
+        assert_eq!(cache.size(), 800);
+
+        // Larger than the budget.
+        cache.insert(hash_data(&[9]), Arc::new(vec![9]), pixmap(20));
+        assert_eq!(cache.size(), 800);
+
+        cache.clear();
+        assert_eq!(cache.size(), 0);
+        assert!(cache.get(hash_data(&data[0]), &data[0]).is_none());
+    }
+}
@@ -0,0 +1,183 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::sync::Mutex;
+
+/// The maximum total size of layers kept by a pool, in bytes.
+///
+/// Enough for a few full-HD layers.
+const MAX_POOL_SIZE: usize = 32 * 1024 * 1024;
+
+/// How many times a reused layer can be larger than the requested one.
+///
+/// A larger layer has to be cleared and blended entirely,
+/// so reusing a layer that is much larger than needed is slower than allocating a new one.
+const MAX_LAYER_OVERHEAD: u64 = 4;
+
+/// Newly allocated layers that can be larger than requested are rounded up to this size,
+/// so groups with slightly different bboxes can share them.
+///
+/// Small layers are not rounded when the rounded area exceeds `MAX_LAYER_OVERHEAD`,
+/// otherwise the same request would not be able to reuse them.
+const LAYER_SIZE_STEP: u32 = 64;
+
+/// A pool of scratch pixmaps used as groups, clip paths and masks layers.
+///
+/// Instead of allocating a new pixmap for each group, we're reusing the one
+/// that was released by a previous group.
+#[derive(Default)]
+pub struct LayerPool {
+    layers: Mutex<Vec<tiny_skia::Pixmap>>,
+}
+
+impl LayerPool {
+    /// Returns a transparent pixmap of the specified size.
+    ///
+    /// Returns `None` when the size is zero.
+    pub fn take(&self, width: u32, height: u32) -> Option<tiny_skia::Pixmap> {
+        let layer = self.take_matching(|p| p.width() == width && p.height() == height);
+        match layer {
+            Some(pixmap) => Some(pixmap),
+            None => tiny_skia::Pixmap::new(width, height),
+        }
+    }
+
+    /// Returns a transparent pixmap that is at least of the specified size.
+    ///
+    /// Used by layers that are drawn back as is, so their size is not important.
+    /// The smallest suitable pixmap from the pool will be returned.
+    ///
+    /// Returns `None` when the size is zero.
+    pub fn take_at_least(&self, width: u32, height: u32) -> Option<tiny_skia::Pixmap> {
+        let max_area = width as u64 * height as u64 * MAX_LAYER_OVERHEAD;
+        let layer = self.take_matching(|p| {
+            p.width() >= width && p.height() >= height && p.width() as u64 * p.height() as u64 <= max_area
+        });
+
+        match layer {
+            Some(pixmap) => Some(pixmap),
+            None if width == 0 || height == 0 => None,
+            None => {
+                let (rounded_width, rounded_height) = (round_up(width), round_up(height));
+                if rounded_width as u64 * rounded_height as u64 <= max_area {
+                    tiny_skia::Pixmap::new(rounded_width, rounded_height)
+                } else {
+                    tiny_skia::Pixmap::new(width, height)
+                }
+            }
+        }
+    }
+
+    /// Removes the smallest matching pixmap from the pool and clears it.
+    fn take_matching<F>(&self, f: F) -> Option<tiny_skia::Pixmap>
+        where F: Fn(&tiny_skia::Pixmap) -> bool
+    {
+        let mut layers = self.layers.lock().ok()?;
+        let idx = layers.iter().enumerate()
+            .filter(|(_, p)| f(p))
+            .min_by_key(|(_, p)| p.data().len())
+            .map(|(idx, _)| idx)?;
+
+        let mut pixmap = layers.remove(idx);
+        drop(layers);
+
+        pixmap.fill(tiny_skia::Color::TRANSPARENT);
+        Some(pixmap)
+    }
+
+    /// Returns a pixmap to the pool.
+    ///
+    /// The least recently released layers will be deallocated when the pool is full.
+    pub fn release(&self, pixmap: tiny_skia::Pixmap) {
+        let size = pixmap.data().len();
+        if size > MAX_POOL_SIZE {
+            return;
+        }
+
+        if let Ok(mut layers) = self.layers.lock() {
+            let mut total: usize = layers.iter().map(|p| p.data().len()).sum();
+            while total + size > MAX_POOL_SIZE {
+                total -= layers.remove(0).data().len();
+            }
+
+            layers.push(pixmap);
+        }
+    }
+
+    /// Deallocates all layers.
+    pub fn clear(&self) {
+        if let Ok(mut layers) = self.layers.lock() {
+            layers.clear();
+        }
+    }
+}
+
+fn round_up(n: u32) -> u32 {
+    n.checked_add(LAYER_SIZE_STEP - 1).map(|n| n / LAYER_SIZE_STEP * LAYER_SIZE_STEP).unwrap_or(n)
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn reuse_exact() {
+        let pool = LayerPool::default();
+        let mut pixmap = pool.take(100, 50).unwrap();
+        pixmap.fill(tiny_skia::Color::BLACK);
+        let ptr = pixmap.data().as_ptr();
+        pool.release(pixmap);
+
+        assert!(pool.take(50, 100).map(|p| p.data().as_ptr()) != Some(ptr));
+
+        let pixmap = pool.take(100, 50).unwrap();
+        assert_eq!(pixmap.data().as_ptr(), ptr);
+        assert!(pixmap.data().iter().all(|p| *p == 0));
+    }
+
+    #[test]
+    fn reuse_larger() {
+        let pool = LayerPool::default();
+        let pixmap = pool.take_at_least(100, 100).unwrap();
+        assert_eq!((pixmap.width(), pixmap.height()), (128, 128));
+        let ptr = pixmap.data().as_ptr();
+        pool.release(pixmap);
+
+        // Too small.
+        assert!(pool.take_at_least(10, 10).map(|p| p.data().as_ptr()) != Some(ptr));
+
+        let pixmap = pool.take_at_least(90, 120).unwrap();
+        assert_eq!(pixmap.data().as_ptr(), ptr);
+    }
+
+    #[test]
+    fn reuse_small() {
+        let pool = LayerPool::default();
+        let pixmap = pool.take_at_least(10, 10).unwrap();
+        assert_eq!((pixmap.width(), pixmap.height()), (10, 10));
+        let ptr = pixmap.data().as_ptr();
+        pool.release(pixmap);
+
+        let pixmap = pool.take_at_least(10, 10).unwrap();
+        assert_eq!(pixmap.data().as_ptr(), ptr);
+    }
+
+    #[test]
+    fn size_limit() {
+        let pool = LayerPool::default();
+        // 16 MiB each.
+        for _ in 0..3 {
+            pool.release(tiny_skia::Pixmap::new(2048, 2048).unwrap());
+        }
+        assert_eq!(pool.layers.lock().unwrap().len(), 2);
+
+        // Larger than the whole pool.
+        pool.release(tiny_skia::Pixmap::new(4096, 4096).unwrap());
+        assert_eq!(pool.layers.lock().unwrap().len(), 2);
+
+        pool.clear();
+        assert!(pool.layers.lock().unwrap().is_empty());
+    }
+}
@@ -14,20 +14,335 @@
 #![allow(clippy::upper_case_acronyms)]
 
 pub use usvg::ScreenSize;
+pub use crate::control::{CancelToken, Limits, RenderControl, RenderError};
+pub use crate::image::ImageCache;
+pub use crate::stats::{NodeStats, RenderStats};
 
 use usvg::NodeExt;
 use log::warn;
 
 #[macro_use] mod macros;
 mod clip;
+mod control;
 mod filter;
 mod image;
+mod layers;
 mod mask;
 mod paint_server;
+mod parallel;
 mod path;
 mod render;
+mod stats;
 
 
+/// Rendering options.
+#[derive(Clone, Debug)]
+pub struct Options {
+    /// The maximum number of threads that can be used to render a single image.
+    ///
+    /// Only filter primitives are rendered in parallel for now.
+    /// Small images are always rendered by the calling thread.
+    ///
+    /// `0` indicates the number of available CPUs.
+    ///
+    /// Default: 1
+    pub threads: usize,
+
+    /// A decoded raster images cache.
+    ///
+    /// Can be shared between multiple renderers.
+    ///
+    /// Default: None
+    pub image_cache: Option<std::sync::Arc<ImageCache>>,
+
+    /// Renders blurs with a large standard deviation at a reduced resolution.
+    ///
+    /// `feGaussianBlur` with a standard deviation above 20 pixels will be downsampled
+    /// by a power of two, so the standard deviation stays at least 8 pixels,
+    /// blurred and then upscaled back using a bilinear filtering.
+    /// A blur that large has no sharp details, so the difference is barely visible,
+    /// but the result is not identical to the precise one:
+    /// each channel can differ by up to 4 of 255.
+    /// Downsampling is aligned to the image pixels, so regions rendered
+    /// via `render_region` are downsampled the same way as the whole image.
+    ///
+    /// Default: false
+    pub fast_blur: bool,
+
+    /// Caches dashed strokes between renders.
+    ///
+    /// Useful when the same tree is rendered multiple times, like in an interactive viewer.
+    /// A cached path is reused when the canvas is translated or scaled down
+    /// by up to a factor of two.
+    ///
+    /// Default: false
+    pub path_cache: bool,
+
+    /// Per-render resource limits.
+    ///
+    /// Default: no limits
+    pub limits: Limits,
+}
+
+impl Default for Options {
+    fn default() -> Options {
+        Options {
+            threads: 1,
+            image_cache: None,
+            fast_blur: false,
+            path_cache: false,
+            limits: Limits::default(),
+        }
+    }
+}
+
+
+/// The downscale factor of a preview render.
+const PREVIEW_SCALE: u32 = 2;
+
+
+/// An SVG renderer.
+///
+/// Unlike free functions, allows to configure the rendering.
+///
+/// A renderer keeps scratch buffers between renders,
+/// so it's better to reuse it instead of creating a new one for each image.
+#[derive(Default)]
+pub struct Renderer {
+    opt: Options,
+    pub(crate) layers: layers::LayerPool,
+    pub(crate) turbulence: filter::TurbulenceCache,
+    pub(crate) paths: path::PathCache,
+}
+
+impl Renderer {
+    /// Creates a new renderer.
+    pub fn new(opt: Options) -> Self {
+        Renderer {
+            opt,
+            layers: layers::LayerPool::default(),
+            turbulence: filter::TurbulenceCache::default(),
+            paths: path::PathCache::default(),
+        }
+    }
+
+    /// Returns rendering options.
+    pub fn options(&self) -> &Options {
+        &self.opt
+    }
+
+    /// Deallocates all scratch buffers kept by the renderer.
+    pub fn clear_cache(&self) {
+        self.layers.clear();
+        self.turbulence.clear();
+        self.paths.clear();
+    }
+
+    /// Creates a state of a new render.
+    fn progress<'a>(
+        &self,
+        control: RenderControl<'a>,
+        node: &usvg::Node,
+        pixmap: &tiny_skia::PixmapMut,
+    ) -> control::Progress<'a> {
+        let target_memory = pixmap.width() as usize * pixmap.height() as usize
+            * tiny_skia::BYTES_PER_PIXEL;
+        control::Progress::new(control, self.opt.limits, node, target_memory)
+    }
+
+    /// Returns the number of threads that can be used for rendering.
+    pub(crate) fn threads(&self) -> usize {
+        if self.opt.threads == 0 {
+            std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1)
+        } else {
+            self.opt.threads
+        }
+    }
+
+    /// Renders an SVG to pixmap.
+    ///
+    /// See `resvg::render` for details.
+    pub fn render(
+        &self,
+        tree: &usvg::Tree,
+        fit_to: usvg::FitTo,
+        pixmap: tiny_skia::PixmapMut,
+    ) -> Option<()> {
+        let size = fit_to.fit_to(tree.svg_node().size.to_screen_size())?;
+        let progress = self.progress(RenderControl::default(), &tree.root(), &pixmap);
+        if !progress.check_pixels(pixmap.width(), pixmap.height()) {
+            return None;
+        }
+
+        let mut canvas = render::Canvas::new(pixmap, tree, self);
+        canvas.progress = Some(&progress);
+        render::render_to_canvas(tree, size, &mut canvas);
+        Some(())
+    }
+
+    /// Renders an SVG to pixmap with a progress reporting and cancellation.
+    ///
+    /// Unlike `render`, reports when the render was canceled or reached the `Options::limits`.
+    ///
+    /// See `resvg::render` for details.
+    pub fn render_with_control(
+        &self,
+        tree: &usvg::Tree,
+        fit_to: usvg::FitTo,
+        pixmap: tiny_skia::PixmapMut,
+        control: RenderControl,
+    ) -> Result<(), RenderError> {
+        let size = fit_to.fit_to(tree.svg_node().size.to_screen_size())
+            .ok_or(RenderError::InvalidSize)?;
+        let progress = self.progress(control, &tree.root(), &pixmap);
+        if !progress.check_pixels(pixmap.width(), pixmap.height()) {
+            return Err(RenderError::TargetTooLarge);
+        }
+
+        if control.preview {
+            self.render_preview(tree, size, pixmap, &progress);
+        } else {
+            let mut canvas = render::Canvas::new(pixmap, tree, self);
+            canvas.progress = Some(&progress);
+            render::render_to_canvas(tree, size, &mut canvas);
+        }
+
+        progress.result()
+    }
+
+    /// Renders an SVG at a reduced resolution and upscales it to pixmap.
+    ///
+    /// Filters, patterns and layers are processed at the reduced resolution as well,
+    /// so a preview costs a fraction of a normal render.
+    fn render_preview(
+        &self,
+        tree: &usvg::Tree,
+        size: ScreenSize,
+        mut pixmap: tiny_skia::PixmapMut,
+        progress: &control::Progress,
+    ) {
+        let scale_down = |n: u32| (n + PREVIEW_SCALE - 1) / PREVIEW_SCALE;
+        let preview_size = match ScreenSize::new(scale_down(size.width()), scale_down(size.height())) {
+            Some(v) => v,
+            None => return,
+        };
+
+        // The preview buffer replaces the target, which is already checked by `max_pixels`,
+        // so it's not counted as a layer.
+        let mut layer = match self.layers.take(scale_down(pixmap.width()), scale_down(pixmap.height())) {
+            Some(v) => v,
+            None => return,
+        };
+
+        {
+            let mut canvas = render::Canvas::new(layer.as_mut(), tree, self);
+            canvas.progress = Some(progress);
+            render::render_to_canvas(tree, preview_size, &mut canvas);
+        }
+
+        if !progress.is_canceled() {
+            let sx = size.width() as f32 / preview_size.width() as f32;
+            let sy = size.height() as f32 / preview_size.height() as f32;
+            let mut paint = tiny_skia::PixmapPaint::default();
+            paint.quality = tiny_skia::FilterQuality::Bilinear;
+            pixmap.draw_pixmap(0, 0, layer.as_ref(), &paint,
+                               tiny_skia::Transform::from_scale(sx, sy), None);
+        }
+
+        self.layers.release(layer);
+    }
+
+    /// Renders a region of an SVG to pixmap.
+    ///
+    /// Unlike `resvg::render_region`, reports when the render reached the `Options::limits`.
+    ///
+    /// See `resvg::render_region` for details.
+    pub fn render_region(
+        &self,
+        tree: &usvg::Tree,
+        fit_to: usvg::FitTo,
+        x: i32,
+        y: i32,
+        pixmap: tiny_skia::PixmapMut,
+    ) -> Result<(), RenderError> {
+        let size = fit_to.fit_to(tree.svg_node().size.to_screen_size())
+            .ok_or(RenderError::InvalidSize)?;
+        let image_rect = usvg::ScreenRect::new(-x, -y, size.width(), size.height())
+            .ok_or(RenderError::InvalidSize)?;
+        let progress = self.progress(RenderControl::default(), &tree.root(), &pixmap);
+        if !progress.check_pixels(pixmap.width(), pixmap.height()) {
+            return Err(RenderError::TargetTooLarge);
+        }
+
+        let mut canvas = render::Canvas::new(pixmap, tree, self);
+        canvas.progress = Some(&progress);
+        canvas.translate(-x as f32, -y as f32);
+        canvas.image_rect = image_rect;
+        render::render_to_canvas(tree, size, &mut canvas);
+        progress.result()
+    }
+
+    /// Renders an SVG node to pixmap.
+    ///
+    /// `node` must belong to `tree`. Unlike `node.tree()`, `tree` has an ID index,
+    /// which makes references resolving faster.
+    ///
+    /// Unlike `resvg::render_node`, reports when the render reached the `Options::limits`.
+    ///
+    /// See `resvg::render_node` for details.
+    pub fn render_node(
+        &self,
+        tree: &usvg::Tree,
+        node: &usvg::Node,
+        fit_to: usvg::FitTo,
+        pixmap: tiny_skia::PixmapMut,
+    ) -> Result<(), RenderError> {
+        let node_bbox = if let Some(bbox) = node.calculate_bbox() {
+            bbox
+        } else {
+            warn!("Node '{}' has zero size.", node.id());
+            return Err(RenderError::InvalidSize);
+        };
+
+        let vbox = usvg::ViewBox {
+            rect: node_bbox,
+            aspect: usvg::AspectRatio::default(),
+        };
+
+        let size = fit_to.fit_to(node_bbox.size().to_screen_size())
+            .ok_or(RenderError::InvalidSize)?;
+        let progress = self.progress(RenderControl::default(), node, &pixmap);
+        if !progress.check_pixels(pixmap.width(), pixmap.height()) {
+            return Err(RenderError::TargetTooLarge);
+        }
+
+        let mut canvas = render::Canvas::new(pixmap, tree, self);
+        canvas.progress = Some(&progress);
+        render::render_node_to_canvas(node, vbox, size, &mut render::RenderState::Ok, &mut canvas);
+        progress.result()
+    }
+}
+
+
+/// Calculates a rect of the image that has to be re-rendered after a node modification.
+///
+/// Should be called both before and after the modification,
+/// since a node can be moved or resized. The union of the two rects
+/// can then be re-rendered via `render_region`.
+///
+/// The rect is conservative and includes strokes, filter regions of the node's ancestors
+/// and the anti-aliasing. The whole image rect will be returned when a node
+/// is used indirectly, like inside a pattern.
+///
+/// Returns `None` when the node doesn't affect the image.
+pub fn damage_rect(
+    node: &usvg::Node,
+    fit_to: usvg::FitTo,
+) -> Option<usvg::ScreenRect> {
+    let size = fit_to.fit_to(node.tree().svg_node().size.to_screen_size())?;
+    render::calc_damage_rect(node, size)
+}
+
 /// Renders an SVG to pixmap.
 ///
 /// If `fit_to` size differs from `tree.svg_node().size`,
@@ -37,10 +352,25 @@ pub fn render(
     fit_to: usvg::FitTo,
     pixmap: tiny_skia::PixmapMut,
 ) -> Option<()> {
-    let size = fit_to.fit_to(tree.svg_node().size.to_screen_size())?;
-    let mut canvas = render::Canvas::from(pixmap);
-    render::render_to_canvas(tree, size, &mut canvas);
-    Some(())
+    Renderer::default().render(tree, fit_to, pixmap)
+}
+
+/// Renders a region of an SVG to pixmap.
+///
+/// `fit_to` defines the size of the whole image, while `pixmap` contains
+/// only a part of it, which top-left corner is located at `x`, `y`.
+///
+/// Unlike cropping a full render, requires only a pixmap-sized memory,
+/// so huge images can be rendered tile by tile.
+/// Tiles rendered this way are seamless.
+pub fn render_region(
+    tree: &usvg::Tree,
+    fit_to: usvg::FitTo,
+    x: i32,
+    y: i32,
+    pixmap: tiny_skia::PixmapMut,
+) -> Option<()> {
+    Renderer::default().render_region(tree, fit_to, x, y, pixmap).ok()
 }
 
 /// Renders an SVG node to pixmap.
@@ -52,20 +382,5 @@ pub fn render_node(
     fit_to: usvg::FitTo,
     pixmap: tiny_skia::PixmapMut,
 ) -> Option<()> {
-    let node_bbox = if let Some(bbox) = node.calculate_bbox() {
-        bbox
-    } else {
-        warn!("Node '{}' has zero size.", node.id());
-        return None;
-    };
-
-    let vbox = usvg::ViewBox {
-        rect: node_bbox,
-        aspect: usvg::AspectRatio::default(),
-    };
-
-    let size = fit_to.fit_to(node_bbox.size().to_screen_size())?;
-    let mut canvas = render::Canvas::from(pixmap);
-    render::render_node_to_canvas(node, vbox, size, &mut render::RenderState::Ok, &mut canvas);
-    Some(())
+    Renderer::default().render_node(&node.tree(), node, fit_to, pixmap).ok()
 }
@@ -2,8 +2,12 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+use std::collections::HashMap;
 use std::io::Write;
 use std::path;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
 
 use usvg::{NodeExt, SystemFontDB};
 
@@ -28,7 +32,7 @@ fn main() {
 }
 
 fn process() -> Result<(), String> {
-    let args = match parse_args() {
+    let mut args = match parse_args() {
         Ok(args) => args,
         Err(e) => {
             println!("{}", HELP);
@@ -45,6 +49,10 @@ fn process() -> Result<(), String> {
         }
     }
 
+    if let Some(batch) = args.batch.take() {
+        return render_batch(&args, batch);
+    }
+
     let svg_data = timed!(args, "Reading", {
         if args.in_svg == "-" {
             use std::io::Read;
@@ -115,6 +123,7 @@ fn query_all(tree: &usvg::Tree) -> Result<(), String> {
 
 fn render_svg(args: Args, tree: &usvg::Tree, out_png: &path::Path) -> Result<(), String> {
     let now = std::time::Instant::now();
+    let stats = resvg::RenderStats::new();
 
     let img = if let Some(ref id) = args.export_id {
         if let Some(node) = tree.root().descendants().find(|n| &*n.id() == id) {
@@ -132,7 +141,8 @@ fn render_svg(args: Args, tree: &usvg::Tree, out_png: &path::Path) -> Result<(),
                     background.red, background.green, background.blue, 255));
             }
 
-            resvg::render_node(&node, args.fit_to, pixmap.as_mut());
+            args.renderer.render_node(tree, &node, args.fit_to, pixmap.as_mut())
+                .map_err(|e| e.to_string())?;
             pixmap
         } else {
             return Err(format!("SVG doesn't have '{}' ID", id));
@@ -149,17 +159,215 @@ fn render_svg(args: Args, tree: &usvg::Tree, out_png: &path::Path) -> Result<(),
                 background.red, background.green, background.blue, 255));
         }
 
-        resvg::render(tree, args.fit_to, pixmap.as_mut());
+        if args.perf {
+            let control = resvg::RenderControl { stats: Some(&stats), ..Default::default() };
+            let _ = args.renderer.render_with_control(tree, args.fit_to, pixmap.as_mut(), control);
+        } else {
+            args.renderer.render(tree, args.fit_to, pixmap.as_mut());
+        }
+
         pixmap
     };
 
     if args.perf {
         println!("Rendering: {:.2}ms", now.elapsed().as_micros() as f64 / 1000.0);
+
+        // Print only the slowest elements, since the list can be really long.
+        for node in stats.nodes().iter().take(10) {
+            let id = if node.id.is_empty() { "-" } else { &node.id };
+            println!("  {} '{}': {:.2}ms, {} time(s), {} layer(s), {} Kb, {} px",
+                     node.kind, id, node.time.as_micros() as f64 / 1000.0,
+                     node.count, node.layers, node.layers_memory / 1024, node.region_pixels);
+        }
     }
 
     timed!(args, "Saving", img.save_png(out_png).map_err(|e| e.to_string()))
 }
 
+/// Files in a batch usually share fonts, so glyph outlines and shaped text are cached.
+const BATCH_GLYPH_CACHE_BUDGET: usize = 16 * 1024 * 1024;
+const BATCH_SHAPING_CACHE_BUDGET: usize = 4 * 1024 * 1024;
+
+/// Timings of a single batch file.
+struct BatchTimings {
+    parsing: f64,
+    rendering: f64,
+    saving: f64,
+}
+
+fn render_batch(args: &Args, batch: Batch) -> Result<(), String> {
+    if batch.files.len() > 1 && !batch.template.contains("{name}") {
+        return Err("the output template must contain {name}".to_string());
+    }
+
+    if batch.widths.len() > 1 && !batch.template.contains("{width}") {
+        return Err("the output template must contain {width} when multiple widths are set"
+            .to_string());
+    }
+
+    // Output paths are checked up front, since parallel jobs would overwrite each other.
+    let outputs = batch_outputs(&batch.template, &batch.files)?;
+
+    let now = Instant::now();
+
+    let jobs = match batch.jobs {
+        0 => std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1),
+        n => n,
+    }.min(batch.files.len()).max(1);
+
+    // Files are already rendered in parallel,
+    // so there is no point in multi-threaded filters.
+    let mut renderer_opt = args.renderer.options().clone();
+    if jobs > 1 {
+        renderer_opt.threads = 1;
+    }
+    let renderer = resvg::Renderer::new(renderer_opt);
+
+    // The fonts database is already loaded and shared by all files.
+    let mut opt = args.usvg.clone();
+    opt.glyph_cache = Some(Arc::new(usvg::GlyphCache::new(BATCH_GLYPH_CACHE_BUDGET)));
+    opt.shaping_cache = Some(Arc::new(usvg::ShapingCache::new(BATCH_SHAPING_CACHE_BUDGET)));
+
+    let fit_to_list: Vec<usvg::FitTo> = if batch.widths.is_empty() {
+        vec![args.fit_to]
+    } else {
+        batch.widths.iter().map(|w| usvg::FitTo::Width(*w)).collect()
+    };
+
+    // Files are taken from the end, so the list is reversed to keep the original order.
+    let files: Vec<(&path::Path, &str)> = batch.files.iter().zip(outputs.iter()).rev()
+        .map(|(p, o)| (p.as_path(), o.as_str())).collect();
+    let files = Mutex::new(files);
+    let failed = AtomicUsize::new(0);
+
+    // Each worker takes the next file as soon as it's done with the previous one,
+    // so a few heavy files do not hold the whole batch.
+    let work = || loop {
+        let (file, template) = match files.lock().unwrap().pop() {
+            Some(v) => v,
+            None => break,
+        };
+
+        match render_batch_file(args, &opt, &renderer, template, &fit_to_list, file) {
+            Ok(timings) => {
+                if args.perf {
+                    println!("{}: parsing {:.2}ms, rendering {:.2}ms, saving {:.2}ms",
+                             file.display(), timings.parsing, timings.rendering, timings.saving);
+                }
+            }
+            Err(e) => {
+                eprintln!("Error: {}: {}.", file.display(), e);
+                failed.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+    };
+
+    if jobs > 1 {
+        let work = &work;
+        std::thread::scope(|s| {
+            for _ in 1..jobs {
+                s.spawn(move || work());
+            }
+
+            work();
+        });
+    } else {
+        work();
+    }
+
+    let failed = failed.load(Ordering::Relaxed);
+    if args.perf {
+        println!("Rendered {} of {} files in {:.2}ms using {} thread(s)",
+                 batch.files.len() - failed, batch.files.len(),
+                 now.elapsed().as_micros() as f64 / 1000.0, jobs);
+    }
+
+    if failed != 0 {
+        return Err(format!("failed to render {} of {} files", failed, batch.files.len()));
+    }
+
+    Ok(())
+}
+
+/// Returns the output template of each file with `{name}` already replaced.
+///
+/// Fails when two files have the same output path, like `a/x.svg` and `b/x.svg`
+/// or `x.svg` and `x.svgz`.
+fn batch_outputs(template: &str, files: &[path::PathBuf]) -> Result<Vec<String>, String> {
+    let mut outputs = Vec::with_capacity(files.len());
+    let mut used: HashMap<String, &path::Path> = HashMap::new();
+    for file in files {
+        let name = file.file_stem().map(|s| s.to_string_lossy()).unwrap_or_default();
+        let output = template.replace("{name}", &name);
+        if let Some(prev) = used.insert(output.clone(), file) {
+            return Err(format!("'{}' and '{}' have the same output path '{}'",
+                               prev.display(), file.display(), output));
+        }
+
+        outputs.push(output);
+    }
+
+    Ok(outputs)
+}
+
+fn render_batch_file(
+    args: &Args,
+    opt: &usvg::Options,
+    renderer: &resvg::Renderer,
+    template: &str,
+    fit_to_list: &[usvg::FitTo],
+    file: &path::Path,
+) -> Result<BatchTimings, String> {
+    let now = Instant::now();
+
+    let svg_data = std::fs::read(file).map_err(|_| "failed to open the file".to_string())?;
+
+    let tree = if opt.resources_dir.is_some() {
+        usvg::Tree::from_data(&svg_data, opt)
+    } else {
+        // Resolve relative paths against the file's own directory.
+        let mut opt = opt.clone();
+        opt.resources_dir = std::fs::canonicalize(file).ok()
+            .and_then(|p| p.parent().map(|p| p.to_path_buf()));
+        usvg::Tree::from_data(&svg_data, &opt)
+    }.map_err(|e| e.to_string())?;
+    drop(svg_data);
+
+    let parsing = now.elapsed();
+
+    let mut rendering = std::time::Duration::default();
+    let mut saving = std::time::Duration::default();
+    for fit_to in fit_to_list {
+        let size = fit_to.fit_to(tree.svg_node().size.to_screen_size())
+            .ok_or_else(|| "target size is zero".to_string())?;
+
+        let now = Instant::now();
+
+        // Unwrap is safe, because `size` is already valid.
+        let mut pixmap = tiny_skia::Pixmap::new(size.width(), size.height()).unwrap();
+
+        if let Some(background) = args.background {
+            pixmap.fill(tiny_skia::Color::from_rgba8(
+                background.red, background.green, background.blue, 255));
+        }
+
+        renderer.render(&tree, *fit_to, pixmap.as_mut());
+        rendering += now.elapsed();
+
+        let now = Instant::now();
+        let out_png = template.replace("{width}", &size.width().to_string());
+        pixmap.save_png(&out_png).map_err(|e| format!("failed to save '{}' cause {}", out_png, e))?;
+        saving += now.elapsed();
+    }
+
+    let to_ms = |d: std::time::Duration| d.as_micros() as f64 / 1000.0;
+    Ok(BatchTimings {
+        parsing: to_ms(parsing),
+        rendering: to_ms(rendering),
+        saving: to_ms(saving),
+    })
+}
+
 fn dump_svg(tree: &usvg::Tree, path: &path::Path) -> Result<(), String> {
     let mut f = std::fs::File::create(path)
         .map_err(|_| format!("failed to create a file {:?}", path))?;
@@ -177,10 +385,12 @@ resvg is an SVG rendering application.
 USAGE:
   resvg [OPTIONS] <in-svg> <out-png>  # from file to file
   resvg [OPTIONS] - <out-png>         # from stdin to file
+  resvg [OPTIONS] --batch <PATH> <out-template>  # many files
 
   resvg in.svg out.png
   resvg -z 4 in.svg out.png
   resvg --query-all in.svg
+  resvg --batch icons/ --widths 16,32 out/{name}-{width}.png
 
 OPTIONS:
       --help                    Prints this help
@@ -193,6 +403,11 @@ OPTIONS:
                                 [default: 96] [possible values: 10..4000]
   --background COLOR            Sets the background color
                                 Examples: red, #fff, #fff000
+  --threads NUM                 Sets the maximum number of rendering threads.
+                                0 indicates the number of CPUs
+                                [default: 1]
+  --fast-blur                   Renders large blurs at a reduced resolution.
+                                Faster, but not identical to the precise rendering
 
   --languages LANG              Sets a comma-separated list of languages that
                                 will be used during the 'systemLanguage'
@@ -254,9 +469,24 @@ OPTIONS:
   --quiet                       Disables warnings
   --dump-svg PATH               Saves the preprocessed SVG into the selected file
 
+  --batch PATH                  Renders all SVG files from a directory or from
+                                a list file with one path per line.
+                                Fonts are loaded only once.
+                                The output file becomes a template, where {name}
+                                is replaced with the input file name and {width}
+                                with the image width.
+                                Files with the same name are rejected
+  --widths LIST                 Renders each file at the specified comma-separated
+                                widths. Batch mode only
+                                Example: 16,32,64
+  --jobs NUM                    Sets the number of files rendered in parallel.
+                                0 indicates the number of CPUs. Batch mode only
+                                [default: 0]
+
 ARGS:
   <in-svg>                      Input file
   <out-png>                     Output file
+  <out-template>                Output file template. Batch mode only
 ";
 
 #[derive(Debug)]
@@ -266,6 +496,8 @@ struct CliArgs {
     zoom: Option<f32>,
     dpi: u32,
     background: Option<usvg::Color>,
+    threads: usize,
+    fast_blur: bool,
 
     languages: Vec<String>,
     shape_rendering: usvg::ShapeRendering,
@@ -292,6 +524,10 @@ struct CliArgs {
     quiet: bool,
     dump_svg: Option<String>,
 
+    batch: Option<path::PathBuf>,
+    widths: Vec<u32>,
+    jobs: usize,
+
     input: String,
     output: Option<path::PathBuf>,
 }
@@ -315,6 +551,8 @@ fn collect_args() -> Result<CliArgs, pico_args::Error> {
         zoom:               input.opt_value_from_fn(["-z", "--zoom"], parse_zoom)?,
         dpi:                input.opt_value_from_fn("--dpi", parse_dpi)?.unwrap_or(96),
         background:         input.opt_value_from_str("--background")?,
+        threads:            input.opt_value_from_str("--threads")?.unwrap_or(1),
+        fast_blur:          input.contains("--fast-blur"),
 
         languages:          input.opt_value_from_fn("--languages", parse_languages)?
             .unwrap_or_else(|| vec!["en".to_string()]), // TODO: use system language
@@ -342,6 +580,10 @@ fn collect_args() -> Result<CliArgs, pico_args::Error> {
         quiet:              input.contains("--quiet"),
         dump_svg:           input.opt_value_from_str("--dump-svg")?,
 
+        batch:              input.opt_value_from_str("--batch")?,
+        widths:             input.opt_value_from_fn("--widths", parse_widths)?.unwrap_or_default(),
+        jobs:               input.opt_value_from_str("--jobs")?.unwrap_or(0),
+
         input:              input.free_from_str()?,
         output:             input.opt_free_from_str()?,
     })
@@ -400,6 +642,23 @@ fn parse_languages(s: &str) -> Result<Vec<String>, String> {
     Ok(langs)
 }
 
+fn parse_widths(s: &str) -> Result<Vec<u32>, String> {
+    let mut widths = Vec::new();
+    for width in s.split(',') {
+        widths.push(parse_length(width.trim())?);
+    }
+
+    Ok(widths)
+}
+
+/// A batch mode task.
+struct Batch {
+    files: Vec<path::PathBuf>,
+    template: String,
+    widths: Vec<u32>,
+    jobs: usize,
+}
+
 struct Args {
     in_svg: String,
     out_png: Option<path::PathBuf>,
@@ -411,6 +670,8 @@ struct Args {
     usvg: usvg::Options,
     fit_to: usvg::FitTo,
     background: Option<usvg::Color>,
+    renderer: resvg::Renderer,
+    batch: Option<Batch>,
 }
 
 fn parse_args() -> Result<Args, String> {
@@ -429,11 +690,37 @@ fn parse_args() -> Result<Args, String> {
         }
     }
 
-    if !args.query_all && args.output.is_none() {
-        return Err("<out-png> must be set".to_string());
+    if args.batch.is_some() {
+        if args.query_all || args.export_id.is_some() || args.dump_svg.is_some() {
+            return Err("--batch cannot be used with --query-all, --export-id or --dump-svg"
+                .to_string());
+        }
+
+        // In batch mode, the only free argument is the output template.
+        if args.output.is_some() {
+            return Err("only <out-template> must be set in batch mode".to_string());
+        }
+    } else {
+        if !args.widths.is_empty() {
+            return Err("--widths can be used only with --batch".to_string());
+        }
+
+        if !args.query_all && args.output.is_none() {
+            return Err("<out-png> must be set".to_string());
+        }
     }
 
-    if args.input == "-" && args.resources_dir.is_none() {
+    let batch = match args.batch.take() {
+        Some(path) => Some(Batch {
+            files: collect_batch_files(&path)?,
+            template: args.input.clone(),
+            widths: std::mem::take(&mut args.widths),
+            jobs: args.jobs,
+        }),
+        None => None,
+    };
+
+    if batch.is_none() && args.input == "-" && args.resources_dir.is_none() {
         println!("Warning: Make sure to set --resources-dir when reading SVG from stdin.");
     }
 
@@ -460,6 +747,8 @@ fn parse_args() -> Result<Args, String> {
 
     let resources_dir = match args.resources_dir {
         Some(v) => Some(v),
+        // Will be set per file.
+        None if batch.is_some() => None,
         None => {
             // Get input file absolute directory.
             std::fs::canonicalize(&in_svg).ok().and_then(|p| p.parent().map(|p| p.to_path_buf()))
@@ -476,7 +765,9 @@ fn parse_args() -> Result<Args, String> {
         text_rendering: args.text_rendering,
         image_rendering: args.image_rendering,
         keep_named_groups,
-        fontdb,
+        fontdb: std::sync::Arc::new(fontdb),
+        glyph_cache: None,
+        shaping_cache: None,
     };
 
     Ok(Args {
@@ -490,9 +781,51 @@ fn parse_args() -> Result<Args, String> {
         usvg,
         fit_to,
         background: args.background,
+        renderer: resvg::Renderer::new(resvg::Options {
+            threads: args.threads,
+            fast_blur: args.fast_blur,
+            ..resvg::Options::default()
+        }),
+        batch,
     })
 }
 
+/// Collects SVG files from a directory or a list file.
+fn collect_batch_files(path: &path::Path) -> Result<Vec<path::PathBuf>, String> {
+    let mut files = Vec::new();
+    if path.is_dir() {
+        let entries = std::fs::read_dir(path)
+            .map_err(|_| format!("failed to read '{}'", path.display()))?;
+
+        for entry in entries.flatten() {
+            let file = entry.path();
+            match file.extension().and_then(|e| e.to_str()) {
+                Some("svg") | Some("svgz") => files.push(file),
+                _ => {}
+            }
+        }
+
+        // Directory entries order is not defined.
+        files.sort();
+    } else {
+        let text = std::fs::read_to_string(path)
+            .map_err(|_| format!("failed to read '{}'", path.display()))?;
+
+        for line in text.lines() {
+            let line = line.trim();
+            if !line.is_empty() && !line.starts_with('#') {
+                files.push(path::PathBuf::from(line));
+            }
+        }
+    }
+
+    if files.is_empty() {
+        return Err(format!("'{}' has no SVG files", path.display()));
+    }
+
+    Ok(files)
+}
+
 fn load_fonts(args: &mut CliArgs) -> usvg::fontdb::Database {
     let mut fontdb = usvg::fontdb::Database::new();
     if !args.skip_system_fonts {
@@ -10,10 +10,31 @@ pub fn mask(
     bbox: Rect,
     canvas: &mut Canvas,
 ) {
-    let mut mask_pixmap = try_opt!(tiny_skia::Pixmap::new(canvas.pixmap.width(), canvas.pixmap.height()));
+    canvas.timed("mask", node, |canvas| mask_impl(node, mask, bbox, canvas))
+}
+
+fn mask_impl(
+    node: &usvg::Node,
+    mask: &usvg::Mask,
+    bbox: Rect,
+    canvas: &mut Canvas,
+) {
+    if mask_rect(node, mask, bbox, canvas) {
+        return;
+    }
+
+    let mut mask_pixmap = match canvas.take_layer(canvas.pixmap.width(), canvas.pixmap.height()) {
+        Some(pixmap) => pixmap,
+        None => {
+            // An element that cannot be masked should not be rendered at all.
+            canvas.pixmap.fill(tiny_skia::Color::TRANSPARENT);
+            return;
+        }
+    };
+    canvas.record_layer("mask", &node.id(), &mask_pixmap);
+
     {
-        let mut mask_canvas = Canvas::from(mask_pixmap.as_mut());
-        mask_canvas.transform = canvas.transform;
+        let mut mask_canvas = canvas.new_layer(mask_pixmap.as_mut(), 0, 0);
 
         let r = if mask.units == usvg::Units::ObjectBoundingBox {
             mask.rect.bbox_transform(bbox)
@@ -44,7 +65,7 @@ pub fn mask(
     }
 
     if let Some(ref id) = mask.mask {
-        if let Some(ref mask_node) = node.tree().defs_by_id(id) {
+        if let Some(ref mask_node) = canvas.tree.defs_by_id(id) {
             if let usvg::NodeKind::Mask(ref mask) = *mask_node.borrow() {
                 self::mask(mask_node, mask, bbox, canvas);
             }
@@ -61,6 +82,137 @@ pub fn mask(
         tiny_skia::Transform::identity(),
         None,
     );
+    canvas.release_layer(mask_pixmap);
+}
+
+/// Masks a canvas by a rectangle filled with a color or a linear gradient
+/// without allocating a layer.
+///
+/// Such a mask is just a clip by the rectangle and the mask region,
+/// followed by multiplication by the fill luminance.
+///
+/// Returns `false` when the mask content is anything else.
+fn mask_rect(
+    node: &usvg::Node,
+    mask: &usvg::Mask,
+    bbox: Rect,
+    canvas: &mut Canvas,
+) -> bool {
+    if mask.mask.is_some() {
+        return false;
+    }
+
+    let child = match node.first_child() {
+        Some(child) if child.next_sibling().is_none() => child,
+        _ => return false,
+    };
+
+    let r = if mask.units == usvg::Units::ObjectBoundingBox {
+        mask.rect.bbox_transform(bbox)
+    } else {
+        mask.rect
+    };
+
+    let region = match crate::path::device_rect(&usvg::PathData::from_rect(r), canvas.transform) {
+        Some(region) => region,
+        None => return false,
+    };
+
+    let mut ts = canvas.transform;
+    if mask.content_units == usvg::Units::ObjectBoundingBox {
+        ts = ts.pre_concat(usvg::Transform::from_bbox(bbox).to_native());
+    }
+    ts = ts.pre_concat(child.transform().to_native());
+
+    let mut paint = tiny_skia::Paint::default();
+    // An invalid gradient masks everything out, like a black fill would.
+    paint.set_color_rgba8(0, 0, 0, 0);
+
+    let (rect, anti_alias) = match *child.borrow() {
+        usvg::NodeKind::Path(ref path) => {
+            if path.visibility != usvg::Visibility::Visible || path.stroke.is_some() {
+                return false;
+            }
+
+            let fill = match path.fill {
+                Some(ref fill) => fill,
+                None => return false,
+            };
+
+            match fill.paint {
+                usvg::Paint::Color(c) => {
+                    let a = usvg::Opacity::new(luminance(c) * fill.opacity.value());
+                    paint.set_color_rgba8(0, 0, 0, a.to_u8());
+                }
+                usvg::Paint::Link(ref id) => {
+                    let lg_node = match canvas.tree.defs_by_id(id) {
+                        Some(node) => node,
+                        None => return false,
+                    };
+
+                    let lg = match *lg_node.borrow() {
+                        usvg::NodeKind::LinearGradient(ref lg) => lg.clone(),
+                        _ => return false,
+                    };
+
+                    // Luminance is interpolated linearly only between opaque colors.
+                    if lg.stops.iter().any(|stop| !stop.opacity.is_default()) {
+                        return false;
+                    }
+
+                    // Store the luminance in the alpha channel.
+                    let mut lg = lg;
+                    for stop in &mut lg.base.stops {
+                        stop.opacity = usvg::Opacity::new(luminance(stop.color));
+                        stop.color = usvg::Color::black();
+                    }
+
+                    // `usvg` guaranties that path without a bbox will not use
+                    // a paint server with ObjectBoundingBox.
+                    let style_bbox = path.data.bbox()
+                        .unwrap_or_else(|| Rect::new(0.0, 0.0, 1.0, 1.0).unwrap());
+                    crate::paint_server::prepare_linear(&lg, fill.opacity, style_bbox, &mut paint);
+                }
+            }
+
+            match crate::path::device_rect(&path.data, ts) {
+                Some(rect) => {
+                    let anti_alias = path.rendering_mode.use_shape_antialiasing()
+                        && !canvas.is_preview();
+                    (rect, anti_alias)
+                }
+                None => return false,
+            }
+        }
+        _ => return false,
+    };
+
+    // A pixmap rect in the content coordinates, so the gradient is positioned correctly.
+    let w = canvas.pixmap.width() as f32;
+    let h = canvas.pixmap.height() as f32;
+    let x1 = (-1.0 - ts.tx) / ts.sx;
+    let x2 = (w + 1.0 - ts.tx) / ts.sx;
+    let y1 = (-1.0 - ts.ty) / ts.sy;
+    let y2 = (h + 1.0 - ts.ty) / ts.sy;
+    let content_rect = match tiny_skia::Rect::from_ltrb(x1.min(x2), y1.min(y2), x1.max(x2), y1.max(y2)) {
+        Some(v) => v,
+        None => return false,
+    };
+
+    crate::clip::clear_outside(rect, anti_alias, canvas);
+    crate::clip::clear_outside(region, true, canvas);
+
+    paint.anti_alias = false;
+    paint.blend_mode = tiny_skia::BlendMode::DestinationIn;
+    let path = tiny_skia::PathBuilder::from_rect(content_rect);
+    canvas.pixmap.fill_path(&path, &paint, tiny_skia::FillRule::Winding, ts, None);
+
+    true
+}
+
+/// Returns a color luminance, the same way `image_to_mask` calculates it.
+fn luminance(c: usvg::Color) -> f64 {
+    (c.red as f64 * 0.2125 + c.green as f64 * 0.7154 + c.blue as f64 * 0.0721) / 255.0
 }
 
 /// Converts an image into an alpha mask.
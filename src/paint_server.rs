@@ -2,10 +2,93 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+use std::cell::{Cell, RefCell};
+use std::rc::Rc;
+
 use crate::render::prelude::*;
 
+
+/// The maximum number of pattern tiles kept during a single render.
+const MAX_CACHED_PATTERNS: usize = 64;
+
+/// Identifies a pattern tile by everything that affects its rendering.
+#[derive(Clone, PartialEq, Debug)]
+struct PatternKey {
+    id: String,
+    rect: (f64, f64, f64, f64),
+    scale: (f64, f64),
+    content_scale: (f64, f64),
+}
+
+/// Pattern tiles rendered during a single render.
+///
+/// Shapes filled with the same pattern at the same scale share a single tile,
+/// so the pattern content is rendered only once.
+///
+/// Cached tiles are counted as layers memory by `Progress`.
+pub struct PatternCache {
+    /// Tiles in the least recently used first order.
+    tiles: RefCell<Vec<(PatternKey, Rc<tiny_skia::Pixmap>, usvg::Transform)>>,
+    /// The memory used by cached tiles.
+    size: Cell<usize>,
+    max_size: usize,
+}
+
+impl PatternCache {
+    /// Creates a cache that keeps up to `max_size` bytes of tiles.
+    pub fn new(max_size: usize) -> Self {
+        PatternCache {
+            tiles: RefCell::new(Vec::new()),
+            size: Cell::new(0),
+            max_size,
+        }
+    }
+
+    fn get(&self, key: &PatternKey) -> Option<(Rc<tiny_skia::Pixmap>, usvg::Transform)> {
+        let mut tiles = self.tiles.borrow_mut();
+        let idx = tiles.iter().position(|(k, _, _)| k == key)?;
+
+        // Mark as recently used.
+        let item = tiles.remove(idx);
+        let tile = (item.1.clone(), item.2);
+        tiles.push(item);
+        Some(tile)
+    }
+
+    /// Caches a tile, which memory was reserved via `Progress::reserve_layers_memory`.
+    ///
+    /// The least recently used tiles are evicted and their memory is released.
+    ///
+    /// Returns `false` when the tile is larger than the whole cache.
+    /// Its memory has to be released by the caller in this case.
+    fn insert(
+        &self,
+        key: PatternKey,
+        pixmap: Rc<tiny_skia::Pixmap>,
+        ts: usvg::Transform,
+        progress: &crate::control::Progress,
+    ) -> bool {
+        let size = pixmap.data().len();
+        if size > self.max_size {
+            return false;
+        }
+
+        let mut tiles = self.tiles.borrow_mut();
+        while !tiles.is_empty()
+            && (tiles.len() == MAX_CACHED_PATTERNS || self.size.get() + size > self.max_size)
+        {
+            let (_, tile, _) = tiles.remove(0);
+            self.size.set(self.size.get() - tile.data().len());
+            progress.release_layers_memory(tile.data().len());
+        }
+
+        self.size.set(self.size.get() + size);
+        tiles.push((key, pixmap, ts));
+        true
+    }
+}
+
 pub fn fill(
-    tree: &usvg::Tree,
     fill: &usvg::Fill,
     bbox: Rect,
     path: &tiny_skia::Path,
@@ -23,7 +106,7 @@ pub fn fill(
             paint.set_color_rgba8(c.red, c.green, c.blue, opacity.to_u8());
         }
         usvg::Paint::Link(ref id) => {
-            if let Some(node) = tree.defs_by_id(id) {
+            if let Some(node) = canvas.tree.defs_by_id(id) {
                 match *node.borrow() {
                     usvg::NodeKind::LinearGradient(ref lg) => {
                         prepare_linear(lg, opacity, bbox, &mut paint);
@@ -34,10 +117,10 @@ pub fn fill(
                     usvg::NodeKind::Pattern(ref pattern) => {
                         let global_ts = usvg::Transform::from_native(canvas.transform);
                         let (patt_pix, patt_ts)
-                            = try_opt!(prepare_pattern_pixmap(&node, pattern, &global_ts, bbox));
+                            = try_opt!(prepare_pattern_pixmap(&node, pattern, &global_ts, bbox, &canvas.tree, canvas.renderer, canvas.progress));
 
                         pattern_pixmap = patt_pix;
-                        paint.shader = prepare_pattern(&pattern_pixmap, patt_ts, opacity);
+                        paint.shader = prepare_pattern(&pattern_pixmap, patt_ts, opacity, canvas.is_preview());
                     }
                     _ => {}
                 }
@@ -58,7 +141,6 @@ pub fn fill(
 }
 
 pub fn stroke(
-    tree: &usvg::Tree,
     stroke: &Option<usvg::Stroke>,
     bbox: Rect,
     path: &tiny_skia::Path,
@@ -78,7 +160,7 @@ pub fn stroke(
                 paint.set_color_rgba8(c.red, c.green, c.blue, opacity.to_u8());
             }
             usvg::Paint::Link(ref id) => {
-                if let Some(node) = tree.defs_by_id(id) {
+                if let Some(node) = canvas.tree.defs_by_id(id) {
                     match *node.borrow() {
                         usvg::NodeKind::LinearGradient(ref lg) => {
                             prepare_linear(lg, opacity, bbox, &mut paint);
@@ -89,10 +171,10 @@ pub fn stroke(
                         usvg::NodeKind::Pattern(ref pattern) => {
                             let global_ts = usvg::Transform::from_native(canvas.transform);
                             let (patt_pix, patt_ts)
-                                = try_opt!(prepare_pattern_pixmap(&node, pattern, &global_ts, bbox));
+                                = try_opt!(prepare_pattern_pixmap(&node, pattern, &global_ts, bbox, &canvas.tree, canvas.renderer, canvas.progress));
 
                             pattern_pixmap = patt_pix;
-                            paint.shader = prepare_pattern(&pattern_pixmap, patt_ts, opacity);
+                            paint.shader = prepare_pattern(&pattern_pixmap, patt_ts, opacity, canvas.is_preview());
                         }
                         _ => {}
                     }
@@ -129,7 +211,7 @@ pub fn stroke(
     canvas.pixmap.stroke_path(path, &paint, &props, canvas.transform, canvas.clip.as_ref());
 }
 
-fn prepare_linear(
+pub fn prepare_linear(
     g: &usvg::LinearGradient,
     opacity: usvg::Opacity,
     bbox: Rect,
@@ -219,7 +301,10 @@ fn prepare_pattern_pixmap(
     pattern: &usvg::Pattern,
     global_ts: &usvg::Transform,
     bbox: Rect,
-) -> Option<(tiny_skia::Pixmap, usvg::Transform)> {
+    tree: &usvg::Tree,
+    renderer: &crate::Renderer,
+    progress: Option<&crate::control::Progress>,
+) -> Option<(Rc<tiny_skia::Pixmap>, usvg::Transform)> {
     let r = if pattern.units == usvg::Units::ObjectBoundingBox {
         pattern.rect.bbox_transform(bbox)
     } else {
@@ -228,9 +313,50 @@ fn prepare_pattern_pixmap(
 
     let (sx, sy) = global_ts.get_scale();
 
+    // The bbox affects the tile content only via `contentUnits`.
+    let content_scale = if pattern.view_box.is_none()
+        && pattern.content_units == usvg::Units::ObjectBoundingBox
+    {
+        (bbox.width(), bbox.height())
+    } else {
+        (1.0, 1.0)
+    };
+
+    let key = PatternKey {
+        id: pattern.id.clone(),
+        rect: (r.x(), r.y(), r.width(), r.height()),
+        scale: (sx as f64, sy as f64),
+        content_scale,
+    };
+
+    if let Some(tile) = progress.and_then(|p| p.patterns().get(&key)) {
+        return Some(tile);
+    }
+
     let img_size = Size::new(r.width() * sx as f64, r.height() * sy as f64)?.to_screen_size();
-    let mut pixmap = tiny_skia::Pixmap::new(img_size.width(), img_size.height())?;
-    let mut canvas = Canvas::from(pixmap.as_mut());
+
+    // A tile is counted as layers memory while it's rendered and cached.
+    let tile_size = img_size.width() as usize * img_size.height() as usize
+        * tiny_skia::BYTES_PER_PIXEL;
+    if let Some(progress) = progress {
+        if !progress.reserve_layers_memory(tile_size) {
+            return None;
+        }
+    }
+
+    let mut pixmap = match tiny_skia::Pixmap::new(img_size.width(), img_size.height()) {
+        Some(v) => v,
+        None => {
+            if let Some(progress) = progress {
+                progress.release_layers_memory(tile_size);
+            }
+
+            return None;
+        }
+    };
+    let mut canvas = Canvas::new(pixmap.as_mut(), tree, renderer);
+    // Allows nested patterns to be cached as well.
+    canvas.progress = progress;
 
     canvas.scale(sx as f32, sy as f32);
     if let Some(vbox) = pattern.view_box {
@@ -251,6 +377,14 @@ fn prepare_pattern_pixmap(
     ts.translate(r.x(), r.y());
     ts.scale(1.0 / sx as f64, 1.0 / sy as f64);
 
+    let pixmap = Rc::new(pixmap);
+    if let Some(progress) = progress {
+        // An uncached tile lives only until the shape is filled.
+        if !progress.patterns().insert(key, pixmap.clone(), ts, progress) {
+            progress.release_layers_memory(tile_size);
+        }
+    }
+
     Some((pixmap, ts))
 }
 
@@ -258,12 +392,66 @@ fn prepare_pattern(
     pixmap: &tiny_skia::Pixmap,
     ts: usvg::Transform,
     opacity: usvg::Opacity,
+    preview: bool,
 ) -> tiny_skia::Shader {
+    let quality = if preview {
+        tiny_skia::FilterQuality::Nearest
+    } else {
+        tiny_skia::FilterQuality::Bicubic
+    };
+
     tiny_skia::Pattern::new(
         pixmap.as_ref(),
         tiny_skia::SpreadMode::Repeat,
-        tiny_skia::FilterQuality::Bicubic,
+        quality,
         opacity.value() as f32,
         ts.to_native(),
     )
 }
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn key(id: &str) -> PatternKey {
+        PatternKey {
+            id: id.to_string(),
+            rect: (0.0, 0.0, 10.0, 10.0),
+            scale: (1.0, 1.0),
+            content_scale: (1.0, 1.0),
+        }
+    }
+
+    fn tile() -> Rc<tiny_skia::Pixmap> {
+        Rc::new(tiny_skia::Pixmap::new(10, 10).unwrap())
+    }
+
+    #[test]
+    fn cache_size_limit() {
+        const TILE_SIZE: usize = 10 * 10 * tiny_skia::BYTES_PER_PIXEL;
+
+        let tree = usvg::Tree::from_str("<svg xmlns='http://www.w3.org/2000/svg'/>",
+                                        &usvg::Options::default()).unwrap();
+        let limits = crate::Limits { max_layers_memory: Some(TILE_SIZE * 3), ..Default::default() };
+        let progress = crate::control::Progress::new(
+            crate::RenderControl::default(), limits, &tree.root(), TILE_SIZE * 2);
+
+        for id in &["a", "b", "c"] {
+            assert!(progress.reserve_layers_memory(TILE_SIZE));
+            assert!(progress.patterns().insert(key(id), tile(), usvg::Transform::default(), &progress));
+        }
+
+        // The least recently used tile was evicted and its memory released.
+        assert!(progress.patterns().get(&key("a")).is_none());
+        assert!(progress.patterns().get(&key("b")).is_some());
+        assert!(progress.patterns().get(&key("c")).is_some());
+        assert!(progress.reserve_layers_memory(TILE_SIZE));
+        assert!(!progress.reserve_layers_memory(TILE_SIZE));
+        assert!(progress.is_limit_reached());
+
+        // A tile larger than the whole cache is not cached.
+        let large = Rc::new(tiny_skia::Pixmap::new(20, 20).unwrap());
+        assert!(!progress.patterns().insert(key("d"), large, usvg::Transform::default(), &progress));
+    }
+}
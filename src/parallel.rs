@@ -0,0 +1,58 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// The minimal number of pixels in a band.
+///
+/// Spawning a thread for a smaller band would cost more than processing it.
+const MIN_BAND_PIXELS: usize = 64 * 64;
+
+/// The minimal number of rows in a band.
+const MIN_BAND_ROWS: usize = 8;
+
+/// Splits an RGBA8 image into horizontal bands.
+///
+/// Returns a band height in rows. The last band can be shorter.
+pub fn band_height(threads: usize, width: u32, height: u32) -> u32 {
+    let (width, height) = (width as usize, height as usize);
+    let bands = threads
+        .min(width * height / MIN_BAND_PIXELS)
+        .min(height / MIN_BAND_ROWS)
+        .max(1);
+
+    ((height + bands - 1) / bands) as u32
+}
+
+/// Processes horizontal bands of an RGBA8 image in parallel.
+///
+/// `f` receives the first row of a band and the band's data.
+///
+/// Bands are processed by the calling thread when there is only one of them.
+pub fn for_each_band<F>(threads: usize, width: u32, data: &mut [u8], f: F)
+    where F: Fn(u32, &mut [u8]) + Sync
+{
+    let row_len = width as usize * 4;
+    if row_len == 0 || data.is_empty() {
+        return;
+    }
+
+    let height = (data.len() / row_len) as u32;
+    let band_height = band_height(threads, width, height);
+    if band_height == height {
+        f(0, data);
+        return;
+    }
+
+    let f = &f;
+    std::thread::scope(|s| {
+        let mut bands = data.chunks_mut(band_height as usize * row_len).enumerate();
+
+        // Keep the first band for the current thread.
+        let (_, first) = bands.next().unwrap();
+        for (i, band) in bands {
+            s.spawn(move || f(i as u32 * band_height, band));
+        }
+
+        f(0, first);
+    });
+}
@@ -2,10 +2,158 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
+use std::sync::{Arc, Mutex};
+
 use crate::render::prelude::*;
 
+
+/// The maximum number of dashed paths kept by a cache.
+const MAX_CACHED_PATHS: usize = 256;
+
+/// Identifies a dashed path by its content.
+///
+/// The hash is used only to speed up lookups.
+/// The actual path data and dashes are always compared.
+#[derive(Clone, Copy)]
+struct DashKey<'a> {
+    hash: u64,
+    data: &'a usvg::PathData,
+    dasharray: &'a [f64],
+    dashoffset: f32,
+}
+
+impl<'a> DashKey<'a> {
+    fn new(data: &'a usvg::PathData, dasharray: &'a [f64], dashoffset: f32) -> Self {
+        let mut hasher = DefaultHasher::new();
+        for seg in data.iter() {
+            match *seg {
+                usvg::PathSegment::MoveTo { x, y } => {
+                    0u8.hash(&mut hasher);
+                    [x, y].iter().for_each(|n| n.to_bits().hash(&mut hasher));
+                }
+                usvg::PathSegment::LineTo { x, y } => {
+                    1u8.hash(&mut hasher);
+                    [x, y].iter().for_each(|n| n.to_bits().hash(&mut hasher));
+                }
+                usvg::PathSegment::CurveTo { x1, y1, x2, y2, x, y } => {
+                    2u8.hash(&mut hasher);
+                    [x1, y1, x2, y2, x, y].iter().for_each(|n| n.to_bits().hash(&mut hasher));
+                }
+                usvg::PathSegment::ClosePath => {
+                    3u8.hash(&mut hasher);
+                }
+            }
+        }
+
+        dasharray.iter().for_each(|n| n.to_bits().hash(&mut hasher));
+        dashoffset.to_bits().hash(&mut hasher);
+
+        DashKey {
+            hash: hasher.finish(),
+            data,
+            dasharray,
+            dashoffset,
+        }
+    }
+
+    fn to_owned(&self) -> OwnedDashKey {
+        OwnedDashKey {
+            hash: self.hash,
+            data: self.data.clone(),
+            dasharray: self.dasharray.to_vec(),
+            dashoffset: self.dashoffset,
+        }
+    }
+}
+
+/// A `DashKey` stored in the cache.
+struct OwnedDashKey {
+    hash: u64,
+    data: usvg::PathData,
+    dasharray: Vec<f64>,
+    dashoffset: f32,
+}
+
+impl OwnedDashKey {
+    /// Checks that the key has exactly the same path and dashes.
+    fn matches(&self, key: &DashKey) -> bool {
+        self.hash == key.hash
+            && self.dashoffset.to_bits() == key.dashoffset.to_bits()
+            && self.dasharray.len() == key.dasharray.len()
+            && self.dasharray.iter().zip(key.dasharray).all(|(a, b)| a.to_bits() == b.to_bits())
+            && self.data.len() == key.data.len()
+            && self.data.iter().zip(key.data.iter()).all(|(a, b)| segment_eq(a, b))
+    }
+}
+
+/// Checks that segments are bitwise equal.
+fn segment_eq(a: &usvg::PathSegment, b: &usvg::PathSegment) -> bool {
+    use usvg::PathSegment::*;
+
+    let eq = |a: &[f64], b: &[f64]| a.iter().zip(b).all(|(a, b)| a.to_bits() == b.to_bits());
+    match (*a, *b) {
+        (MoveTo { x, y }, MoveTo { x: bx, y: by }) |
+        (LineTo { x, y }, LineTo { x: bx, y: by }) => eq(&[x, y], &[bx, by]),
+        (CurveTo { x1, y1, x2, y2, x, y },
+         CurveTo { x1: bx1, y1: by1, x2: bx2, y2: by2, x: bx, y: by }) => {
+            eq(&[x1, y1, x2, y2, x, y], &[bx1, by1, bx2, by2, bx, by])
+        }
+        (ClosePath, ClosePath) => true,
+        _ => false,
+    }
+}
+
+/// A cache of dashed stroke paths.
+///
+/// Dashing is done in user space and depends on the canvas transform
+/// only via the curves flattening precision, so a dashed path can be reused
+/// after translation or by a smaller scale.
+#[derive(Default)]
+pub struct PathCache {
+    /// Paths in the least recently used first order.
+    paths: Mutex<Vec<(OwnedDashKey, f32, Arc<tiny_skia::Path>)>>,
+}
+
+impl PathCache {
+    /// Returns a path dashed with a resolution scale
+    /// no smaller than `res_scale` and no bigger than twice of it.
+    fn get(&self, key: &DashKey, res_scale: f32) -> Option<Arc<tiny_skia::Path>> {
+        let mut paths = self.paths.lock().ok()?;
+        let idx = paths.iter().position(|(k, scale, _)| {
+            *scale >= res_scale && *scale <= res_scale * 2.0 && k.matches(key)
+        })?;
+
+        // Mark as recently used.
+        let item = paths.remove(idx);
+        let path = item.2.clone();
+        paths.push(item);
+        Some(path)
+    }
+
+    fn insert(&self, key: &DashKey, res_scale: f32, path: Arc<tiny_skia::Path>) {
+        if let Ok(mut paths) = self.paths.lock() {
+            // A path dashed with a different scale is no longer needed.
+            paths.retain(|(k, _, _)| !k.matches(key));
+
+            if paths.len() == MAX_CACHED_PATHS {
+                paths.remove(0);
+            }
+
+            paths.push((key.to_owned(), res_scale, path));
+        }
+    }
+
+    /// Deallocates all paths.
+    pub fn clear(&self) {
+        if let Ok(mut paths) = self.paths.lock() {
+            paths.clear();
+        }
+    }
+}
+
 pub fn draw(
-    tree: &usvg::Tree,
     path: &usvg::Path,
     blend_mode: tiny_skia::BlendMode,
     canvas: &mut Canvas,
@@ -22,19 +170,59 @@ pub fn draw(
 
     let skia_path = convert_path(&path.data)?;
 
-    let antialias = path.rendering_mode.use_shape_antialiasing();
+    let antialias = path.rendering_mode.use_shape_antialiasing() && !canvas.is_preview();
 
     if let Some(ref fill) = path.fill {
-        crate::paint_server::fill(tree, fill, style_bbox, &skia_path, antialias, blend_mode, canvas);
+        crate::paint_server::fill(fill, style_bbox, &skia_path, antialias, blend_mode, canvas);
     }
 
     if path.stroke.is_some() {
-        crate::paint_server::stroke(tree, &path.stroke, style_bbox, &skia_path, antialias, blend_mode, canvas);
+        if let Some(dashed_path) = dash_cached(path, &skia_path, canvas) {
+            // The path is already dashed.
+            let mut stroke = path.stroke.clone();
+            if let Some(ref mut stroke) = stroke {
+                stroke.dasharray = None;
+            }
+
+            crate::paint_server::stroke(&stroke, style_bbox, &dashed_path, antialias, blend_mode, canvas);
+        } else {
+            crate::paint_server::stroke(&path.stroke, style_bbox, &skia_path, antialias, blend_mode, canvas);
+        }
     }
 
     bbox
 }
 
+/// Dashes a path using `Renderer::paths`.
+///
+/// Returns `None` when the cache is disabled or the path has no dashes.
+fn dash_cached(
+    path: &usvg::Path,
+    skia_path: &tiny_skia::Path,
+    canvas: &Canvas,
+) -> Option<Arc<tiny_skia::Path>> {
+    if !canvas.renderer.options().path_cache {
+        return None;
+    }
+
+    let stroke = path.stroke.as_ref()?;
+    let list = stroke.dasharray.as_ref()?;
+
+    // The same scale `tiny_skia::Pixmap::stroke_path` would use.
+    let res_scale = tiny_skia::PathStroker::compute_resolution_scale(&canvas.transform);
+
+    let key = DashKey::new(&path.data, list, stroke.dashoffset);
+    if let Some(dashed_path) = canvas.renderer.paths.get(&key, res_scale) {
+        return Some(dashed_path);
+    }
+
+    let list: Vec<_> = list.iter().map(|n| *n as f32).collect();
+    let dash = tiny_skia::StrokeDash::new(list, stroke.dashoffset)?;
+    let dashed_path = Arc::new(skia_path.dash(&dash, res_scale)?);
+    canvas.renderer.paths.insert(&key, res_scale, dashed_path.clone());
+    Some(dashed_path)
+}
+
 fn convert_path(
     path: &usvg::PathData,
 ) -> Option<tiny_skia::Path> {
@@ -58,3 +246,99 @@ fn convert_path(
 
     pb.finish()
 }
+
+/// Returns a pixmap rect covered by a path, when the path is an axis-aligned rectangle
+/// after the `ts` transform.
+///
+/// Allows clip paths and masks to skip layers allocation.
+pub fn device_rect(data: &usvg::PathData, ts: tiny_skia::Transform) -> Option<tiny_skia::Rect> {
+    // Rotation and skew turn a rectangle into a polygon.
+    if !(ts.kx as f64).is_fuzzy_zero() || !(ts.ky as f64).is_fuzzy_zero() {
+        return None;
+    }
+
+    if data.len() < 4 {
+        return None;
+    }
+
+    let mut points = [(0.0, 0.0); 4];
+    for (i, seg) in data.iter().enumerate() {
+        match *seg {
+            usvg::PathSegment::MoveTo { x, y } if i == 0 => points[0] = (x, y),
+            usvg::PathSegment::LineTo { x, y } if i > 0 && i < 4 => points[i] = (x, y),
+            // An explicit closing segment.
+            usvg::PathSegment::LineTo { x, y }
+                if i == 4 && x.fuzzy_eq(&points[0].0) && y.fuzzy_eq(&points[0].1) => {}
+            usvg::PathSegment::ClosePath if i >= 4 => {}
+            _ => return None,
+        }
+    }
+
+    let [p0, p1, p2, p3] = points;
+    let horizontal_first = p0.1.fuzzy_eq(&p1.1) && p1.0.fuzzy_eq(&p2.0)
+        && p2.1.fuzzy_eq(&p3.1) && p3.0.fuzzy_eq(&p0.0);
+    let vertical_first = p0.0.fuzzy_eq(&p1.0) && p1.1.fuzzy_eq(&p2.1)
+        && p2.0.fuzzy_eq(&p3.0) && p3.1.fuzzy_eq(&p0.1);
+    if !horizontal_first && !vertical_first {
+        return None;
+    }
+
+    let x1 = p0.0 as f32 * ts.sx + ts.tx;
+    let y1 = p0.1 as f32 * ts.sy + ts.ty;
+    let x2 = p2.0 as f32 * ts.sx + ts.tx;
+    let y2 = p2.1 as f32 * ts.sy + ts.ty;
+    tiny_skia::Rect::from_ltrb(x1.min(x2), y1.min(y2), x1.max(x2), y1.max(y2))
+}
+
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn path_data(x: f64) -> usvg::PathData {
+        let mut data = usvg::PathData::new();
+        data.push_move_to(0.0, 0.0);
+        data.push_line_to(x, 10.0);
+        data
+    }
+
+    fn dashed_path() -> Arc<tiny_skia::Path> {
+        Arc::new(tiny_skia::PathBuilder::from_rect(tiny_skia::Rect::from_xywh(0.0, 0.0, 1.0, 1.0).unwrap()))
+    }
+
+    #[test]
+    fn hit_and_miss() {
+        let cache = PathCache::default();
+        let data = path_data(10.0);
+        let path = dashed_path();
+        cache.insert(&DashKey::new(&data, &[1.0, 2.0], 0.0), 1.0, path.clone());
+
+        let hit = cache.get(&DashKey::new(&path_data(10.0), &[1.0, 2.0], 0.0), 1.5);
+        assert!(Arc::ptr_eq(&hit.unwrap(), &path));
+
+        // A different scale, path, dash array and offset.
+        assert!(cache.get(&DashKey::new(&data, &[1.0, 2.0], 0.0), 0.4).is_none());
+        assert!(cache.get(&DashKey::new(&path_data(11.0), &[1.0, 2.0], 0.0), 1.0).is_none());
+        assert!(cache.get(&DashKey::new(&data, &[1.0, 3.0], 0.0), 1.0).is_none());
+        assert!(cache.get(&DashKey::new(&data, &[1.0, 2.0], 1.0), 1.0).is_none());
+
+        cache.clear();
+        assert!(cache.get(&DashKey::new(&data, &[1.0, 2.0], 0.0), 1.0).is_none());
+    }
+
+    #[test]
+    fn hash_collision() {
+        let cache = PathCache::default();
+        let data1 = path_data(10.0);
+        let data2 = path_data(20.0);
+
+        let mut key1 = DashKey::new(&data1, &[1.0], 0.0);
+        let mut key2 = DashKey::new(&data2, &[1.0], 0.0);
+        key1.hash = 1;
+        key2.hash = 1;
+
+        cache.insert(&key1, 1.0, dashed_path());
+        assert!(cache.get(&key2, 1.0).is_none());
+        assert!(cache.get(&key1, 1.0).is_some());
+    }
+}
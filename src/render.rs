@@ -14,19 +14,134 @@ pub struct Canvas<'a> {
     pub pixmap: tiny_skia::PixmapMut<'a>,
     pub transform: tiny_skia::Transform,
     pub clip: Option<tiny_skia::ClipMask>,
+    /// A transform of the root element of the currently rendered tree.
+    ///
+    /// Used to render a filter background.
+    pub root_transform: tiny_skia::Transform,
+    /// The whole image rect in the canvas coordinates.
+    ///
+    /// Differs from the pixmap rect on layers and when only a region of the image is rendered.
+    pub image_rect: ScreenRect,
+    /// The renderer that started the current rendering.
+    pub renderer: &'a crate::Renderer,
+    /// The currently rendered tree.
+    ///
+    /// Used to resolve references via the tree's ID index,
+    /// which is not accessible via `NodeExt::tree`.
+    pub tree: usvg::Tree,
+    /// The progress of a controlled render.
+    pub progress: Option<&'a crate::control::Progress<'a>>,
 }
 
-impl<'a> From<tiny_skia::PixmapMut<'a>> for Canvas<'a> {
-    fn from(pixmap: tiny_skia::PixmapMut<'a>) -> Self {
+impl<'a> Canvas<'a> {
+    pub fn new(
+        pixmap: tiny_skia::PixmapMut<'a>,
+        tree: &usvg::Tree,
+        renderer: &'a crate::Renderer,
+    ) -> Self {
+        let image_rect = ScreenRect::new(0, 0, pixmap.width(), pixmap.height()).unwrap();
         Canvas {
             pixmap,
             transform: tiny_skia::Transform::identity(),
             clip: None,
+            root_transform: tiny_skia::Transform::identity(),
+            image_rect,
+            renderer,
+            tree: tree.clone(),
+            progress: None,
+        }
+    }
+
+    /// Creates a canvas for a layer that is located at `x`, `y` on the current canvas.
+    ///
+    /// The layer inherits the current transform.
+    pub fn new_layer<'b>(&self, pixmap: tiny_skia::PixmapMut<'b>, x: i32, y: i32) -> Canvas<'b>
+        where 'a: 'b
+    {
+        let ts = tiny_skia::Transform::from_translate(-x as f32, -y as f32);
+        Canvas {
+            pixmap,
+            transform: ts.pre_concat(self.transform),
+            clip: None,
+            root_transform: ts.pre_concat(self.root_transform),
+            image_rect: self.image_rect.translate(-x, -y),
+            renderer: self.renderer,
+            tree: self.tree.clone(),
+            progress: self.progress,
+        }
+    }
+
+    /// Checks that the current render was canceled.
+    pub fn is_canceled(&self) -> bool {
+        self.progress.map(|p| p.is_canceled()).unwrap_or(false)
+    }
+
+    /// Checks that the current render is a preview.
+    pub fn is_preview(&self) -> bool {
+        self.progress.map(|p| p.is_preview()).unwrap_or(false)
+    }
+
+    /// Returns the statistics collected by the current render.
+    pub fn stats(&self) -> Option<&'a crate::RenderStats> {
+        self.progress.and_then(|p| p.stats())
+    }
+
+    /// Renders an element via `f` and records the time spent, when statistics are collected.
+    pub fn timed<T, F>(&mut self, kind: &'static str, node: &usvg::Node, f: F) -> T
+        where F: FnOnce(&mut Self) -> T
+    {
+        let stats = match self.stats() {
+            Some(stats) => stats,
+            None => return f(self),
+        };
+
+        let start = std::time::Instant::now();
+        let res = f(self);
+        stats.update(kind, &node.id(), |s| {
+            s.count += 1;
+            s.time += start.elapsed();
+        });
+        res
+    }
+
+    /// Records a layer allocated by an element, when statistics are collected.
+    pub fn record_layer(&self, kind: &'static str, id: &str, layer: &tiny_skia::Pixmap) {
+        if let Some(stats) = self.stats() {
+            stats.update(kind, id, |s| {
+                s.layers += 1;
+                s.layers_memory += layer.data().len();
+            });
+        }
+    }
+
+    /// Returns a transparent layer of the specified size.
+    ///
+    /// Returns `None` when the size is zero or the layer exceeds the render limits.
+    pub fn take_layer(&self, width: u32, height: u32) -> Option<tiny_skia::Pixmap> {
+        match self.progress {
+            Some(progress) => progress.take_layer(self.renderer, width, height),
+            None => self.renderer.layers.take(width, height),
+        }
+    }
+
+    /// Like `take_layer`, but the layer can be larger than requested.
+    ///
+    /// Should be used only by layers that are drawn back as is.
+    pub fn take_layer_at_least(&self, width: u32, height: u32) -> Option<tiny_skia::Pixmap> {
+        match self.progress {
+            Some(progress) => progress.take_layer_at_least(self.renderer, width, height),
+            None => self.renderer.layers.take_at_least(width, height),
+        }
+    }
+
+    /// Returns a layer taken via `take_layer` or `take_layer_at_least`.
+    pub fn release_layer(&self, pixmap: tiny_skia::Pixmap) {
+        match self.progress {
+            Some(progress) => progress.release_layer(self.renderer, pixmap),
+            None => self.renderer.layers.release(pixmap),
         }
     }
-}
 
-impl Canvas<'_> {
     pub fn translate(&mut self, tx: f32, ty: f32) {
         self.transform = self.transform.pre_translate(tx, ty);
     }
@@ -105,6 +220,8 @@ pub(crate) fn render_node_to_canvas(
     apply_viewbox_transform(view_box, img_size, canvas);
 
     let curr_ts = canvas.transform;
+    let prev_root_ts = canvas.root_transform;
+    canvas.root_transform = curr_ts;
 
     let mut ts = node.abs_transform();
     ts.append(&node.transform());
@@ -112,6 +229,7 @@ pub(crate) fn render_node_to_canvas(
     canvas.apply_transform(ts.to_native());
     render_node(node, state, canvas);
     canvas.transform = curr_ts;
+    canvas.root_transform = prev_root_ts;
 }
 
 /// Applies viewbox transformation to the painter.
@@ -128,13 +246,29 @@ pub(crate) fn render_node(
     node: &usvg::Node,
     state: &mut RenderState,
     canvas: &mut Canvas,
+) -> Option<Rect> {
+    let kind = match *node.borrow() {
+        usvg::NodeKind::Svg(_) => "svg",
+        usvg::NodeKind::Path(_) => "path",
+        usvg::NodeKind::Image(_) => "image",
+        usvg::NodeKind::Group(_) => "g",
+        _ => return None,
+    };
+
+    canvas.timed(kind, node, |canvas| render_node_impl(node, state, canvas))
+}
+
+fn render_node_impl(
+    node: &usvg::Node,
+    state: &mut RenderState,
+    canvas: &mut Canvas,
 ) -> Option<Rect> {
     match *node.borrow() {
         usvg::NodeKind::Svg(_) => {
             render_group(node, state, canvas)
         }
         usvg::NodeKind::Path(ref path) => {
-            crate::path::draw(&node.tree(), path, tiny_skia::BlendMode::SourceOver, canvas)
+            crate::path::draw(path, tiny_skia::BlendMode::SourceOver, canvas)
         }
         usvg::NodeKind::Image(ref img) => {
             Some(crate::image::draw(img, canvas))
@@ -155,6 +289,10 @@ pub(crate) fn render_group(
     let mut g_bbox = Rect::new_bbox();
 
     for node in parent.children() {
+        if canvas.is_canceled() {
+            break;
+        }
+
         match state {
             RenderState::Ok => {}
             RenderState::RenderUntil(ref last) => {
@@ -170,6 +308,10 @@ pub(crate) fn render_group(
         canvas.apply_transform(node.transform().to_native());
 
         let bbox = render_node(&node, state, canvas);
+        if let Some(progress) = canvas.progress {
+            progress.node_rendered();
+        }
+
         if let Some(bbox) = bbox {
             if let Some(bbox) = bbox.transform(&node.transform()) {
                 g_bbox = g_bbox.expand(bbox);
@@ -188,35 +330,80 @@ pub(crate) fn render_group(
     }
 }
 
+/// Skips a group that will not be rendered.
+///
+/// Its children are counted as rendered, so the progress still reaches the end.
+fn skip_group(node: &usvg::Node, canvas: &Canvas) -> Option<Rect> {
+    if let Some(progress) = canvas.progress {
+        progress.children_skipped(node);
+    }
+
+    calc_object_bbox(node)
+}
+
 fn render_group_impl(
     node: &usvg::Node,
     g: &usvg::Group,
     state: &mut RenderState,
     canvas: &mut Canvas,
 ) -> Option<Rect> {
-    let mut sub_pixmap = tiny_skia::Pixmap::new(canvas.pixmap.width(), canvas.pixmap.height())?;
     let curr_ts = canvas.transform;
 
-    let bbox = {
-        let mut sub_canvas = Canvas::from(sub_pixmap.as_mut());
-        sub_canvas.transform = curr_ts;
-        render_group(node, state, &mut sub_canvas)
+    let canvas_rect = ScreenRect::new(0, 0, canvas.pixmap.width(), canvas.pixmap.height()).unwrap();
+    let layer_rect = if g.filter.is_some() {
+        // A group with a filter is rendered onto a layer that covers the whole filter region,
+        // even the part that is outside the canvas, but inside the image.
+        // Otherwise, filters like blur would produce seams when rendering image regions.
+        Some(filter_layer_rect(node, g, canvas.transform, canvas.image_rect, &canvas.tree).unwrap_or(canvas_rect))
+    } else {
+        // Otherwise, the layer covers only the group content.
+        //
+        // Basically, if viewbox is 2000x2000 and the current group is 20x20, there is no point
+        // in allocating, clipping, masking and blending the whole viewbox,
+        // we can process just the current group region.
+        let ts = usvg::Transform::from_native(canvas.transform);
+        calc_canvas_bbox(node, &ts, canvas.image_rect).and_then(|r| layer_rect_in_canvas(r, canvas_rect))
     };
 
-    // At this point, `sub_pixmap` has probably the same size as the viewbox.
-    // So instead of clipping, masking and blending the whole viewbox, which can be very expensive,
-    // we're trying to reduce `sub_pixmap` to it's actual content trimming
-    // all transparent borders.
-    //
-    // Basically, if viewbox is 2000x2000 and the current group is 20x20, there is no point
-    // in blending the whole viewbox, we can blend just the current group region.
-    //
-    // Transparency trimming is not yet allowed on groups with filter,
-    // because filter expands the pixmap and it should be handled separately.
-    let (tx, ty, mut sub_pixmap) = if g.filter.is_none() {
-        trim_transparency(sub_pixmap)?
+    // If the group content or the filter region is outside the canvas,
+    // there is nothing to render.
+    // Unless we're looking for a specific node during the background rendering.
+    let layer_rect = match layer_rect {
+        Some(r) if r.x() < canvas_rect.width() as i32
+            && r.y() < canvas_rect.height() as i32
+            && r.right() > 0
+            && r.bottom() > 0 => r,
+        _ if *state == RenderState::Ok => return skip_group(node, canvas),
+        Some(r) => r,
+        None => canvas_rect,
+    };
+
+    if g.filter.is_some() {
+        if let Some(progress) = canvas.progress {
+            if !progress.check_filter_area(layer_rect.width(), layer_rect.height()) {
+                return skip_group(node, canvas);
+            }
+        }
+    }
+
+    // A filter region must match the layer exactly.
+    // Otherwise, the layer can be larger, since it will be blended as is.
+    let (lx, ly) = (layer_rect.x(), layer_rect.y());
+    let sub_pixmap = if g.filter.is_some() {
+        canvas.take_layer(layer_rect.width(), layer_rect.height())
     } else {
-        (0, 0, sub_pixmap)
+        canvas.take_layer_at_least(layer_rect.width(), layer_rect.height())
+    };
+
+    let mut sub_pixmap = match sub_pixmap {
+        Some(pixmap) => pixmap,
+        None => return skip_group(node, canvas),
+    };
+    canvas.record_layer("g", &node.id(), &sub_pixmap);
+
+    let bbox = {
+        let mut sub_canvas = canvas.new_layer(sub_pixmap.as_mut(), lx, ly);
+        render_group(node, state, &mut sub_canvas)
     };
 
     // During the background rendering for filters,
@@ -228,23 +415,35 @@ fn render_group_impl(
     // when rendering the children of A[i] into BUF[i].'
     if *state == RenderState::BackgroundFinished {
         let paint = tiny_skia::PixmapPaint::default();
-        canvas.pixmap.draw_pixmap(tx, ty, sub_pixmap.as_ref(), &paint,
+        canvas.pixmap.draw_pixmap(lx, ly, sub_pixmap.as_ref(), &paint,
                                   tiny_skia::Transform::identity(), None);
+        canvas.release_layer(sub_pixmap);
         return bbox;
     }
 
     // Filter can be rendered on an object without a bbox,
     // as long as filter uses `userSpaceOnUse`.
     if let Some(ref id) = g.filter {
-        if let Some(filter_node) = node.tree().defs_by_id(id) {
+        if let Some(filter_node) = canvas.tree.defs_by_id(id) {
             if let usvg::NodeKind::Filter(ref filter) = *filter_node.borrow() {
-                let ts = usvg::Transform::from_native(curr_ts);
-                let background = prepare_filter_background(node, filter, &sub_pixmap);
-                let fill_paint = prepare_filter_fill_paint(node, filter, bbox, ts, &sub_pixmap);
-                let stroke_paint = prepare_filter_stroke_paint(node, filter, bbox, ts, &sub_pixmap);
-                crate::filter::apply(filter, bbox, &ts, &node.tree(),
+                let layer_ts = tiny_skia::Transform::from_translate(-lx as f32, -ly as f32);
+                let ts = usvg::Transform::from_native(layer_ts.pre_concat(curr_ts));
+                let root_ts = layer_ts.pre_concat(canvas.root_transform);
+                // Layer position in the image coordinates.
+                let origin = (lx - canvas.image_rect.x(), ly - canvas.image_rect.y());
+
+                let renderer = canvas.renderer;
+                let tree = &canvas.tree;
+                let background = prepare_filter_background(node, filter, root_ts, tree, renderer, &sub_pixmap);
+                let fill_paint = prepare_filter_fill_paint(node, filter, bbox, ts, tree, renderer, &sub_pixmap);
+                let stroke_paint = prepare_filter_stroke_paint(node, filter, bbox, ts, tree, renderer, &sub_pixmap);
+                crate::filter::apply(filter, bbox, &ts, origin, tree, renderer, canvas.progress,
                                      background.as_ref(), fill_paint.as_ref(), stroke_paint.as_ref(),
                                      &mut sub_pixmap);
+
+                if let Some(background) = background {
+                    renderer.layers.release(background);
+                }
             }
         }
     }
@@ -252,22 +451,18 @@ fn render_group_impl(
     // Clipping and masking can be done only for objects with a valid bbox.
     if let Some(bbox) = bbox {
         if let Some(ref id) = g.clip_path {
-            if let Some(clip_node) = node.tree().defs_by_id(id) {
+            if let Some(clip_node) = canvas.tree.defs_by_id(id) {
                 if let usvg::NodeKind::ClipPath(ref cp) = *clip_node.borrow() {
-                    let mut sub_canvas = Canvas::from(sub_pixmap.as_mut());
-                    sub_canvas.translate(-tx as f32, -ty as f32);
-                    sub_canvas.apply_transform(curr_ts);
+                    let mut sub_canvas = canvas.new_layer(sub_pixmap.as_mut(), lx, ly);
                     crate::clip::clip(&clip_node, cp, bbox, &mut sub_canvas);
                 }
             }
         }
 
         if let Some(ref id) = g.mask {
-            if let Some(mask_node) = node.tree().defs_by_id(id) {
+            if let Some(mask_node) = canvas.tree.defs_by_id(id) {
                 if let usvg::NodeKind::Mask(ref mask) = *mask_node.borrow() {
-                    let mut sub_canvas = Canvas::from(sub_pixmap.as_mut());
-                    sub_canvas.translate(-tx as f32, -ty as f32);
-                    sub_canvas.apply_transform(curr_ts);
+                    let mut sub_canvas = canvas.new_layer(sub_pixmap.as_mut(), lx, ly);
                     crate::mask::mask(&mask_node, mask, bbox, &mut sub_canvas);
                 }
             }
@@ -280,77 +475,327 @@ fn render_group_impl(
         paint.opacity = g.opacity.value() as f32;
     }
 
-    canvas.pixmap.draw_pixmap(tx, ty, sub_pixmap.as_ref(), &paint,
+    canvas.pixmap.draw_pixmap(lx, ly, sub_pixmap.as_ref(), &paint,
                               tiny_skia::Transform::identity(), None);
+    canvas.release_layer(sub_pixmap);
 
     bbox
 }
 
-/// Removes transparent borders from the image leaving only a tight bbox content.
+/// Calculates a layer rect for a group with a filter.
 ///
-/// Detects graphics element bbox on the raster images in absolute coordinates.
+/// The layer is equal to the filter region clipped by the image rect.
+/// Can be partially or even completely outside the canvas.
+fn filter_layer_rect(
+    node: &usvg::Node,
+    g: &usvg::Group,
+    ts: tiny_skia::Transform,
+    image_rect: ScreenRect,
+    tree: &usvg::Tree,
+) -> Option<ScreenRect> {
+    let filter_node = tree.defs_by_id(g.filter.as_ref()?)?;
+    let filter_node = filter_node.borrow();
+    let filter = match *filter_node {
+        usvg::NodeKind::Filter(ref filter) => filter,
+        _ => return None,
+    };
+
+    let bbox = calc_object_bbox(node);
+
+    // Calculate the region in the image coordinates,
+    // so it would be exactly the same as during the whole image rendering.
+    let ts = tiny_skia::Transform::from_translate(-image_rect.x() as f32, -image_rect.y() as f32)
+        .pre_concat(ts);
+    let region = crate::filter::calc_region(
+        filter, bbox, &usvg::Transform::from_native(ts), image_rect.translate_to(0, 0),
+    ).ok()?;
+
+    Some(region.translate(image_rect.x(), image_rect.y()))
+}
+
+/// Calculates a node's object bounding box.
 ///
-/// The current implementation is extremely simple and fairly slow.
-/// Ideally, we should calculate the absolute bbox based on the current transform and bbox.
-/// But because of anti-aliasing, float precision and especially stroking,
-/// this can be fairly complicated and error-prone.
-/// So for now we're using this method.
-fn trim_transparency(pixmap: tiny_skia::Pixmap) -> Option<(i32, i32, tiny_skia::Pixmap)> {
-    let mut x = 0;
-    let mut y = 0;
-    let width = pixmap.width() as i32;
-    let mut min_x = pixmap.width() as i32;
-    let mut min_y = pixmap.height() as i32;
-    let mut max_x = 0;
-    let mut max_y = 0;
-    for pixel in pixmap.pixels() {
-        if pixel.alpha() != 0 {
-            if x < min_x { min_x = x; }
-            if y < min_y { min_y = y; }
-            if x > max_x { max_x = x; }
-            if y > max_y { max_y = y; }
+/// The same bbox will be returned by `render_node`,
+/// but without the actual rendering.
+fn calc_object_bbox(node: &usvg::Node) -> Option<Rect> {
+    match *node.borrow() {
+        usvg::NodeKind::Path(ref path) => path.data.bbox(),
+        usvg::NodeKind::Image(ref img) => Some(img.view_box.rect),
+        usvg::NodeKind::Svg(_) | usvg::NodeKind::Group(_) => {
+            let mut g_bbox = Rect::new_bbox();
+            for child in node.children() {
+                if let Some(bbox) = calc_object_bbox(&child) {
+                    if let Some(bbox) = bbox.transform(&child.transform()) {
+                        g_bbox = g_bbox.expand(bbox);
+                    }
+                }
+            }
+
+            if g_bbox.fuzzy_ne(&Rect::new_bbox()) {
+                Some(g_bbox)
+            } else {
+                None
+            }
         }
+        _ => None,
+    }
+}
 
-        x += 1;
-        if x == width {
-            x = 0;
-            y += 1;
+/// Calculates a conservative bbox of the node's children in canvas coordinates.
+///
+/// Unlike `calc_object_bbox`, takes stroking, filters and anti-aliasing into account,
+/// so nothing will be rendered outside of it.
+///
+/// `ts` is the node's transform in canvas coordinates.
+///
+/// Returns `None` when nothing will be rendered.
+fn calc_canvas_bbox(
+    node: &usvg::Node,
+    ts: &usvg::Transform,
+    image_rect: ScreenRect,
+) -> Option<Rect> {
+    let mut g_bbox = Rect::new_bbox();
+    for child in node.children() {
+        let mut child_ts = *ts;
+        child_ts.append(&child.transform());
+
+        if let Some(bbox) = calc_node_canvas_bbox(&child, &child_ts, image_rect) {
+            g_bbox = g_bbox.expand(bbox);
+        }
+    }
+
+    if g_bbox.fuzzy_ne(&Rect::new_bbox()) {
+        Some(g_bbox)
+    } else {
+        None
+    }
+}
+
+/// Calculates a conservative bbox of the node in canvas coordinates.
+///
+/// `ts` is the node's transform in canvas coordinates, including its own transform.
+pub(crate) fn calc_node_canvas_bbox(
+    node: &usvg::Node,
+    ts: &usvg::Transform,
+    image_rect: ScreenRect,
+) -> Option<Rect> {
+    match *node.borrow() {
+        usvg::NodeKind::Path(ref path) => {
+            calc_path_canvas_bbox(path, ts)
+        }
+        usvg::NodeKind::Image(ref img) => {
+            calc_image_canvas_bbox(img, ts, image_rect)
+        }
+        usvg::NodeKind::Group(ref g) => {
+            let filter_rect = g.filter.as_ref().and_then(|_| {
+                filter_layer_rect(node, g, ts.to_native(), image_rect)
+            });
+
+            match filter_rect {
+                Some(r) => Some(r.to_rect()),
+                None => calc_canvas_bbox(node, ts, image_rect),
+            }
+        }
+        usvg::NodeKind::Svg(_) => {
+            calc_canvas_bbox(node, ts, image_rect)
+        }
+        _ => None,
+    }
+}
+
+fn calc_path_canvas_bbox(path: &usvg::Path, ts: &usvg::Transform) -> Option<Rect> {
+    if path.visibility != usvg::Visibility::Visible {
+        return None;
+    }
+
+    if path.fill.is_none() && path.stroke.is_none() {
+        return None;
+    }
+
+    // Curves are always inside their control points hull,
+    // so there is no need to calculate the exact bbox.
+    let mut x1 = f64::MAX;
+    let mut y1 = f64::MAX;
+    let mut x2 = f64::MIN;
+    let mut y2 = f64::MIN;
+    let mut add_point = |x, y| {
+        let (x, y) = ts.apply(x, y);
+        x1 = x1.min(x);
+        y1 = y1.min(y);
+        x2 = x2.max(x);
+        y2 = y2.max(y);
+    };
+
+    for seg in path.data.iter() {
+        match *seg {
+            usvg::PathSegment::MoveTo { x, y } | usvg::PathSegment::LineTo { x, y } => {
+                add_point(x, y);
+            }
+            usvg::PathSegment::CurveTo { x1, y1, x2, y2, x, y } => {
+                add_point(x1, y1);
+                add_point(x2, y2);
+                add_point(x, y);
+            }
+            usvg::PathSegment::ClosePath => {}
+        }
+    }
+
+    if !(x1 <= x2 && y1 <= y2) {
+        return None;
+    }
+
+    let mut margin = 0.0;
+    if let Some(ref stroke) = path.stroke {
+        // Square caps are extended by a half of the stroke width diagonally
+        // and miter joins by up to a half of the stroke width multiplied by the limit.
+        let mut factor = std::f64::consts::SQRT_2;
+        if stroke.linejoin == usvg::LineJoin::Miter {
+            factor = factor.max(stroke.miterlimit.value());
         }
+
+        margin = stroke.width.value() / 2.0 * factor * max_scale(ts);
     }
 
-    // Expand in all directions by 1px.
-    min_x = (min_x - 1).max(0);
-    min_y = (min_y - 1).max(0);
-    max_x = (max_x + 2).min(pixmap.width() as i32);
-    max_y = (max_y + 2).min(pixmap.height() as i32);
+    expand_canvas_bbox(x1 - margin, y1 - margin, x2 + margin, y2 + margin)
+}
+
+fn calc_image_canvas_bbox(
+    img: &usvg::Image,
+    ts: &usvg::Transform,
+    image_rect: ScreenRect,
+) -> Option<Rect> {
+    if img.visibility != usvg::Visibility::Visible {
+        return None;
+    }
+
+    // A nested SVG image is clipped by its view box only when sliced,
+    // otherwise its content can be anywhere.
+    if let usvg::ImageKind::SVG(_) = img.kind {
+        if !img.view_box.aspect.slice {
+            return Some(image_rect.to_rect());
+        }
+    }
+
+    let r = img.view_box.rect.transform(ts)?;
+    expand_canvas_bbox(r.left(), r.top(), r.right(), r.bottom())
+}
 
-    if min_x < max_x && min_y < max_y {
-        let rect = tiny_skia::IntRect::from_ltrb(min_x, min_y, max_x, max_y)?;
-        let pixmap = pixmap.clone_rect(rect)?;
-        Some((min_x, min_y, pixmap))
+/// Expands a bbox by an anti-aliasing margin.
+fn expand_canvas_bbox(x1: f64, y1: f64, x2: f64, y2: f64) -> Option<Rect> {
+    // Anti-aliasing can affect one extra pixel on each side.
+    const AA_MARGIN: f64 = 1.0;
+    Rect::new(
+        x1 - AA_MARGIN,
+        y1 - AA_MARGIN,
+        x2 - x1 + AA_MARGIN * 2.0,
+        y2 - y1 + AA_MARGIN * 2.0,
+    )
+}
+
+/// Returns the maximum scale factor of the transform in any direction.
+///
+/// The Frobenius norm is always bigger or equal to the largest singular value,
+/// which is good enough for a conservative estimation.
+fn max_scale(ts: &usvg::Transform) -> f64 {
+    (ts.a * ts.a + ts.b * ts.b + ts.c * ts.c + ts.d * ts.d).sqrt()
+}
+
+/// Converts a bbox into a layer rect that is clipped by the canvas.
+///
+/// Returns `None` when the bbox is outside the canvas.
+pub(crate) fn layer_rect_in_canvas(bbox: Rect, canvas_rect: ScreenRect) -> Option<ScreenRect> {
+    let x1 = (bbox.left().floor() as i32).max(canvas_rect.left());
+    let y1 = (bbox.top().floor() as i32).max(canvas_rect.top());
+    let x2 = (bbox.right().ceil() as i32).min(canvas_rect.right());
+    let y2 = (bbox.bottom().ceil() as i32).min(canvas_rect.bottom());
+
+    if x1 < x2 && y1 < y2 {
+        ScreenRect::new(x1, y1, (x2 - x1) as u32, (y2 - y1) as u32)
     } else {
-        Some((0, 0, pixmap))
+        None
+    }
+}
+
+/// Calculates a rect of the image that can be changed by a node modification.
+///
+/// Everything rendered by the node and by the filters of its ancestors is taken into account.
+pub(crate) fn calc_damage_rect(node: &usvg::Node, img_size: ScreenSize) -> Option<ScreenRect> {
+    let tree = node.tree();
+    let image_rect = ScreenRect::new(0, 0, img_size.width(), img_size.height())?;
+    if is_used_indirectly(&tree, node) {
+        return Some(image_rect);
     }
+
+    // A filter can move pixels anywhere inside its region,
+    // so we have to use the topmost filtered ancestor.
+    let target = node.ancestors()
+        .filter(|n| matches!(*n.borrow(), usvg::NodeKind::Group(ref g) if g.filter.is_some()))
+        .last()
+        .unwrap_or_else(|| node.clone());
+
+    let view_box = tree.svg_node().view_box;
+    let mut ts = usvg::utils::view_box_to_transform(
+        view_box.rect, view_box.aspect, img_size.to_size(),
+    );
+    ts.append(&target.abs_transform());
+    ts.append(&target.transform());
+
+    let bbox = calc_node_canvas_bbox(&target, &ts, image_rect)?;
+    layer_rect_in_canvas(bbox, image_rect)
+}
+
+/// Checks that a node can be rendered not only as a part of the tree.
+///
+/// Nodes inside `defs` are used by clip paths, masks and patterns,
+/// `feImage` can reference any node and `BackgroundImage` depends on everything before it.
+fn is_used_indirectly(tree: &usvg::Tree, node: &usvg::Node) -> bool {
+    if tree.is_in_defs(node) {
+        return true;
+    }
+
+    for def in tree.defs().children() {
+        if let usvg::NodeKind::Filter(ref filter) = *def.borrow() {
+            for primitive in &filter.children {
+                if primitive.kind.has_input(&usvg::FilterInput::BackgroundImage) ||
+                   primitive.kind.has_input(&usvg::FilterInput::BackgroundAlpha) {
+                    return true;
+                }
+
+                if let usvg::FilterKind::FeImage(ref fe) = primitive.kind {
+                    if let usvg::FeImageKind::Use(_) = fe.data {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    false
 }
 
 /// Renders an image used by `BackgroundImage` or `BackgroundAlpha` filter inputs.
 fn prepare_filter_background(
     parent: &usvg::Node,
     filter: &usvg::Filter,
+    root_ts: tiny_skia::Transform,
+    tree: &usvg::Tree,
+    renderer: &crate::Renderer,
     pixmap: &tiny_skia::Pixmap,
 ) -> Option<tiny_skia::Pixmap> {
     let start_node = parent.filter_background_start_node(filter)?;
 
-    let img_size = ScreenSize::new(pixmap.width(), pixmap.height()).unwrap();
+    let mut pixmap = renderer.layers.take(pixmap.width(), pixmap.height())?;
+    let mut canvas = Canvas::new(pixmap.as_mut(), tree, renderer);
+    canvas.transform = root_ts;
+    canvas.root_transform = root_ts;
 
-    let tree = parent.tree();
-    let mut pixmap = tiny_skia::Pixmap::new(pixmap.width(), pixmap.height()).unwrap();
-    let mut canvas = Canvas::from(pixmap.as_mut());
-    let view_box = tree.svg_node().view_box;
+    let mut ts = start_node.abs_transform();
+    ts.append(&start_node.transform());
+    canvas.apply_transform(ts.to_native());
 
     // Render from the `start_node` until the `parent`. The `parent` itself is excluded.
     let mut state = RenderState::RenderUntil(parent.clone());
-    crate::render::render_node_to_canvas(&start_node, view_box, img_size, &mut state, &mut canvas);
+    render_node(&start_node, &mut state, &mut canvas);
 
     Some(pixmap)
 }
@@ -367,11 +812,14 @@ fn prepare_filter_fill_paint(
     filter: &usvg::Filter,
     bbox: Option<Rect>,
     ts: usvg::Transform,
+    tree: &usvg::Tree,
+    renderer: &crate::Renderer,
     pixmap: &tiny_skia::Pixmap,
 ) -> Option<tiny_skia::Pixmap> {
-    let region = crate::filter::calc_region(filter, bbox, &ts, pixmap).ok()?;
+    let canvas_rect = ScreenRect::new(0, 0, pixmap.width(), pixmap.height()).unwrap();
+    let region = crate::filter::calc_region(filter, bbox, &ts, canvas_rect).ok()?;
     let mut sub_pixmap = tiny_skia::Pixmap::new(region.width(), region.height()).unwrap();
-    let mut sub_canvas = Canvas::from(sub_pixmap.as_mut());
+    let mut sub_canvas = Canvas::new(sub_pixmap.as_mut(), tree, renderer);
     if let usvg::NodeKind::Group(ref g) = *parent.borrow() {
         if let Some(paint) = g.filter_fill.clone() {
             let style_bbox = bbox.unwrap_or_else(|| Rect::new(0.0, 0.0, 1.0, 1.0).unwrap());
@@ -380,7 +828,7 @@ fn prepare_filter_fill_paint(
             let path = tiny_skia::PathBuilder::from_rect(rect);
 
             let fill = usvg::Fill::from_paint(paint);
-            crate::paint_server::fill(&parent.tree(), &fill, style_bbox, &path, true, tiny_skia::BlendMode::SourceOver, &mut sub_canvas);
+            crate::paint_server::fill(&fill, style_bbox, &path, true, tiny_skia::BlendMode::SourceOver, &mut sub_canvas);
 
         }
     }
@@ -394,11 +842,14 @@ fn prepare_filter_stroke_paint(
     filter: &usvg::Filter,
     bbox: Option<Rect>,
     ts: usvg::Transform,
+    tree: &usvg::Tree,
+    renderer: &crate::Renderer,
     pixmap: &tiny_skia::Pixmap,
 ) -> Option<tiny_skia::Pixmap> {
-    let region = crate::filter::calc_region(filter, bbox, &ts, pixmap).ok()?;
+    let canvas_rect = ScreenRect::new(0, 0, pixmap.width(), pixmap.height()).unwrap();
+    let region = crate::filter::calc_region(filter, bbox, &ts, canvas_rect).ok()?;
     let mut sub_pixmap = tiny_skia::Pixmap::new(region.width(), region.height()).unwrap();
-    let mut sub_canvas = Canvas::from(sub_pixmap.as_mut());
+    let mut sub_canvas = Canvas::new(sub_pixmap.as_mut(), tree, renderer);
     if let usvg::NodeKind::Group(ref g) = *parent.borrow() {
         if let Some(paint) = g.filter_stroke.clone() {
             let style_bbox = bbox.unwrap_or_else(|| Rect::new(0.0, 0.0, 1.0, 1.0).unwrap());
@@ -407,7 +858,7 @@ fn prepare_filter_stroke_paint(
             let path = tiny_skia::PathBuilder::from_rect(rect);
 
             let fill = usvg::Fill::from_paint(paint);
-            crate::paint_server::fill(&parent.tree(), &fill, style_bbox, &path, true, tiny_skia::BlendMode::SourceOver, &mut sub_canvas);
+            crate::paint_server::fill(&fill, style_bbox, &path, true, tiny_skia::BlendMode::SourceOver, &mut sub_canvas);
         }
     }
 
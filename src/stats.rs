@@ -0,0 +1,93 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::cell::RefCell;
+use std::collections::HashMap;
+use std::time::Duration;
+
+/// Rendering statistics of a single element.
+///
+/// Elements with the same kind and ID are merged, so all anonymous paths,
+/// as well as all primitives of the same kind inside a filter, share a single entry.
+#[derive(Clone, Default, Debug)]
+pub struct NodeStats {
+    /// An element kind, like `path`, `g`, `clipPath`, `mask`, `filter` or `feGaussianBlur`.
+    pub kind: &'static str,
+
+    /// An element ID.
+    ///
+    /// Filter primitives use the ID of their filter.
+    /// Can be empty.
+    pub id: String,
+
+    /// How many times the element was rendered.
+    pub count: usize,
+
+    /// Time spent on rendering, including child elements.
+    pub time: Duration,
+
+    /// Time spent on decoding raster images.
+    ///
+    /// Already included in `time`.
+    pub decode_time: Duration,
+
+    /// The number of allocated layers.
+    pub layers: usize,
+
+    /// The memory used by allocated layers, in bytes.
+    pub layers_memory: usize,
+
+    /// The total area of filter regions and primitive subregions, in pixels.
+    pub region_pixels: u64,
+}
+
+/// Per-element rendering statistics.
+///
+/// Collected by `Renderer::render_with_control` when set via `RenderControl::stats`.
+/// Statistics are accumulated across renders until `clear` is called.
+///
+/// Useful for finding elements that are responsible for a slow rendering.
+#[derive(Default, Debug)]
+pub struct RenderStats {
+    kinds: RefCell<HashMap<&'static str, HashMap<String, NodeStats>>>,
+}
+
+impl RenderStats {
+    /// Creates a new, empty statistics.
+    pub fn new() -> Self {
+        RenderStats::default()
+    }
+
+    /// Returns collected statistics, sorted by time, the slowest element first.
+    pub fn nodes(&self) -> Vec<NodeStats> {
+        let mut nodes: Vec<NodeStats> = self.kinds.borrow().values()
+            .flat_map(|ids| ids.values().cloned())
+            .collect();
+        nodes.sort_by(|a, b| b.time.cmp(&a.time).then_with(|| a.id.cmp(&b.id)));
+        nodes
+    }
+
+    /// Removes all collected statistics.
+    pub fn clear(&self) {
+        self.kinds.borrow_mut().clear();
+    }
+
+    /// Updates an element entry.
+    pub(crate) fn update<F: FnOnce(&mut NodeStats)>(&self, kind: &'static str, id: &str, f: F) {
+        let mut kinds = self.kinds.borrow_mut();
+        let ids = kinds.entry(kind).or_insert_with(HashMap::new);
+        if let Some(node) = ids.get_mut(id) {
+            f(node);
+            return;
+        }
+
+        let mut node = NodeStats {
+            kind,
+            id: id.to_string(),
+            ..NodeStats::default()
+        };
+        f(&mut node);
+        ids.insert(id.to_string(), node);
+    }
+}
@@ -2,14 +2,24 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-use crate::{ImageRefMut, NormalizedValue, RGBA8, f64_bound};
+use alloc::vec::Vec;
 
-#[inline]
-fn to_normalized_components(pixel: RGBA8) -> (f64, f64, f64, f64) {
-    (pixel.r as f64 / 255.0,
-     pixel.g as f64 / 255.0,
-     pixel.b as f64 / 255.0,
-     pixel.a as f64 / 255.0)
+use crate::{ImageRefMut, NormalizedValue, f64_bound};
+
+/// Precomputes a normalized component multiplied by a coefficient
+/// for each coefficient and each component value.
+///
+/// This way, a matrix row is just a sum of table lookups,
+/// while the result stays exactly the same as `c as f64 / 255.0 * k`.
+fn product_tables(coeffs: &[f64]) -> Vec<[f64; 256]> {
+    coeffs.iter().map(|k| {
+        let mut table = [0.0; 256];
+        for (i, v) in table.iter_mut().enumerate() {
+            *v = i as f64 / 255.0 * k;
+        }
+
+        table
+    }).collect()
 }
 
 #[inline]
@@ -30,19 +40,32 @@ pub enum ColorMatrix<'a> {
 /// Applies a color matrix filter.
 ///
 /// Input image pixels should have an **unpremultiplied alpha**.
+///
+/// # Allocations
+///
+/// This method will allocate a 2KiB lookup table for each used matrix coefficient,
+/// up to 32KiB in total.
 pub fn color_matrix(
     matrix: ColorMatrix,
     src: ImageRefMut,
 ) {
     match matrix {
         ColorMatrix::Matrix(m) => {
+            let t = product_tables(&[
+                m[0],  m[1],  m[2],  m[3],
+                m[5],  m[6],  m[7],  m[8],
+                m[10], m[11], m[12], m[13],
+                m[15], m[16], m[17], m[18],
+            ]);
+
             for pixel in src.data {
-                let (r, g, b, a) = to_normalized_components(*pixel);
+                let (r, g, b, a) = (pixel.r as usize, pixel.g as usize,
+                                    pixel.b as usize, pixel.a as usize);
 
-                let new_r = r * m[0]  + g * m[1]  + b * m[2]  + a * m[3]  + m[4];
-                let new_g = r * m[5]  + g * m[6]  + b * m[7]  + a * m[8]  + m[9];
-                let new_b = r * m[10] + g * m[11] + b * m[12] + a * m[13] + m[14];
-                let new_a = r * m[15] + g * m[16] + b * m[17] + a * m[18] + m[19];
+                let new_r = t[0][r]  + t[1][g]  + t[2][b]  + t[3][a]  + m[4];
+                let new_g = t[4][r]  + t[5][g]  + t[6][b]  + t[7][a]  + m[9];
+                let new_b = t[8][r]  + t[9][g]  + t[10][b] + t[11][a] + m[14];
+                let new_a = t[12][r] + t[13][g] + t[14][b] + t[15][a] + m[19];
 
                 pixel.r = from_normalized(new_r);
                 pixel.g = from_normalized(new_g);
@@ -58,17 +81,7 @@ pub fn color_matrix(
                 0.213 - 0.213 * v, 0.715 - 0.715 * v, 0.072 + 0.928 * v,
             ];
 
-            for pixel in src.data {
-                let (r, g, b, _) = to_normalized_components(*pixel);
-
-                let new_r = r * m[0] + g * m[1] + b * m[2];
-                let new_g = r * m[3] + g * m[4] + b * m[5];
-                let new_b = r * m[6] + g * m[7] + b * m[8];
-
-                pixel.r = from_normalized(new_r);
-                pixel.g = from_normalized(new_g);
-                pixel.b = from_normalized(new_b);
-            }
+            apply_rgb_matrix(&m, src);
         }
         ColorMatrix::HueRotate(angle) => {
             let angle = angle.to_radians();
@@ -86,23 +99,15 @@ pub fn color_matrix(
                 0.072 + 0.928 * a1 + 0.072 * a2,
             ];
 
-            for pixel in src.data {
-                let (r, g, b, _) = to_normalized_components(*pixel);
-
-                let new_r = r * m[0] + g * m[1] + b * m[2];
-                let new_g = r * m[3] + g * m[4] + b * m[5];
-                let new_b = r * m[6] + g * m[7] + b * m[8];
-
-                pixel.r = from_normalized(new_r);
-                pixel.g = from_normalized(new_g);
-                pixel.b = from_normalized(new_b);
-            }
+            apply_rgb_matrix(&m, src);
         }
         ColorMatrix::LuminanceToAlpha => {
+            let t = product_tables(&[0.2125, 0.7154, 0.0721]);
+
             for pixel in src.data {
-                let (r, g, b, _) = to_normalized_components(*pixel);
+                let (r, g, b) = (pixel.r as usize, pixel.g as usize, pixel.b as usize);
 
-                let new_a = r * 0.2125 + g * 0.7154 + b * 0.0721;
+                let new_a = t[0][r] + t[1][g] + t[2][b];
 
                 pixel.r = 0;
                 pixel.g = 0;
@@ -112,3 +117,22 @@ pub fn color_matrix(
         }
     }
 }
+
+fn apply_rgb_matrix(
+    m: &[f64; 9],
+    src: ImageRefMut,
+) {
+    let t = product_tables(m);
+
+    for pixel in src.data {
+        let (r, g, b) = (pixel.r as usize, pixel.g as usize, pixel.b as usize);
+
+        let new_r = t[0][r] + t[1][g] + t[2][b];
+        let new_g = t[3][r] + t[4][g] + t[5][b];
+        let new_b = t[6][r] + t[7][g] + t[8][b];
+
+        pixel.r = from_normalized(new_r);
+        pixel.g = from_normalized(new_g);
+        pixel.b = from_normalized(new_b);
+    }
+}
@@ -85,6 +85,22 @@ impl<'a> TransferFunction<'a> {
 
         (f64_bound(0.0, c, 1.0) * 255.0) as u8
     }
+
+    /// Precomputes the function for all possible component values.
+    ///
+    /// Returns `None` for functions that do not change the component.
+    fn to_lut(&self) -> Option<[u8; 256]> {
+        if self.is_dummy() {
+            return None;
+        }
+
+        let mut lut = [0u8; 256];
+        for (i, v) in lut.iter_mut().enumerate() {
+            *v = self.apply(i as u8);
+        }
+
+        Some(lut)
+    }
 }
 
 /// Applies component transfer functions for each `src` image channel.
@@ -97,21 +113,28 @@ pub fn component_transfer(
     func_a: TransferFunction,
     src: ImageRefMut,
 ) {
+    // A component can have only 256 values, so instead of evaluating
+    // a function for each pixel, we're evaluating it once per value.
+    let lut_b = func_b.to_lut();
+    let lut_g = func_g.to_lut();
+    let lut_r = func_r.to_lut();
+    let lut_a = func_a.to_lut();
+
     for pixel in src.data {
-        if !func_b.is_dummy() {
-            pixel.b = func_b.apply(pixel.b);
+        if let Some(ref lut) = lut_b {
+            pixel.b = lut[pixel.b as usize];
         }
 
-        if !func_g.is_dummy() {
-            pixel.g = func_g.apply(pixel.g);
+        if let Some(ref lut) = lut_g {
+            pixel.g = lut[pixel.g as usize];
         }
 
-        if !func_r.is_dummy() {
-            pixel.r = func_r.apply(pixel.r);
+        if let Some(ref lut) = lut_r {
+            pixel.r = lut[pixel.r as usize];
         }
 
-        if !func_a.is_dummy() {
-            pixel.a = func_a.apply(pixel.a);
+        if let Some(ref lut) = lut_a {
+            pixel.a = lut[pixel.a as usize];
         }
     }
 }
@@ -24,18 +24,31 @@ pub fn arithmetic_composite(
     assert!(src1.width == src2.width && src1.width == dest.width);
     assert!(src1.height == src2.height && src1.height == dest.height);
 
-    let calc = |i1, i2, max| {
-        let i1 = i1 as f64 / 255.0;
-        let i2 = i2 as f64 / 255.0;
-        let result = k1 * i1 * i2 + k2 * i1 + k3 * i2 + k4;
+    // Precompute coefficients products for each component value,
+    // since there are only 256 of them.
+    // `k1 * i1 * i2` is evaluated as `(k1 * i1) * i2`, so the result is the same.
+    let mut norm = [0.0; 256];
+    let mut k1t = [0.0; 256];
+    let mut k2t = [0.0; 256];
+    let mut k3t = [0.0; 256];
+    for i in 0..256 {
+        let c = i as f64 / 255.0;
+        norm[i] = c;
+        k1t[i] = k1 * c;
+        k2t[i] = k2 * c;
+        k3t[i] = k3 * c;
+    }
+
+    let calc = |i1: u8, i2: u8, max| {
+        let (i1, i2) = (i1 as usize, i2 as usize);
+        let result = k1t[i1] * norm[i2] + k2t[i1] + k3t[i2] + k4;
         f64_bound(0.0, result, max)
     };
 
-    let mut i = 0;
-    for (c1, c2) in src1.data.iter().zip(src2.data.iter()) {
+    let iter = src1.data.iter().zip(src2.data.iter()).zip(dest.data.iter_mut());
+    for ((c1, c2), d) in iter {
         let a = calc(c1.a, c2.a, 1.0);
         if a.is_fuzzy_zero() {
-            i += 1;
             continue;
         }
 
@@ -44,8 +57,6 @@ pub fn arithmetic_composite(
         let b = (calc(c1.b, c2.b, a) * 255.0) as u8;
         let a = (a * 255.0) as u8;
 
-        dest.data[i] = RGBA8 { r, g, b, a };
-
-        i += 1;
+        *d = RGBA8 { r, g, b, a };
     }
 }
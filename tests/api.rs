@@ -0,0 +1,183 @@
+// Tests for the rendering API that are not covered by the reference images.
+
+use usvg::NodeExt;
+
+const IMAGE_SIZE: u32 = 300;
+
+fn load_tree(name: &str) -> usvg::Tree {
+    let mut opt = usvg::Options::default();
+    opt.resources_dir = Some(std::path::PathBuf::from("tests/svg"));
+
+    let svg_data = std::fs::read(format!("tests/svg/{}.svg", name)).unwrap();
+    usvg::Tree::from_data(&svg_data, &opt).unwrap()
+}
+
+fn render(renderer: &resvg::Renderer, tree: &usvg::Tree) -> tiny_skia::Pixmap {
+    let fit_to = usvg::FitTo::Width(IMAGE_SIZE);
+    let size = fit_to.fit_to(tree.svg_node().size.to_screen_size()).unwrap();
+    let mut pixmap = tiny_skia::Pixmap::new(size.width(), size.height()).unwrap();
+    renderer.render(tree, fit_to, pixmap.as_mut()).unwrap();
+    pixmap
+}
+
+/// Returns the number of pixels that differ by more than `tolerance` in any channel.
+fn pixels_diff(a: &[u8], b: &[u8], tolerance: u8) -> usize {
+    assert_eq!(a.len(), b.len());
+    a.chunks_exact(4).zip(b.chunks_exact(4))
+        .filter(|(a, b)| a.iter().zip(b.iter()).any(|(a, b)| (*a as i32 - *b as i32).abs() > tolerance as i32))
+        .count()
+}
+
+#[test]
+fn region_tiles_are_seamless() {
+    const TILE_SIZE: u32 = 64;
+
+    let renderer = resvg::Renderer::default();
+    for name in &["e-feGaussianBlur-001", "e-clipPath-001", "e-mask-001",
+                  "e-pattern-001", "e-linearGradient-001", "e-image-001"] {
+        let tree = load_tree(name);
+        let full = render(&renderer, &tree);
+
+        let mut tiled = tiny_skia::Pixmap::new(full.width(), full.height()).unwrap();
+        let row_len = full.width() as usize * tiny_skia::BYTES_PER_PIXEL;
+        for y in (0..full.height()).step_by(TILE_SIZE as usize) {
+            for x in (0..full.width()).step_by(TILE_SIZE as usize) {
+                let w = TILE_SIZE.min(full.width() - x);
+                let h = TILE_SIZE.min(full.height() - y);
+                let mut tile = tiny_skia::Pixmap::new(w, h).unwrap();
+                renderer.render_region(&tree, usvg::FitTo::Width(IMAGE_SIZE),
+                                       x as i32, y as i32, tile.as_mut()).unwrap();
+
+                let tile_row_len = w as usize * tiny_skia::BYTES_PER_PIXEL;
+                let x_offset = x as usize * tiny_skia::BYTES_PER_PIXEL;
+                for (i, row) in tile.data().chunks_exact(tile_row_len).enumerate() {
+                    let start = (y as usize + i) * row_len + x_offset;
+                    tiled.data_mut()[start..start + tile_row_len].copy_from_slice(row);
+                }
+            }
+        }
+
+        assert_eq!(pixels_diff(full.data(), tiled.data(), 1), 0, "{}", name);
+    }
+}
+
+#[test]
+fn multi_threaded_filters() {
+    let single = resvg::Renderer::default();
+    let multi = resvg::Renderer::new(resvg::Options { threads: 4, ..resvg::Options::default() });
+    for name in &["e-feGaussianBlur-001", "e-feTurbulence-001", "e-feMorphology-001",
+                  "e-feConvolveMatrix-001", "e-feDiffuseLighting-001"] {
+        let tree = load_tree(name);
+        assert!(render(&single, &tree).data() == render(&multi, &tree).data(), "{}", name);
+    }
+}
+
+#[test]
+fn render_node_with_tree() {
+    let tree = load_tree("e-feGaussianBlur-001");
+    let node = tree.node_by_id("rect1").unwrap();
+    let bbox = node.calculate_bbox().unwrap();
+    let fit_to = usvg::FitTo::Original;
+    let size = fit_to.fit_to(bbox.size().to_screen_size()).unwrap();
+
+    let mut expected = tiny_skia::Pixmap::new(size.width(), size.height()).unwrap();
+    resvg::render_node(&node, fit_to, expected.as_mut()).unwrap();
+
+    let mut pixmap = tiny_skia::Pixmap::new(size.width(), size.height()).unwrap();
+    resvg::Renderer::default().render_node(&tree, &node, fit_to, pixmap.as_mut()).unwrap();
+    assert!(pixmap.data() == expected.data());
+}
+
+#[test]
+fn preview() {
+    let renderer = resvg::Renderer::default();
+    let control = resvg::RenderControl { preview: true, ..resvg::RenderControl::default() };
+    for name in &["e-feGaussianBlur-001", "e-feTurbulence-001", "e-pattern-001"] {
+        let tree = load_tree(name);
+        let full = render(&renderer, &tree);
+
+        let mut pixmap = tiny_skia::Pixmap::new(full.width(), full.height()).unwrap();
+        renderer.render_with_control(&tree, usvg::FitTo::Width(IMAGE_SIZE),
+                                     pixmap.as_mut(), control).unwrap();
+        assert!(pixmap.data().iter().any(|c| *c != 0), "{}", name);
+    }
+}
+
+#[test]
+fn target_too_large() {
+    let limits = resvg::Limits { max_pixels: Some(100), ..resvg::Limits::default() };
+    let renderer = resvg::Renderer::new(resvg::Options { limits, ..resvg::Options::default() });
+    let tree = load_tree("e-feGaussianBlur-001");
+    let node = tree.node_by_id("rect1").unwrap();
+
+    let mut pixmap = tiny_skia::Pixmap::new(20, 20).unwrap();
+    let fit_to = usvg::FitTo::Width(IMAGE_SIZE);
+    assert_eq!(renderer.render_with_control(&tree, fit_to, pixmap.as_mut(), Default::default()),
+               Err(resvg::RenderError::TargetTooLarge));
+    assert_eq!(renderer.render_region(&tree, fit_to, 0, 0, pixmap.as_mut()),
+               Err(resvg::RenderError::TargetTooLarge));
+    assert_eq!(renderer.render_node(&tree, &node, fit_to, pixmap.as_mut()),
+               Err(resvg::RenderError::TargetTooLarge));
+    assert!(pixmap.data().iter().all(|c| *c == 0));
+}
+
+#[test]
+fn region_limit_reached() {
+    let limits = resvg::Limits { max_filter_area: Some(100), ..resvg::Limits::default() };
+    let renderer = resvg::Renderer::new(resvg::Options { limits, ..resvg::Options::default() });
+    let tree = load_tree("e-feGaussianBlur-001");
+
+    let mut pixmap = tiny_skia::Pixmap::new(IMAGE_SIZE, IMAGE_SIZE).unwrap();
+    assert_eq!(renderer.render_region(&tree, usvg::FitTo::Width(IMAGE_SIZE), 0, 0, pixmap.as_mut()),
+               Err(resvg::RenderError::LimitReached));
+}
+
+#[test]
+fn group_layers_are_sized_by_bbox() {
+    const SVG: &str = "<svg xmlns='http://www.w3.org/2000/svg' width='1000' height='1000'>\
+                       <g id='g1' opacity='0.5'><rect x='500' y='500' width='10' height='10'/></g>\
+                       <g id='g2' opacity='0.5'><rect x='2000' y='2000' width='10' height='10'/></g>\
+                       </svg>";
+
+    let tree = usvg::Tree::from_str(SVG, &usvg::Options::default()).unwrap();
+    let stats = resvg::RenderStats::new();
+    let control = resvg::RenderControl { stats: Some(&stats), ..resvg::RenderControl::default() };
+    let mut pixmap = tiny_skia::Pixmap::new(1000, 1000).unwrap();
+    resvg::Renderer::default()
+        .render_with_control(&tree, usvg::FitTo::Original, pixmap.as_mut(), control).unwrap();
+
+    let nodes = stats.nodes();
+    let layers_memory = |id: &str| nodes.iter()
+        .filter(|n| n.kind == "g" && n.id == id)
+        .map(|n| n.layers_memory)
+        .sum::<usize>();
+
+    // Much smaller than a full canvas layer.
+    assert!(layers_memory("g1") > 0);
+    assert!(layers_memory("g1") < 100 * 100 * tiny_skia::BYTES_PER_PIXEL);
+    // Outside the canvas, so not rendered at all.
+    assert_eq!(layers_memory("g2"), 0);
+}
+
+#[test]
+fn progress_counts_skipped_groups() {
+    const SVG: &str = "<svg xmlns='http://www.w3.org/2000/svg' width='100' height='100'>\
+                       <rect width='10' height='10'/>\
+                       <g opacity='0.5'>\
+                       <rect x='200' width='10' height='10'/><rect x='220' width='10' height='10'/>\
+                       <rect x='240' width='10' height='10'/><rect x='260' width='10' height='10'/>\
+                       <rect x='280' width='10' height='10'/><rect x='300' width='10' height='10'/>\
+                       </g></svg>";
+
+    let tree = usvg::Tree::from_str(SVG, &usvg::Options::default()).unwrap();
+    let last = std::cell::Cell::new(0.0);
+    let callback = |p: f64| last.set(p);
+    let control = resvg::RenderControl { progress: Some(&callback), ..resvg::RenderControl::default() };
+    let mut pixmap = tiny_skia::Pixmap::new(100, 100).unwrap();
+    resvg::Renderer::default()
+        .render_with_control(&tree, usvg::FitTo::Original, pixmap.as_mut(), control).unwrap();
+
+    // The group is outside the canvas, but its children are still counted.
+    // Only the root node itself is never rendered.
+    assert!(last.get() >= 0.8, "{}", last.get());
+}
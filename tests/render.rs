@@ -6,12 +6,12 @@ const IMAGE_SIZE: u32 = 300;
 static GLOBAL_OPT: Lazy<std::sync::Mutex<usvg::Options>> = Lazy::new(|| {
     let mut opt = usvg::Options::default();
     opt.font_family = "Noto Sans".to_string();
-    opt.fontdb.load_fonts_dir("tests/fonts");
-    opt.fontdb.set_serif_family("Noto Serif");
-    opt.fontdb.set_sans_serif_family("Noto Sans");
-    opt.fontdb.set_cursive_family("Yellowtail");
-    opt.fontdb.set_fantasy_family("Sedgwick Ave Display");
-    opt.fontdb.set_monospace_family("Noto Mono");
+    opt.fontdb_mut().load_fonts_dir("tests/fonts");
+    opt.fontdb_mut().set_serif_family("Noto Serif");
+    opt.fontdb_mut().set_sans_serif_family("Noto Sans");
+    opt.fontdb_mut().set_cursive_family("Yellowtail");
+    opt.fontdb_mut().set_fantasy_family("Sedgwick Ave Display");
+    opt.fontdb_mut().set_monospace_family("Noto Mono");
     opt.resources_dir = Some(std::path::PathBuf::from("tests/svg"));
     std::sync::Mutex::new(opt)
 });
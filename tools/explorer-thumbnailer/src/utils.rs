@@ -26,8 +26,8 @@ pub unsafe fn tree_from_istream(pstream: LPSTREAM) -> Result<usvg::Tree, Error>
         svg_data.set_len(len as usize);
 
         let mut opt = usvg::Options::default();
-        opt.fontdb.load_system_fonts();
-        opt.fontdb.set_generic_families();
+        opt.fontdb_mut().load_system_fonts();
+        opt.fontdb_mut().set_generic_families();
 
         usvg::Tree::from_data(&svg_data, &opt).map_err(|e| Error::TreeError(e))
 }
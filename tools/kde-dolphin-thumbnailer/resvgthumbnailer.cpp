@@ -12,7 +12,7 @@ extern "C"
 
 ResvgThumbnailer::ResvgThumbnailer()
 {
-    m_opt.loadSystemFonts();
+    m_opt.setFontDatabase(ResvgFontDatabase::system());
 }
 
 bool ResvgThumbnailer::create(const QString& path, int width, int heigth, QImage& img)
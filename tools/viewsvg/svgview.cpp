@@ -13,7 +13,8 @@ SvgViewWorker::SvgViewWorker(QObject *parent)
     : QObject(parent)
     , m_dpiRatio(qApp->screens().first()->devicePixelRatio())
 {
-    m_opt.loadSystemFonts();
+    m_opt.setFontDatabase(ResvgFontDatabase::system());
+    m_opt.setPathCache(true);
 }
 
 QRect SvgViewWorker::viewBox() const
@@ -47,7 +48,7 @@ QString SvgViewWorker::loadFile(const QString &path)
     return QString();
 }
 
-void SvgViewWorker::render(const QSize &viewSize)
+void SvgViewWorker::render(const QSize &viewSize, int generation)
 {
     Q_ASSERT(QThread::currentThread() != qApp->thread());
 
@@ -57,11 +58,39 @@ void SvgViewWorker::render(const QSize &viewSize)
         return;
     }
 
+    // The token is reset before checking the generation, so a request that arrives
+    // after the check will cancel this render.
+    m_cancelToken.reset();
+
+    // Skip requests that were superseded while waiting in the queue.
+    if (generation != m_generation.loadAcquire()) {
+        return;
+    }
+
     QElapsedTimer timer;
     timer.start();
 
     const auto s = m_renderer.defaultSize().scaled(viewSize, Qt::KeepAspectRatio);
-    auto img = m_renderer.renderToImage(s * m_dpiRatio);
+
+    // Show a quick preview first, so resizing and zooming stay responsive.
+    auto preview = m_renderer.renderPreviewToImage(s * m_dpiRatio, m_cancelToken);
+    if (preview.isNull()) {
+        qDebug() << QString("Preview canceled after %1ms").arg(timer.elapsed());
+        return;
+    }
+
+    preview.setDevicePixelRatio(m_dpiRatio);
+
+    qDebug() << QString("Preview in %1ms").arg(timer.elapsed());
+
+    emit rendered(preview);
+
+    auto img = m_renderer.renderToImage(s * m_dpiRatio, m_cancelToken);
+    if (img.isNull()) {
+        qDebug() << QString("Render canceled after %1ms").arg(timer.elapsed());
+        return;
+    }
+
     img.setDevicePixelRatio(m_dpiRatio);
 
     qDebug() << QString("Render in %1ms").arg(timer.elapsed());
@@ -69,6 +98,13 @@ void SvgViewWorker::render(const QSize &viewSize)
     emit rendered(img);
 }
 
+int SvgViewWorker::requestRender()
+{
+    const int generation = m_generation.fetchAndAddOrdered(1) + 1;
+    m_cancelToken.cancel();
+    return generation;
+}
+
 static QImage genCheckedTexture()
 {
     int l = 20;
@@ -298,9 +334,12 @@ void SvgView::requestUpdate()
 
     m_timer.start(100, this);
 
+    // The currently rendered size is outdated, there is no point in finishing it.
+    const int generation = m_worker->requestRender();
+
     // Run method in the m_worker thread scope.
     QTimer::singleShot(1, m_worker, [=](){
-        m_worker->render(s);
+        m_worker->render(s, generation);
     });
 }
 
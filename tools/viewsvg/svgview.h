@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QWidget>
+#include <QAtomicInt>
 #include <QMutex>
 #include <QBasicTimer>
 
@@ -18,7 +19,11 @@ public:
 public slots:
     QString loadData(const QByteArray &data);
     QString loadFile(const QString &path);
-    void render(const QSize &viewSize);
+    void render(const QSize &viewSize, int generation);
+
+    // Cancels the current render and returns the generation of the new request.
+    // Can be called from any thread.
+    int requestRender();
 
 signals:
     void rendered(QImage);
@@ -28,6 +33,8 @@ private:
     mutable QMutex m_mutex;
     ResvgOptions m_opt;
     ResvgRenderer m_renderer;
+    ResvgCancelToken m_cancelToken;
+    QAtomicInt m_generation;
 };
 
 class SvgView : public QWidget
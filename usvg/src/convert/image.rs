@@ -61,18 +61,33 @@ pub fn get_href_data(
     opt: &Options,
 ) -> Option<tree::ImageKind> {
     if let Ok(url) = data_url::DataUrl::process(href) {
+        let mime = (url.mime_type().type_.as_str(), url.mime_type().subtype.as_str());
+
+        // Raster images are decoded only when they are actually rendered.
+        // The URL content is still validated, so an invalid one produces no image.
+        if let ("image", "jpg") | ("image", "jpeg") | ("image", "png") = mime {
+            if url.decode(|_| Ok::<(), ()>(())).is_err() {
+                return None;
+            }
+
+            let data = tree::ImageData::from_data_url(std::sync::Arc::from(href));
+            return if mime.1 == "png" {
+                Some(tree::ImageKind::PNG(data))
+            } else {
+                Some(tree::ImageKind::JPEG(data))
+            };
+        }
+
         let (data, _) = url.decode_to_vec().ok()?;
-        match (url.mime_type().type_.as_str(), url.mime_type().subtype.as_str()) {
-            ("image", "jpg") | ("image", "jpeg") => Some(tree::ImageKind::JPEG(data)),
-            ("image", "png") => Some(tree::ImageKind::PNG(data)),
+        match mime {
             ("image", "svg+xml") => load_sub_svg(&data, opt),
             ("text", "plain") => {
                 match get_image_data_format(&data) {
                     Some(ImageFormat::JPEG) => {
-                        Some(tree::ImageKind::JPEG(data))
+                        Some(tree::ImageKind::JPEG(tree::ImageData::new(data)))
                     }
                     Some(ImageFormat::PNG) => {
-                        Some(tree::ImageKind::PNG(data))
+                        Some(tree::ImageKind::PNG(tree::ImageData::new(data)))
                     }
                     _ => {
                         load_sub_svg(&data, opt)
@@ -94,10 +109,10 @@ pub fn get_href_data(
 
             match get_image_file_format(&path, &data) {
                 Some(ImageFormat::JPEG) => {
-                    Some(tree::ImageKind::JPEG(data))
+                    Some(tree::ImageKind::JPEG(tree::ImageData::new(data)))
                 }
                 Some(ImageFormat::PNG) => {
-                    Some(tree::ImageKind::PNG(data))
+                    Some(tree::ImageKind::PNG(tree::ImageData::new(data)))
                 }
                 Some(ImageFormat::SVG) => {
                     load_sub_svg(&data, opt)
@@ -154,6 +169,10 @@ pub fn load_sub_svg(data: &[u8], opt: &Options) -> Option<tree::ImageKind> {
         keep_named_groups: false,
         #[cfg(feature = "text")]
         fontdb: opt.fontdb.clone(),
+        #[cfg(feature = "text")]
+        glyph_cache: opt.glyph_cache.clone(),
+        #[cfg(feature = "text")]
+        shaping_cache: opt.shaping_cache.clone(),
     };
 
     let tree = match tree::Tree::from_data(data, &sub_opt) {
@@ -21,6 +21,7 @@ mod switch;
 mod units;
 mod use_node;
 #[cfg(feature = "text")] mod text;
+#[cfg(feature = "text")] pub use self::text::{GlyphCache, ShapingCache};
 
 mod prelude {
     pub use log::warn;
@@ -139,6 +140,9 @@ pub fn convert_doc(
     ungroup_groups(opt, &mut tree);
     remove_unused_defs(&mut tree);
 
+    // The conversion modifies the tree directly, so the index is built only afterwards.
+    tree.rebuild_id_index();
+
     Ok(tree)
 }
 
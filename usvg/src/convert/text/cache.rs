@@ -0,0 +1,237 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::borrow::Borrow;
+use std::collections::HashMap;
+use std::fmt;
+use std::hash::Hash;
+use std::sync::{Arc, Mutex, Weak};
+
+use ttf_parser::GlyphId;
+
+use crate::tree;
+use super::shaper::Glyph;
+
+/// A glyph outlines cache.
+///
+/// Glyph outlines are extracted from a font during each text conversion by default.
+/// With a cache, an outline is extracted only once and then reused by all conversions
+/// that have the same cache, as long as it fits the memory budget.
+///
+/// Face IDs are valid only within a single fonts database,
+/// so the cache is cleared when it's used with a different one.
+///
+/// Can be shared between threads.
+pub struct GlyphCache {
+    cache: FontCache<u16, tree::PathData>,
+}
+
+impl GlyphCache {
+    /// Creates a new cache that can hold up to `budget` bytes of outlines.
+    pub fn new(budget: usize) -> Self {
+        GlyphCache { cache: FontCache::new(budget) }
+    }
+
+    /// Returns the memory budget in bytes.
+    pub fn budget(&self) -> usize {
+        self.cache.budget
+    }
+
+    /// Returns the amount of memory used by outlines in bytes.
+    pub fn size(&self) -> usize {
+        self.cache.size()
+    }
+
+    /// Removes all outlines from the cache.
+    pub fn clear(&self) {
+        self.cache.clear();
+    }
+
+    pub(crate) fn get(
+        &self,
+        db: &Arc<fontdb::Database>,
+        face: fontdb::ID,
+        glyph: GlyphId,
+    ) -> Option<tree::PathData> {
+        self.cache.get(db, face, &glyph.0)
+    }
+
+    pub(crate) fn insert(
+        &self,
+        db: &Arc<fontdb::Database>,
+        face: fontdb::ID,
+        glyph: GlyphId,
+        outline: tree::PathData,
+    ) {
+        let size = std::mem::size_of::<(u16, tree::PathData)>()
+                 + outline.len() * std::mem::size_of::<tree::PathSegment>();
+        self.cache.insert(db, face, glyph.0, outline, size);
+    }
+}
+
+impl fmt::Debug for GlyphCache {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "GlyphCache({}/{})", self.size(), self.budget())
+    }
+}
+
+
+/// A text shaping cache.
+///
+/// Stores glyphs produced by shaping a text chunk with a specific font.
+/// Useful when the same labels are used by multiple documents.
+///
+/// Shaping is done in font units, so the result doesn't depend on a font size
+/// and is shared by all sizes of the same font.
+///
+/// Face IDs are valid only within a single fonts database,
+/// so the cache is cleared when it's used with a different one.
+///
+/// Can be shared between threads.
+pub struct ShapingCache {
+    cache: FontCache<String, Vec<Glyph>>,
+}
+
+impl ShapingCache {
+    /// Creates a new cache that can hold up to `budget` bytes of shaped text.
+    pub fn new(budget: usize) -> Self {
+        ShapingCache { cache: FontCache::new(budget) }
+    }
+
+    /// Returns the memory budget in bytes.
+    pub fn budget(&self) -> usize {
+        self.cache.budget
+    }
+
+    /// Returns the amount of memory used by shaped text in bytes.
+    pub fn size(&self) -> usize {
+        self.cache.size()
+    }
+
+    /// Removes all shaped text from the cache.
+    pub fn clear(&self) {
+        self.cache.clear();
+    }
+
+    pub(crate) fn get(
+        &self,
+        db: &Arc<fontdb::Database>,
+        face: fontdb::ID,
+        text: &str,
+    ) -> Option<Vec<Glyph>> {
+        self.cache.get(db, face, text)
+    }
+
+    pub(crate) fn insert(
+        &self,
+        db: &Arc<fontdb::Database>,
+        face: fontdb::ID,
+        text: &str,
+        glyphs: Vec<Glyph>,
+    ) {
+        let size = std::mem::size_of::<(String, Vec<Glyph>)>()
+                 + text.len()
+                 + glyphs.len() * std::mem::size_of::<Glyph>();
+        self.cache.insert(db, face, text.to_string(), glyphs, size);
+    }
+}
+
+impl fmt::Debug for ShapingCache {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "ShapingCache({}/{})", self.size(), self.budget())
+    }
+}
+
+
+/// A per-face cache within a memory budget.
+///
+/// Entries are looked up by hash, so there is no cheap way to track their usage order.
+/// Instead, the whole cache is flushed when the budget is exceeded.
+/// Frequently used entries are inserted back right away.
+struct FontCache<K, V> {
+    budget: usize,
+    data: Mutex<FontCacheData<K, V>>,
+}
+
+struct FontCacheData<K, V> {
+    /// The fonts database the cached data belongs to.
+    ///
+    /// A weak reference keeps the allocation alive,
+    /// so its address cannot be reused by another database.
+    database: Weak<fontdb::Database>,
+    faces: Vec<(fontdb::ID, HashMap<K, V>)>,
+    size: usize,
+}
+
+impl<K, V> FontCacheData<K, V> {
+    fn clear(&mut self) {
+        self.faces.clear();
+        self.size = 0;
+    }
+}
+
+impl<K: Hash + Eq, V: Clone> FontCache<K, V> {
+    fn new(budget: usize) -> Self {
+        FontCache {
+            budget,
+            data: Mutex::new(FontCacheData {
+                database: Weak::new(),
+                faces: Vec::new(),
+                size: 0,
+            }),
+        }
+    }
+
+    fn size(&self) -> usize {
+        self.data.lock().map(|d| d.size).unwrap_or(0)
+    }
+
+    fn clear(&self) {
+        if let Ok(mut data) = self.data.lock() {
+            data.clear();
+        }
+    }
+
+    fn get<Q>(&self, db: &Arc<fontdb::Database>, face: fontdb::ID, key: &Q) -> Option<V>
+        where K: Borrow<Q>, Q: Hash + Eq + ?Sized
+    {
+        let data = self.data.lock().ok()?;
+        if data.database.as_ptr() != Arc::as_ptr(db) {
+            return None;
+        }
+
+        let (_, items) = data.faces.iter().find(|(id, _)| *id == face)?;
+        items.get(key).cloned()
+    }
+
+    fn insert(&self, db: &Arc<fontdb::Database>, face: fontdb::ID, key: K, value: V, size: usize) {
+        if size > self.budget {
+            return;
+        }
+
+        if let Ok(mut data) = self.data.lock() {
+            if data.database.as_ptr() != Arc::as_ptr(db) {
+                data.clear();
+                data.database = Arc::downgrade(db);
+            }
+
+            if data.size + size > self.budget {
+                data.clear();
+            }
+
+            let idx = match data.faces.iter().position(|(id, _)| *id == face) {
+                Some(idx) => idx,
+                None => {
+                    data.faces.push((face, HashMap::new()));
+                    data.faces.len() - 1
+                }
+            };
+
+            // The same entry could be inserted by another thread in the meantime.
+            if data.faces[idx].1.insert(key, value).is_none() {
+                data.size += size;
+            }
+        }
+    }
+}
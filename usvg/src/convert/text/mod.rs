@@ -7,6 +7,9 @@ use std::rc::Rc;
 use crate::{svgtree, tree, tree::prelude::*};
 use super::prelude::*;
 
+mod cache;
+pub use self::cache::{GlyphCache, ShapingCache};
+
 mod convert;
 use self::convert::*;
 
@@ -25,7 +25,7 @@ use super::convert::{
 ///
 /// Basically, a glyph ID and it's metrics.
 #[derive(Clone)]
-struct Glyph {
+pub struct Glyph {
     /// The glyph ID in the font.
     id: GlyphId,
 
@@ -195,8 +195,7 @@ pub fn outline_chunk(
     let mut clusters = Vec::new();
     for (range, byte_idx) in GlyphClusters::new(&glyphs) {
         if let Some(span) = chunk.span_at(byte_idx) {
-            let db = &state.opt.fontdb;
-            clusters.push(outline_cluster(&glyphs[range], &chunk.text, span.font_size, db));
+            clusters.push(outline_cluster(&glyphs[range], &chunk.text, span.font_size, state.opt));
         }
     }
 
@@ -277,11 +276,34 @@ fn shape_text(
 
 /// Converts a text into a list of glyph IDs.
 ///
-/// This function will do the BIDI reordering and text shaping.
+/// Uses `Options::shaping_cache` when set.
 fn shape_text_with_font(
     text: &str,
     font: fontdb_ext::Font,
     state: &State,
+) -> Option<Vec<Glyph>> {
+    let cache = match state.opt.shaping_cache {
+        Some(ref cache) => cache,
+        None => return shape_text_with_font_impl(text, font, state),
+    };
+
+    let db = &state.opt.fontdb;
+    if let Some(glyphs) = cache.get(db, font.id, text) {
+        return Some(glyphs);
+    }
+
+    let glyphs = shape_text_with_font_impl(text, font, state)?;
+    cache.insert(db, font.id, text, glyphs.clone());
+    Some(glyphs)
+}
+
+/// Converts a text into a list of glyph IDs.
+///
+/// This function will do the BIDI reordering and text shaping.
+fn shape_text_with_font_impl(
+    text: &str,
+    font: fontdb_ext::Font,
+    state: &State,
 ) -> Option<Vec<Glyph>> {
     state.opt.fontdb.with_face_data(font.id, |font_data, face_index| -> Option<Vec<Glyph>> {
         let rb_font = rustybuzz::Face::from_slice(font_data, face_index)?;
@@ -340,7 +362,7 @@ fn outline_cluster(
     glyphs: &[Glyph],
     text: &str,
     font_size: f64,
-    db: &fontdb::Database,
+    opt: &Options,
 ) -> OutlinedCluster {
     debug_assert!(!glyphs.is_empty());
 
@@ -349,7 +371,7 @@ fn outline_cluster(
     let mut x = 0.0;
 
     for glyph in glyphs {
-        let mut outline = db.outline(glyph.font.id, glyph.id).unwrap_or_default();
+        let mut outline = glyph_outline(glyph, opt);
 
         let sx = glyph.font.scale(font_size);
 
@@ -398,6 +420,25 @@ fn outline_cluster(
     }
 }
 
+/// Returns a glyph outline in font units.
+///
+/// Uses `Options::glyph_cache` when set.
+fn glyph_outline(glyph: &Glyph, opt: &Options) -> tree::PathData {
+    let db = &opt.fontdb;
+    let cache = match opt.glyph_cache {
+        Some(ref cache) => cache,
+        None => return db.outline(glyph.font.id, glyph.id).unwrap_or_default(),
+    };
+
+    if let Some(outline) = cache.get(db, glyph.font.id, glyph.id) {
+        return outline;
+    }
+
+    let outline = db.outline(glyph.font.id, glyph.id).unwrap_or_default();
+    cache.insert(db, glyph.font.id, glyph.id, outline.clone());
+    outline
+}
+
 /// Finds a font with a specified char.
 ///
 /// This is a rudimentary font fallback algorithm.
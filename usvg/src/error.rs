@@ -24,6 +24,9 @@ pub enum Error {
 
     /// Failed to parse an SVG data.
     ParsingFailed(roxmltree::Error),
+
+    /// A binary tree data is malformed or has an unsupported version.
+    InvalidBinary,
 }
 
 impl From<roxmltree::Error> for Error {
@@ -50,6 +53,9 @@ impl std::fmt::Display for Error {
             Error::ParsingFailed(ref e) => {
                 write!(f, "SVG data parsing failed cause {}", e)
             }
+            Error::InvalidBinary => {
+                write!(f, "binary tree data is malformed or has an unsupported version")
+            }
         }
     }
 }
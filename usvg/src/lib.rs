@@ -192,6 +192,7 @@ mod short {
 }
 
 #[cfg(feature = "text")] pub use fontdb;
+#[cfg(feature = "text")] pub use crate::convert::{GlyphCache, ShapingCache};
 
 pub use crate::error::*;
 pub use crate::geom::*;
@@ -338,7 +338,9 @@ fn process(args: Args) -> Result<(), String> {
         text_rendering: args.text_rendering,
         image_rendering: args.image_rendering,
         keep_named_groups: args.keep_named_groups,
-        fontdb,
+        fontdb: std::sync::Arc::new(fontdb),
+        glyph_cache: None,
+        shaping_cache: None,
     };
 
     let input_svg = match in_svg {
@@ -3,6 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 use std::path::PathBuf;
+use std::sync::Arc;
 
 use crate::{ImageRendering, ShapeRendering, TextRendering, Size, ScreenSize};
 
@@ -123,11 +124,33 @@ pub struct Options {
     /// Default: false
     pub keep_named_groups: bool,
 
+    /// A fonts database.
+    ///
     /// When empty, `text` elements will be skipped.
     ///
+    /// Loading system fonts is very IO intensive, so the same database
+    /// can be shared between multiple options. Cloned options share it as well.
+    /// Use `Options::fontdb_mut` to modify it.
+    ///
     /// Default: empty
     #[cfg(feature = "text")]
-    pub fontdb: fontdb::Database,
+    pub fontdb: Arc<fontdb::Database>,
+
+    /// A glyph outlines cache.
+    ///
+    /// Can be shared between multiple options and threads.
+    ///
+    /// Default: None
+    #[cfg(feature = "text")]
+    pub glyph_cache: Option<Arc<crate::GlyphCache>>,
+
+    /// A text shaping cache.
+    ///
+    /// Can be shared between multiple options and threads.
+    ///
+    /// Default: None
+    #[cfg(feature = "text")]
+    pub shaping_cache: Option<Arc<crate::ShapingCache>>,
 }
 
 impl Options {
@@ -140,6 +163,14 @@ impl Options {
             None => rel_path.into(),
         }
     }
+
+    /// Returns a mutable reference to the fonts database.
+    ///
+    /// The database will be copied first when it's shared with other options.
+    #[cfg(feature = "text")]
+    pub fn fontdb_mut(&mut self) -> &mut fontdb::Database {
+        Arc::make_mut(&mut self.fontdb)
+    }
 }
 
 impl Default for Options {
@@ -156,7 +187,11 @@ impl Default for Options {
             image_rendering: ImageRendering::default(),
             keep_named_groups: false,
             #[cfg(feature = "text")]
-            fontdb: fontdb::Database::new(),
+            fontdb: Arc::new(fontdb::Database::new()),
+            #[cfg(feature = "text")]
+            glyph_cache: None,
+            #[cfg(feature = "text")]
+            shaping_cache: None,
         }
     }
 }
@@ -3,6 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 use std::fmt;
+use std::sync::Arc;
 
 pub use svgtypes::{
     Align,
@@ -286,13 +287,72 @@ pub enum ColorChannel {
 #[derive(Clone)]
 pub enum ImageKind {
     /// A raw JPEG data. Should be decoded by the caller.
-    JPEG(Vec<u8>),
+    JPEG(ImageData),
     /// A raw PNG data. Should be decoded by the caller.
-    PNG(Vec<u8>),
+    PNG(ImageData),
     /// A preprocessed SVG tree. Can be rendered as is.
     SVG(crate::Tree),
 }
 
+/// A raw raster image data.
+///
+/// Images embedded via a base64 `data:` URL are decoded only on the first access,
+/// so images that are never rendered are never decoded.
+///
+/// The data is reference counted, so clones, including the ones made by `Tree::deep_copy`,
+/// share both the URL and the decoded buffer, which is decoded only once for all of them.
+#[derive(Clone)]
+pub struct ImageData(Arc<ImageDataInner>);
+
+struct ImageDataInner {
+    /// A `data:` URL, which was already validated during parsing.
+    url: Option<Arc<str>>,
+    data: once_cell::sync::OnceCell<Arc<Vec<u8>>>,
+}
+
+impl ImageData {
+    /// Creates a new image data from raw bytes.
+    pub fn new(data: Vec<u8>) -> Self {
+        let cell = once_cell::sync::OnceCell::new();
+        let _ = cell.set(Arc::new(data));
+        ImageData(Arc::new(ImageDataInner { url: None, data: cell }))
+    }
+
+    /// Creates a new image data from a valid `data:` URL.
+    pub(crate) fn from_data_url(url: Arc<str>) -> Self {
+        ImageData(Arc::new(ImageDataInner {
+            url: Some(url),
+            data: once_cell::sync::OnceCell::new(),
+        }))
+    }
+
+    /// Returns raw image bytes.
+    ///
+    /// Decodes the data on the first call.
+    pub fn data(&self) -> Arc<Vec<u8>> {
+        self.0.data.get_or_init(|| {
+            let data = self.0.url.as_ref()
+                .and_then(|url| data_url::DataUrl::process(url).ok())
+                .and_then(|url| url.decode_to_vec().ok())
+                .map(|(data, _)| data);
+
+            // The URL was validated during parsing, so decoding cannot fail.
+            Arc::new(data.unwrap_or_default())
+        }).clone()
+    }
+
+    /// Checks that the data was already decoded.
+    pub fn is_decoded(&self) -> bool {
+        self.0.data.get().is_some()
+    }
+}
+
+impl fmt::Debug for ImageData {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.write_str("ImageData(..)")
+    }
+}
+
 impl fmt::Debug for ImageKind {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         match self {
@@ -0,0 +1,1293 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+//! A compact binary representation of the `Tree`.
+//!
+//! Unlike SVG, doesn't require any parsing or conversion,
+//! so it can be loaded much faster.
+//!
+//! The data starts with the `USVG` magic and a format version,
+//! followed by the root node. Each node is stored as its kind
+//! and a list of children. All numbers are little-endian.
+
+use std::convert::TryInto;
+use std::rc::Rc;
+
+use crate::geom::*;
+use crate::utils::f64_bound;
+use crate::Error;
+use super::*;
+
+const MAGIC: &[u8; 4] = b"USVG";
+
+/// The format version.
+///
+/// Must be incremented on any `Tree` structure change.
+const VERSION: u32 = 1;
+
+/// The maximum nodes nesting level.
+///
+/// Prevents a stack overflow on malformed data.
+const MAX_DEPTH: u32 = 1024;
+
+
+pub fn write(tree: &Tree) -> Vec<u8> {
+    let mut w = Writer(Vec::new());
+    w.bytes(MAGIC);
+    VERSION.write(&mut w);
+    write_node(&tree.root, &mut w);
+    w.0
+}
+
+pub fn read(data: &[u8]) -> Result<Tree, Error> {
+    let mut r = Reader { data, depth: 0 };
+    if r.bytes(MAGIC.len()) != Some(MAGIC) || u32::read(&mut r) != Some(VERSION) {
+        return Err(Error::InvalidBinary);
+    }
+
+    let tree = read_tree(&mut r).ok_or(Error::InvalidBinary)?;
+    if !r.data.is_empty() {
+        return Err(Error::InvalidBinary);
+    }
+
+    Ok(tree)
+}
+
+fn write_node(node: &Node, w: &mut Writer) {
+    node.borrow().write(w);
+    (node.children().count() as u32).write(w);
+    for child in node.children() {
+        write_node(&child, w);
+    }
+}
+
+fn read_node(r: &mut Reader) -> Option<Node> {
+    r.depth += 1;
+    if r.depth > MAX_DEPTH {
+        return None;
+    }
+
+    let mut node = Node::new(NodeKind::read(r)?);
+    let count = r.len()?;
+    for _ in 0..count {
+        node.append(read_node(r)?);
+    }
+
+    r.depth -= 1;
+    Some(node)
+}
+
+fn read_tree(r: &mut Reader) -> Option<Tree> {
+    let root = read_node(r)?;
+
+    // Other methods rely on the `Svg` root and the `Defs` first child.
+    if !matches!(*root.borrow(), NodeKind::Svg(_)) {
+        return None;
+    }
+
+    let has_defs = root.first_child().map(|n| matches!(*n.borrow(), NodeKind::Defs));
+    if has_defs != Some(true) {
+        return None;
+    }
+
+    Some(Tree::from_root_indexed(root))
+}
+
+
+struct Writer(Vec<u8>);
+
+impl Writer {
+    #[inline]
+    fn u8(&mut self, n: u8) {
+        self.0.push(n);
+    }
+
+    #[inline]
+    fn bytes(&mut self, data: &[u8]) {
+        self.0.extend_from_slice(data);
+    }
+
+    fn data(&mut self, data: &[u8]) {
+        (data.len() as u32).write(self);
+        self.bytes(data);
+    }
+}
+
+struct Reader<'a> {
+    data: &'a [u8],
+    depth: u32,
+}
+
+impl<'a> Reader<'a> {
+    #[inline]
+    fn u8(&mut self) -> Option<u8> {
+        let (n, rest) = self.data.split_first()?;
+        self.data = rest;
+        Some(*n)
+    }
+
+    #[inline]
+    fn bytes(&mut self, len: usize) -> Option<&'a [u8]> {
+        if len > self.data.len() {
+            return None;
+        }
+
+        let (data, rest) = self.data.split_at(len);
+        self.data = rest;
+        Some(data)
+    }
+
+    fn data(&mut self) -> Option<&'a [u8]> {
+        let len = u32::read(self)? as usize;
+        self.bytes(len)
+    }
+
+    /// Reads a number of items.
+    ///
+    /// Each item takes at least one byte, so we can reject
+    /// a malformed length before allocating anything.
+    fn len(&mut self) -> Option<usize> {
+        let len = u32::read(self)? as usize;
+        if len <= self.data.len() { Some(len) } else { None }
+    }
+
+    #[inline]
+    fn f64(&mut self) -> Option<f64> {
+        f64::read(self)
+    }
+}
+
+
+trait Binary: Sized {
+    fn write(&self, w: &mut Writer);
+    fn read(r: &mut Reader) -> Option<Self>;
+}
+
+impl Binary for bool {
+    fn write(&self, w: &mut Writer) {
+        w.u8(*self as u8);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        match r.u8()? {
+            0 => Some(false),
+            1 => Some(true),
+            _ => None,
+        }
+    }
+}
+
+macro_rules! impl_binary_number {
+    ($name:ident) => {
+        impl Binary for $name {
+            fn write(&self, w: &mut Writer) {
+                w.bytes(&self.to_le_bytes());
+            }
+
+            fn read(r: &mut Reader) -> Option<Self> {
+                let data = r.bytes(std::mem::size_of::<$name>())?;
+                Some($name::from_le_bytes(data.try_into().ok()?))
+            }
+        }
+    };
+}
+
+impl_binary_number!(u32);
+impl_binary_number!(i32);
+
+impl Binary for f64 {
+    fn write(&self, w: &mut Writer) {
+        w.bytes(&self.to_le_bytes());
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let n = f64::from_le_bytes(r.bytes(8)?.try_into().ok()?);
+        // The tree never contains NaN or infinity.
+        if n.is_finite() { Some(n) } else { None }
+    }
+}
+
+impl Binary for f32 {
+    fn write(&self, w: &mut Writer) {
+        w.bytes(&self.to_le_bytes());
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let n = f32::from_le_bytes(r.bytes(4)?.try_into().ok()?);
+        if n.is_finite() { Some(n) } else { None }
+    }
+}
+
+impl Binary for String {
+    fn write(&self, w: &mut Writer) {
+        w.data(self.as_bytes());
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        std::str::from_utf8(r.data()?).ok().map(ToString::to_string)
+    }
+}
+
+impl<T: Binary> Binary for Option<T> {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            Some(v) => {
+                w.u8(1);
+                v.write(w);
+            }
+            None => w.u8(0),
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        match r.u8()? {
+            0 => Some(None),
+            1 => Some(Some(T::read(r)?)),
+            _ => None,
+        }
+    }
+}
+
+impl<T: Binary> Binary for Vec<T> {
+    fn write(&self, w: &mut Writer) {
+        (self.len() as u32).write(w);
+        for v in self {
+            v.write(w);
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let len = r.len()?;
+        let mut list = Vec::with_capacity(len);
+        for _ in 0..len {
+            list.push(T::read(r)?);
+        }
+
+        Some(list)
+    }
+}
+
+/// Implements `Binary` for a field-less enum.
+///
+/// Variants are stored as their index in the list, so new ones must be added to the end.
+macro_rules! impl_binary_enum {
+    ($name:ident, $($variant:ident),+) => {
+        impl Binary for $name {
+            fn write(&self, w: &mut Writer) {
+                let list = [$($name::$variant),+];
+                w.u8(list.iter().position(|v| v == self).unwrap() as u8);
+            }
+
+            fn read(r: &mut Reader) -> Option<Self> {
+                let list = [$($name::$variant),+];
+                list.get(r.u8()? as usize).copied()
+            }
+        }
+    };
+}
+
+impl_binary_enum!(Align, None, XMinYMin, XMidYMin, XMaxYMin, XMinYMid, XMidYMid, XMaxYMid,
+                  XMinYMax, XMidYMax, XMaxYMax);
+impl_binary_enum!(LineCap, Butt, Round, Square);
+impl_binary_enum!(LineJoin, Miter, Round, Bevel);
+impl_binary_enum!(FillRule, NonZero, EvenOdd);
+impl_binary_enum!(Units, UserSpaceOnUse, ObjectBoundingBox);
+impl_binary_enum!(SpreadMethod, Pad, Reflect, Repeat);
+impl_binary_enum!(Visibility, Visible, Hidden, Collapse);
+impl_binary_enum!(ColorInterpolation, SRGB, LinearRGB);
+impl_binary_enum!(ColorChannel, R, G, B, A);
+impl_binary_enum!(FeBlendMode, Normal, Multiply, Screen, Darken, Lighten);
+impl_binary_enum!(FeMorphologyOperator, Erode, Dilate);
+impl_binary_enum!(FeEdgeMode, None, Duplicate, Wrap);
+impl_binary_enum!(FeTurbulenceKind, FractalNoise, Turbulence);
+impl_binary_enum!(ShapeRendering, OptimizeSpeed, CrispEdges, GeometricPrecision);
+impl_binary_enum!(ImageRendering, OptimizeQuality, OptimizeSpeed);
+
+impl Binary for NormalizedValue {
+    fn write(&self, w: &mut Writer) {
+        self.value().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(NormalizedValue::new(f64_bound(0.0, r.f64()?, 1.0)))
+    }
+}
+
+impl Binary for PositiveNumber {
+    fn write(&self, w: &mut Writer) {
+        self.value().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(PositiveNumber::new(r.f64()?.max(0.0)))
+    }
+}
+
+impl Binary for StrokeWidth {
+    fn write(&self, w: &mut Writer) {
+        self.value().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let n = r.f64()?;
+        if n > 0.0 { Some(StrokeWidth::new(n)) } else { None }
+    }
+}
+
+impl Binary for StrokeMiterlimit {
+    fn write(&self, w: &mut Writer) {
+        self.value().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(StrokeMiterlimit::new(r.f64()?.max(1.0)))
+    }
+}
+
+impl Binary for NonZeroF64 {
+    fn write(&self, w: &mut Writer) {
+        self.value().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        NonZeroF64::new(r.f64()?)
+    }
+}
+
+impl Binary for Color {
+    fn write(&self, w: &mut Writer) {
+        w.bytes(&[self.red, self.green, self.blue]);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let c = r.bytes(3)?;
+        Some(Color::new(c[0], c[1], c[2]))
+    }
+}
+
+impl Binary for Transform {
+    fn write(&self, w: &mut Writer) {
+        for n in &[self.a, self.b, self.c, self.d, self.e, self.f] {
+            n.write(w);
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(Transform::new(r.f64()?, r.f64()?, r.f64()?, r.f64()?, r.f64()?, r.f64()?))
+    }
+}
+
+impl Binary for Rect {
+    fn write(&self, w: &mut Writer) {
+        for n in &[self.x(), self.y(), self.width(), self.height()] {
+            n.write(w);
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Rect::new(r.f64()?, r.f64()?, r.f64()?, r.f64()?)
+    }
+}
+
+impl Binary for Size {
+    fn write(&self, w: &mut Writer) {
+        self.width().write(w);
+        self.height().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Size::new(r.f64()?, r.f64()?)
+    }
+}
+
+impl<T: Binary> Binary for Point<T> {
+    fn write(&self, w: &mut Writer) {
+        self.x.write(w);
+        self.y.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(Point::new(T::read(r)?, T::read(r)?))
+    }
+}
+
+impl Binary for AspectRatio {
+    fn write(&self, w: &mut Writer) {
+        self.defer.write(w);
+        self.align.write(w);
+        self.slice.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(AspectRatio {
+            defer: bool::read(r)?,
+            align: Align::read(r)?,
+            slice: bool::read(r)?,
+        })
+    }
+}
+
+impl Binary for ViewBox {
+    fn write(&self, w: &mut Writer) {
+        self.rect.write(w);
+        self.aspect.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(ViewBox {
+            rect: Rect::read(r)?,
+            aspect: AspectRatio::read(r)?,
+        })
+    }
+}
+
+impl Binary for Paint {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            Paint::Color(c) => {
+                w.u8(0);
+                c.write(w);
+            }
+            Paint::Link(id) => {
+                w.u8(1);
+                id.write(w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        match r.u8()? {
+            0 => Some(Paint::Color(Color::read(r)?)),
+            1 => Some(Paint::Link(String::read(r)?)),
+            _ => None,
+        }
+    }
+}
+
+impl Binary for Fill {
+    fn write(&self, w: &mut Writer) {
+        self.paint.write(w);
+        self.opacity.write(w);
+        self.rule.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(Fill {
+            paint: Paint::read(r)?,
+            opacity: Opacity::read(r)?,
+            rule: FillRule::read(r)?,
+        })
+    }
+}
+
+impl Binary for Stroke {
+    fn write(&self, w: &mut Writer) {
+        self.paint.write(w);
+        self.dasharray.write(w);
+        self.dashoffset.write(w);
+        self.miterlimit.write(w);
+        self.opacity.write(w);
+        self.width.write(w);
+        self.linecap.write(w);
+        self.linejoin.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(Stroke {
+            paint: Paint::read(r)?,
+            dasharray: Option::read(r)?,
+            dashoffset: f32::read(r)?,
+            miterlimit: StrokeMiterlimit::read(r)?,
+            opacity: Opacity::read(r)?,
+            width: StrokeWidth::read(r)?,
+            linecap: LineCap::read(r)?,
+            linejoin: LineJoin::read(r)?,
+        })
+    }
+}
+
+impl Binary for PathData {
+    fn write(&self, w: &mut Writer) {
+        (self.len() as u32).write(w);
+        for seg in self.iter() {
+            match *seg {
+                PathSegment::MoveTo { x, y } => {
+                    w.u8(0);
+                    x.write(w);
+                    y.write(w);
+                }
+                PathSegment::LineTo { x, y } => {
+                    w.u8(1);
+                    x.write(w);
+                    y.write(w);
+                }
+                PathSegment::CurveTo { x1, y1, x2, y2, x, y } => {
+                    w.u8(2);
+                    for n in &[x1, y1, x2, y2, x, y] {
+                        n.write(w);
+                    }
+                }
+                PathSegment::ClosePath => {
+                    w.u8(3);
+                }
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let len = r.len()?;
+        let mut path = PathData::with_capacity(len);
+        for _ in 0..len {
+            match r.u8()? {
+                0 => path.push_move_to(r.f64()?, r.f64()?),
+                1 => path.push_line_to(r.f64()?, r.f64()?),
+                2 => path.push_curve_to(r.f64()?, r.f64()?, r.f64()?, r.f64()?, r.f64()?, r.f64()?),
+                3 => path.push_close_path(),
+                _ => return None,
+            }
+        }
+
+        Some(path)
+    }
+}
+
+impl Binary for ImageKind {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            ImageKind::JPEG(data) => {
+                w.u8(0);
+                w.data(&data.data());
+            }
+            ImageKind::PNG(data) => {
+                w.u8(1);
+                w.data(&data.data());
+            }
+            ImageKind::SVG(tree) => {
+                w.u8(2);
+                write_node(&tree.root, w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        match r.u8()? {
+            0 => Some(ImageKind::JPEG(ImageData::new(r.data()?.to_vec()))),
+            1 => Some(ImageKind::PNG(ImageData::new(r.data()?.to_vec()))),
+            2 => Some(ImageKind::SVG(read_tree(r)?)),
+            _ => None,
+        }
+    }
+}
+
+impl Binary for EnableBackground {
+    fn write(&self, w: &mut Writer) {
+        self.0.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(EnableBackground(Option::read(r)?))
+    }
+}
+
+impl Binary for BaseGradient {
+    fn write(&self, w: &mut Writer) {
+        self.units.write(w);
+        self.transform.write(w);
+        self.spread_method.write(w);
+        self.stops.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(BaseGradient {
+            units: Units::read(r)?,
+            transform: Transform::read(r)?,
+            spread_method: SpreadMethod::read(r)?,
+            stops: Vec::read(r)?,
+        })
+    }
+}
+
+impl Binary for Stop {
+    fn write(&self, w: &mut Writer) {
+        self.offset.write(w);
+        self.color.write(w);
+        self.opacity.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(Stop {
+            offset: StopOffset::read(r)?,
+            color: Color::read(r)?,
+            opacity: Opacity::read(r)?,
+        })
+    }
+}
+
+impl Binary for NodeKind {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            NodeKind::Svg(ref svg) => {
+                w.u8(0);
+                svg.size.write(w);
+                svg.view_box.write(w);
+            }
+            NodeKind::Defs => {
+                w.u8(1);
+            }
+            NodeKind::LinearGradient(ref lg) => {
+                w.u8(2);
+                lg.id.write(w);
+                for n in &[lg.x1, lg.y1, lg.x2, lg.y2] {
+                    n.write(w);
+                }
+                lg.base.write(w);
+            }
+            NodeKind::RadialGradient(ref rg) => {
+                w.u8(3);
+                rg.id.write(w);
+                rg.cx.write(w);
+                rg.cy.write(w);
+                rg.r.write(w);
+                rg.fx.write(w);
+                rg.fy.write(w);
+                rg.base.write(w);
+            }
+            NodeKind::ClipPath(ref clip) => {
+                w.u8(4);
+                clip.id.write(w);
+                clip.units.write(w);
+                clip.transform.write(w);
+                clip.clip_path.write(w);
+            }
+            NodeKind::Mask(ref mask) => {
+                w.u8(5);
+                mask.id.write(w);
+                mask.units.write(w);
+                mask.content_units.write(w);
+                mask.rect.write(w);
+                mask.mask.write(w);
+            }
+            NodeKind::Pattern(ref pattern) => {
+                w.u8(6);
+                pattern.id.write(w);
+                pattern.units.write(w);
+                pattern.content_units.write(w);
+                pattern.transform.write(w);
+                pattern.rect.write(w);
+                pattern.view_box.write(w);
+            }
+            NodeKind::Filter(ref filter) => {
+                w.u8(7);
+                filter.id.write(w);
+                filter.units.write(w);
+                filter.primitive_units.write(w);
+                filter.rect.write(w);
+                filter.children.write(w);
+            }
+            NodeKind::Path(ref path) => {
+                w.u8(8);
+                path.id.write(w);
+                path.transform.write(w);
+                path.visibility.write(w);
+                path.fill.write(w);
+                path.stroke.write(w);
+                path.rendering_mode.write(w);
+                path.text_bbox.write(w);
+                path.data.write(w);
+            }
+            NodeKind::Image(ref img) => {
+                w.u8(9);
+                img.id.write(w);
+                img.transform.write(w);
+                img.visibility.write(w);
+                img.view_box.write(w);
+                img.rendering_mode.write(w);
+                img.kind.write(w);
+            }
+            NodeKind::Group(ref g) => {
+                w.u8(10);
+                g.id.write(w);
+                g.transform.write(w);
+                g.opacity.write(w);
+                g.clip_path.write(w);
+                g.mask.write(w);
+                g.filter.write(w);
+                g.filter_fill.write(w);
+                g.filter_stroke.write(w);
+                g.enable_background.write(w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let kind = match r.u8()? {
+            0 => NodeKind::Svg(Svg {
+                size: Size::read(r)?,
+                view_box: ViewBox::read(r)?,
+            }),
+            1 => NodeKind::Defs,
+            2 => NodeKind::LinearGradient(LinearGradient {
+                id: String::read(r)?,
+                x1: r.f64()?,
+                y1: r.f64()?,
+                x2: r.f64()?,
+                y2: r.f64()?,
+                base: BaseGradient::read(r)?,
+            }),
+            3 => NodeKind::RadialGradient(RadialGradient {
+                id: String::read(r)?,
+                cx: r.f64()?,
+                cy: r.f64()?,
+                r: PositiveNumber::read(r)?,
+                fx: r.f64()?,
+                fy: r.f64()?,
+                base: BaseGradient::read(r)?,
+            }),
+            4 => NodeKind::ClipPath(ClipPath {
+                id: String::read(r)?,
+                units: Units::read(r)?,
+                transform: Transform::read(r)?,
+                clip_path: Option::read(r)?,
+            }),
+            5 => NodeKind::Mask(Mask {
+                id: String::read(r)?,
+                units: Units::read(r)?,
+                content_units: Units::read(r)?,
+                rect: Rect::read(r)?,
+                mask: Option::read(r)?,
+            }),
+            6 => NodeKind::Pattern(Pattern {
+                id: String::read(r)?,
+                units: Units::read(r)?,
+                content_units: Units::read(r)?,
+                transform: Transform::read(r)?,
+                rect: Rect::read(r)?,
+                view_box: Option::read(r)?,
+            }),
+            7 => NodeKind::Filter(Filter {
+                id: String::read(r)?,
+                units: Units::read(r)?,
+                primitive_units: Units::read(r)?,
+                rect: Rect::read(r)?,
+                children: Vec::read(r)?,
+            }),
+            8 => NodeKind::Path(Path {
+                id: String::read(r)?,
+                transform: Transform::read(r)?,
+                visibility: Visibility::read(r)?,
+                fill: Option::read(r)?,
+                stroke: Option::read(r)?,
+                rendering_mode: ShapeRendering::read(r)?,
+                text_bbox: Option::read(r)?,
+                data: Rc::new(PathData::read(r)?),
+            }),
+            9 => NodeKind::Image(Image {
+                id: String::read(r)?,
+                transform: Transform::read(r)?,
+                visibility: Visibility::read(r)?,
+                view_box: ViewBox::read(r)?,
+                rendering_mode: ImageRendering::read(r)?,
+                kind: ImageKind::read(r)?,
+            }),
+            10 => NodeKind::Group(Group {
+                id: String::read(r)?,
+                transform: Transform::read(r)?,
+                opacity: Opacity::read(r)?,
+                clip_path: Option::read(r)?,
+                mask: Option::read(r)?,
+                filter: Option::read(r)?,
+                filter_fill: Option::read(r)?,
+                filter_stroke: Option::read(r)?,
+                enable_background: Option::read(r)?,
+            }),
+            _ => return None,
+        };
+
+        Some(kind)
+    }
+}
+
+impl Binary for FilterPrimitive {
+    fn write(&self, w: &mut Writer) {
+        self.x.write(w);
+        self.y.write(w);
+        self.width.write(w);
+        self.height.write(w);
+        self.color_interpolation.write(w);
+        self.result.write(w);
+        self.kind.write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        Some(FilterPrimitive {
+            x: Option::read(r)?,
+            y: Option::read(r)?,
+            width: Option::read(r)?,
+            height: Option::read(r)?,
+            color_interpolation: ColorInterpolation::read(r)?,
+            result: String::read(r)?,
+            kind: FilterKind::read(r)?,
+        })
+    }
+}
+
+impl Binary for FilterInput {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            FilterInput::SourceGraphic => w.u8(0),
+            FilterInput::SourceAlpha => w.u8(1),
+            FilterInput::BackgroundImage => w.u8(2),
+            FilterInput::BackgroundAlpha => w.u8(3),
+            FilterInput::FillPaint => w.u8(4),
+            FilterInput::StrokePaint => w.u8(5),
+            FilterInput::Reference(ref id) => {
+                w.u8(6);
+                id.write(w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let input = match r.u8()? {
+            0 => FilterInput::SourceGraphic,
+            1 => FilterInput::SourceAlpha,
+            2 => FilterInput::BackgroundImage,
+            3 => FilterInput::BackgroundAlpha,
+            4 => FilterInput::FillPaint,
+            5 => FilterInput::StrokePaint,
+            6 => FilterInput::Reference(String::read(r)?),
+            _ => return None,
+        };
+
+        Some(input)
+    }
+}
+
+impl Binary for FeCompositeOperator {
+    fn write(&self, w: &mut Writer) {
+        match *self {
+            FeCompositeOperator::Over => w.u8(0),
+            FeCompositeOperator::In => w.u8(1),
+            FeCompositeOperator::Out => w.u8(2),
+            FeCompositeOperator::Atop => w.u8(3),
+            FeCompositeOperator::Xor => w.u8(4),
+            FeCompositeOperator::Arithmetic { k1, k2, k3, k4 } => {
+                w.u8(5);
+                for n in &[k1, k2, k3, k4] {
+                    n.write(w);
+                }
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let op = match r.u8()? {
+            0 => FeCompositeOperator::Over,
+            1 => FeCompositeOperator::In,
+            2 => FeCompositeOperator::Out,
+            3 => FeCompositeOperator::Atop,
+            4 => FeCompositeOperator::Xor,
+            5 => FeCompositeOperator::Arithmetic {
+                k1: r.f64()?,
+                k2: r.f64()?,
+                k3: r.f64()?,
+                k4: r.f64()?,
+            },
+            _ => return None,
+        };
+
+        Some(op)
+    }
+}
+
+impl Binary for FeColorMatrixKind {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            FeColorMatrixKind::Matrix(ref values) => {
+                w.u8(0);
+                values.write(w);
+            }
+            FeColorMatrixKind::Saturate(value) => {
+                w.u8(1);
+                value.write(w);
+            }
+            FeColorMatrixKind::HueRotate(angle) => {
+                w.u8(2);
+                angle.write(w);
+            }
+            FeColorMatrixKind::LuminanceToAlpha => {
+                w.u8(3);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let kind = match r.u8()? {
+            0 => {
+                let values = Vec::read(r)?;
+                if values.len() != 20 {
+                    return None;
+                }
+
+                FeColorMatrixKind::Matrix(values)
+            }
+            1 => FeColorMatrixKind::Saturate(NormalizedValue::read(r)?),
+            2 => FeColorMatrixKind::HueRotate(r.f64()?),
+            3 => FeColorMatrixKind::LuminanceToAlpha,
+            _ => return None,
+        };
+
+        Some(kind)
+    }
+}
+
+impl Binary for TransferFunction {
+    fn write(&self, w: &mut Writer) {
+        match *self {
+            TransferFunction::Identity => {
+                w.u8(0);
+            }
+            TransferFunction::Table(ref values) => {
+                w.u8(1);
+                values.write(w);
+            }
+            TransferFunction::Discrete(ref values) => {
+                w.u8(2);
+                values.write(w);
+            }
+            TransferFunction::Linear { slope, intercept } => {
+                w.u8(3);
+                slope.write(w);
+                intercept.write(w);
+            }
+            TransferFunction::Gamma { amplitude, exponent, offset } => {
+                w.u8(4);
+                amplitude.write(w);
+                exponent.write(w);
+                offset.write(w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let func = match r.u8()? {
+            0 => TransferFunction::Identity,
+            1 => TransferFunction::Table(Vec::read(r)?),
+            2 => TransferFunction::Discrete(Vec::read(r)?),
+            3 => TransferFunction::Linear {
+                slope: r.f64()?,
+                intercept: r.f64()?,
+            },
+            4 => TransferFunction::Gamma {
+                amplitude: r.f64()?,
+                exponent: r.f64()?,
+                offset: r.f64()?,
+            },
+            _ => return None,
+        };
+
+        Some(func)
+    }
+}
+
+impl Binary for ConvolveMatrix {
+    fn write(&self, w: &mut Writer) {
+        self.target_x().write(w);
+        self.target_y().write(w);
+        self.columns().write(w);
+        self.rows().write(w);
+        self.data().to_vec().write(w);
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let target_x = u32::read(r)?;
+        let target_y = u32::read(r)?;
+        let columns = u32::read(r)?;
+        let rows = u32::read(r)?;
+        let data = Vec::read(r)?;
+        if columns.checked_mul(rows)? as usize != data.len() {
+            return None;
+        }
+
+        ConvolveMatrix::new(target_x, target_y, columns, rows, data)
+    }
+}
+
+impl Binary for FeLightSource {
+    fn write(&self, w: &mut Writer) {
+        match *self {
+            FeLightSource::FeDistantLight(ref light) => {
+                w.u8(0);
+                light.azimuth.write(w);
+                light.elevation.write(w);
+            }
+            FeLightSource::FePointLight(ref light) => {
+                w.u8(1);
+                for n in &[light.x, light.y, light.z] {
+                    n.write(w);
+                }
+            }
+            FeLightSource::FeSpotLight(ref light) => {
+                w.u8(2);
+                for n in &[light.x, light.y, light.z,
+                           light.points_at_x, light.points_at_y, light.points_at_z] {
+                    n.write(w);
+                }
+                light.specular_exponent.write(w);
+                light.limiting_cone_angle.write(w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let light = match r.u8()? {
+            0 => FeLightSource::FeDistantLight(FeDistantLight {
+                azimuth: r.f64()?,
+                elevation: r.f64()?,
+            }),
+            1 => FeLightSource::FePointLight(FePointLight {
+                x: r.f64()?,
+                y: r.f64()?,
+                z: r.f64()?,
+            }),
+            2 => FeLightSource::FeSpotLight(FeSpotLight {
+                x: r.f64()?,
+                y: r.f64()?,
+                z: r.f64()?,
+                points_at_x: r.f64()?,
+                points_at_y: r.f64()?,
+                points_at_z: r.f64()?,
+                specular_exponent: PositiveNumber::read(r)?,
+                limiting_cone_angle: Option::read(r)?,
+            }),
+            _ => return None,
+        };
+
+        Some(light)
+    }
+}
+
+impl Binary for FilterKind {
+    fn write(&self, w: &mut Writer) {
+        match self {
+            FilterKind::FeBlend(ref fe) => {
+                w.u8(0);
+                fe.input1.write(w);
+                fe.input2.write(w);
+                fe.mode.write(w);
+            }
+            FilterKind::FeColorMatrix(ref fe) => {
+                w.u8(1);
+                fe.input.write(w);
+                fe.kind.write(w);
+            }
+            FilterKind::FeComponentTransfer(ref fe) => {
+                w.u8(2);
+                fe.input.write(w);
+                fe.func_r.write(w);
+                fe.func_g.write(w);
+                fe.func_b.write(w);
+                fe.func_a.write(w);
+            }
+            FilterKind::FeComposite(ref fe) => {
+                w.u8(3);
+                fe.input1.write(w);
+                fe.input2.write(w);
+                fe.operator.write(w);
+            }
+            FilterKind::FeConvolveMatrix(ref fe) => {
+                w.u8(4);
+                fe.input.write(w);
+                fe.matrix.write(w);
+                fe.divisor.write(w);
+                fe.bias.write(w);
+                fe.edge_mode.write(w);
+                fe.preserve_alpha.write(w);
+            }
+            FilterKind::FeDiffuseLighting(ref fe) => {
+                w.u8(5);
+                fe.input.write(w);
+                fe.surface_scale.write(w);
+                fe.diffuse_constant.write(w);
+                fe.lighting_color.write(w);
+                fe.light_source.write(w);
+            }
+            FilterKind::FeDisplacementMap(ref fe) => {
+                w.u8(6);
+                fe.input1.write(w);
+                fe.input2.write(w);
+                fe.scale.write(w);
+                fe.x_channel_selector.write(w);
+                fe.y_channel_selector.write(w);
+            }
+            FilterKind::FeFlood(ref fe) => {
+                w.u8(7);
+                fe.color.write(w);
+                fe.opacity.write(w);
+            }
+            FilterKind::FeGaussianBlur(ref fe) => {
+                w.u8(8);
+                fe.input.write(w);
+                fe.std_dev_x.write(w);
+                fe.std_dev_y.write(w);
+            }
+            FilterKind::FeImage(ref fe) => {
+                w.u8(9);
+                fe.aspect.write(w);
+                fe.rendering_mode.write(w);
+                match fe.data {
+                    FeImageKind::Image(ref kind) => {
+                        w.u8(0);
+                        kind.write(w);
+                    }
+                    FeImageKind::Use(ref id) => {
+                        w.u8(1);
+                        id.write(w);
+                    }
+                }
+            }
+            FilterKind::FeMerge(ref fe) => {
+                w.u8(10);
+                fe.inputs.write(w);
+            }
+            FilterKind::FeMorphology(ref fe) => {
+                w.u8(11);
+                fe.input.write(w);
+                fe.operator.write(w);
+                fe.radius_x.write(w);
+                fe.radius_y.write(w);
+            }
+            FilterKind::FeOffset(ref fe) => {
+                w.u8(12);
+                fe.input.write(w);
+                fe.dx.write(w);
+                fe.dy.write(w);
+            }
+            FilterKind::FeSpecularLighting(ref fe) => {
+                w.u8(13);
+                fe.input.write(w);
+                fe.surface_scale.write(w);
+                fe.specular_constant.write(w);
+                fe.specular_exponent.write(w);
+                fe.lighting_color.write(w);
+                fe.light_source.write(w);
+            }
+            FilterKind::FeTile(ref fe) => {
+                w.u8(14);
+                fe.input.write(w);
+            }
+            FilterKind::FeTurbulence(ref fe) => {
+                w.u8(15);
+                fe.base_frequency.write(w);
+                fe.num_octaves.write(w);
+                fe.seed.write(w);
+                fe.stitch_tiles.write(w);
+                fe.kind.write(w);
+            }
+        }
+    }
+
+    fn read(r: &mut Reader) -> Option<Self> {
+        let kind = match r.u8()? {
+            0 => FilterKind::FeBlend(FeBlend {
+                input1: FilterInput::read(r)?,
+                input2: FilterInput::read(r)?,
+                mode: FeBlendMode::read(r)?,
+            }),
+            1 => FilterKind::FeColorMatrix(FeColorMatrix {
+                input: FilterInput::read(r)?,
+                kind: FeColorMatrixKind::read(r)?,
+            }),
+            2 => FilterKind::FeComponentTransfer(FeComponentTransfer {
+                input: FilterInput::read(r)?,
+                func_r: TransferFunction::read(r)?,
+                func_g: TransferFunction::read(r)?,
+                func_b: TransferFunction::read(r)?,
+                func_a: TransferFunction::read(r)?,
+            }),
+            3 => FilterKind::FeComposite(FeComposite {
+                input1: FilterInput::read(r)?,
+                input2: FilterInput::read(r)?,
+                operator: FeCompositeOperator::read(r)?,
+            }),
+            4 => FilterKind::FeConvolveMatrix(FeConvolveMatrix {
+                input: FilterInput::read(r)?,
+                matrix: ConvolveMatrix::read(r)?,
+                divisor: NonZeroF64::read(r)?,
+                bias: r.f64()?,
+                edge_mode: FeEdgeMode::read(r)?,
+                preserve_alpha: bool::read(r)?,
+            }),
+            5 => FilterKind::FeDiffuseLighting(FeDiffuseLighting {
+                input: FilterInput::read(r)?,
+                surface_scale: r.f64()?,
+                diffuse_constant: r.f64()?,
+                lighting_color: Color::read(r)?,
+                light_source: FeLightSource::read(r)?,
+            }),
+            6 => FilterKind::FeDisplacementMap(FeDisplacementMap {
+                input1: FilterInput::read(r)?,
+                input2: FilterInput::read(r)?,
+                scale: r.f64()?,
+                x_channel_selector: ColorChannel::read(r)?,
+                y_channel_selector: ColorChannel::read(r)?,
+            }),
+            7 => FilterKind::FeFlood(FeFlood {
+                color: Color::read(r)?,
+                opacity: Opacity::read(r)?,
+            }),
+            8 => FilterKind::FeGaussianBlur(FeGaussianBlur {
+                input: FilterInput::read(r)?,
+                std_dev_x: PositiveNumber::read(r)?,
+                std_dev_y: PositiveNumber::read(r)?,
+            }),
+            9 => {
+                let aspect = AspectRatio::read(r)?;
+                let rendering_mode = ImageRendering::read(r)?;
+                let data = match r.u8()? {
+                    0 => FeImageKind::Image(ImageKind::read(r)?),
+                    1 => FeImageKind::Use(String::read(r)?),
+                    _ => return None,
+                };
+
+                FilterKind::FeImage(FeImage { aspect, rendering_mode, data })
+            }
+            10 => FilterKind::FeMerge(FeMerge {
+                inputs: Vec::read(r)?,
+            }),
+            11 => FilterKind::FeMorphology(FeMorphology {
+                input: FilterInput::read(r)?,
+                operator: FeMorphologyOperator::read(r)?,
+                radius_x: PositiveNumber::read(r)?,
+                radius_y: PositiveNumber::read(r)?,
+            }),
+            12 => FilterKind::FeOffset(FeOffset {
+                input: FilterInput::read(r)?,
+                dx: r.f64()?,
+                dy: r.f64()?,
+            }),
+            13 => FilterKind::FeSpecularLighting(FeSpecularLighting {
+                input: FilterInput::read(r)?,
+                surface_scale: r.f64()?,
+                specular_constant: r.f64()?,
+                specular_exponent: r.f64()?,
+                lighting_color: Color::read(r)?,
+                light_source: FeLightSource::read(r)?,
+            }),
+            14 => FilterKind::FeTile(FeTile {
+                input: FilterInput::read(r)?,
+            }),
+            15 => FilterKind::FeTurbulence(FeTurbulence {
+                base_frequency: Point::read(r)?,
+                num_octaves: u32::read(r)?,
+                seed: i32::read(r)?,
+                stitch_tiles: bool::read(r)?,
+                kind: FeTurbulenceKind::read(r)?,
+            }),
+            _ => return None,
+        };
+
+        Some(kind)
+    }
+}
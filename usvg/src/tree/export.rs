@@ -671,12 +671,15 @@ impl XmlWriterExt for XmlWriter {
 
     fn write_image_data(&mut self, kind: &ImageKind) {
         let svg_string;
+        let raster_data;
         let (mime, data) = match kind {
             ImageKind::JPEG(ref data) => {
-                ("jpg", data.as_slice())
+                raster_data = data.data();
+                ("jpg", raster_data.as_slice())
             }
             ImageKind::PNG(ref data) => {
-                ("png", data.as_slice())
+                raster_data = data.data();
+                ("png", raster_data.as_slice())
             }
             ImageKind::SVG(ref tree) => {
                 svg_string = tree.to_string(&XmlOptions::default());
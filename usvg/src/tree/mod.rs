@@ -4,15 +4,19 @@
 
 //! Implementation of the nodes tree.
 
-use std::cell::Ref;
+use std::cell::{Ref, RefCell};
+use std::collections::HashMap;
+use std::rc::Rc;
 
-pub use self::{nodes::*, attributes::*, pathdata::*};
+pub use self::{nodes::*, attributes::*, pathdata::*, parser::Parser};
 use crate::{svgtree, Rect, Error, Options, XmlOptions};
 
 mod attributes;
+mod binary;
 mod export;
 mod nodes;
 mod numbers;
+mod parser;
 mod pathdata;
 
 /// Basic traits for tree manipulations.
@@ -34,6 +38,10 @@ pub type Node = rctree::Node<NodeKind>;
 #[derive(Clone)]
 pub struct Tree {
     root: Node,
+    /// An ID lookup index. `None` means that lookups should walk the tree.
+    ///
+    /// Shared between clones, since they share the same nodes.
+    index: Rc<RefCell<Option<IdIndex>>>,
 }
 
 impl Tree {
@@ -42,8 +50,7 @@ impl Tree {
     /// Can contain an SVG string or a gzip compressed data.
     pub fn from_data(data: &[u8], opt: &Options) -> Result<Self, Error> {
         if data.starts_with(&[0x1f, 0x8b]) {
-            let text = deflate(data)?;
-            Self::from_str(&text, opt)
+            Self::from_string(deflate(data)?, opt)
         } else {
             let text = std::str::from_utf8(data).map_err(|_| Error::NotAnUtf8Str)?;
             Self::from_str(text, opt)
@@ -52,13 +59,19 @@ impl Tree {
 
     /// Parses `Tree` from the SVG string.
     pub fn from_str(text: &str, opt: &Options) -> Result<Self, Error> {
-        let mut xml_opt = roxmltree::ParsingOptions::default();
-        xml_opt.allow_dtd = true;
-
-        let doc = roxmltree::Document::parse_with_options(text, xml_opt)
-            .map_err(Error::ParsingFailed)?;
+        // The XML tree is no longer needed after `svgtree` was built,
+        // so deallocate it before the conversion.
+        let doc = parse_svgtree(text)?;
+        Self::from_svgtree(doc, opt)
+    }
 
-        Self::from_xmltree(&doc, opt)
+    /// Parses `Tree` from an owned SVG string.
+    ///
+    /// Unlike `from_str`, deallocates the string before the conversion.
+    pub(crate) fn from_string(text: String, opt: &Options) -> Result<Self, Error> {
+        let doc = parse_svgtree(&text)?;
+        drop(text);
+        Self::from_svgtree(doc, opt)
     }
 
     /// Parses `Tree` from `roxmltree::Document`.
@@ -80,8 +93,21 @@ impl Tree {
         let defs_node = Node::new(NodeKind::Defs);
         root_node.append(defs_node);
 
+        Tree::from_root(root_node)
+    }
+
+    /// Creates a tree from an already built nodes tree and indexes it.
+    pub(crate) fn from_root_indexed(root: Node) -> Self {
+        let tree = Tree::from_root(root);
+        tree.rebuild_id_index();
+        tree
+    }
+
+    /// Creates a tree from an already built nodes tree, without the ID index.
+    fn from_root(root: Node) -> Self {
         Tree {
-            root: root_node,
+            root,
+            index: Rc::new(RefCell::new(None)),
         }
     }
 
@@ -121,11 +147,24 @@ impl Tree {
 
         let new_node = Node::new(kind);
         self.defs().append(new_node.clone());
+
+        if let Some(ref mut index) = *self.index.borrow_mut() {
+            index_node(&mut index.defs, &new_node);
+        }
+
         new_node
     }
 
     /// Returns `defs` child node by ID.
+    ///
+    /// Uses the ID index when it's built.
     pub fn defs_by_id(&self, id: &str) -> Option<Node> {
+        if !id.is_empty() {
+            if let Some(node) = self.lookup(id, |index| &index.defs, |n| self.is_defs_child(n, id)) {
+                return node;
+            }
+        }
+
         for n in self.defs().children() {
             if &*n.id() == id {
                 return Some(n);
@@ -139,11 +178,17 @@ impl Tree {
     ///
     /// If an empty ID is provided, than this method will always return `None`.
     /// Even if tree has nodes with empty ID.
+    ///
+    /// Uses the ID index when it's built.
     pub fn node_by_id(&self, id: &str) -> Option<Node> {
         if id.is_empty() {
             return None;
         }
 
+        if let Some(node) = self.lookup(id, |index| &index.nodes, |n| self.is_renderable(n, id)) {
+            return node;
+        }
+
         for node in self.root().descendants() {
             if !self.is_in_defs(&node) && &*node.id() == id {
                     return Some(node);
@@ -153,11 +198,99 @@ impl Tree {
         None
     }
 
+    /// Builds an ID index, which makes `defs_by_id` and `node_by_id` O(1).
+    ///
+    /// Trees returned by `from_str`, `from_data`, `from_binary` and `deep_copy`
+    /// are already indexed. The index is updated by `append_to_defs`
+    /// and is rebuilt automatically when a found node was moved, removed or its ID was changed.
+    /// But nodes added or renamed via the `rctree` API directly cannot be detected,
+    /// so this method should be called after such modifications.
+    pub fn rebuild_id_index(&self) {
+        *self.index.borrow_mut() = Some(IdIndex::new(&self.root));
+    }
+
+    /// Looks up a node in the ID index.
+    ///
+    /// Returns `None` when the tree isn't indexed.
+    /// Rebuilds the index when the found node doesn't pass the `is_valid` check.
+    fn lookup(
+        &self,
+        id: &str,
+        map: impl Fn(&IdIndex) -> &HashMap<String, WeakNode>,
+        is_valid: impl Fn(&Node) -> bool,
+    ) -> Option<Option<Node>> {
+        let node = map(self.index.borrow().as_ref()?).get(id).map(|n| n.upgrade());
+        match node {
+            Some(Some(node)) if is_valid(&node) => Some(Some(node)),
+            None => Some(None),
+            // The node was modified or removed from the tree and deallocated.
+            _ => {
+                self.rebuild_id_index();
+                Some(map(self.index.borrow().as_ref()?).get(id).and_then(|n| n.upgrade()))
+            }
+        }
+    }
+
+    fn is_defs_child(&self, node: &Node, id: &str) -> bool {
+        &*node.id() == id && node.parent() == Some(self.defs())
+    }
+
+    fn is_renderable(&self, node: &Node, id: &str) -> bool {
+        if &*node.id() != id {
+            return false;
+        }
+
+        let defs = self.defs();
+        let mut top = node.clone();
+        for n in node.ancestors() {
+            if n == defs {
+                return false;
+            }
+
+            top = n;
+        }
+
+        top == self.root
+    }
+
+    /// Creates a deep copy of the tree.
+    ///
+    /// Unlike `clone()`, which simply increments a reference counter,
+    /// the returned tree doesn't share any reference counted data with the original one,
+    /// including paths data and nested SVG images.
+    /// Which makes it safe to move the copy to another thread.
+    ///
+    /// Raster images data is immutable and atomically reference counted,
+    /// so it's shared between copies, and a lazily decoded image is decoded only once.
+    pub fn deep_copy(&self) -> Tree {
+        Tree::from_root_indexed(deep_copy_node(&self.root))
+    }
+
     /// Converts an SVG.
     #[inline]
     pub fn to_string(&self, opt: &XmlOptions) -> String {
         export::convert(self, opt)
     }
+
+    /// Serializes the tree into a compact binary format.
+    ///
+    /// Unlike `to_string`, the result can be loaded via `from_binary`
+    /// without any parsing or conversion.
+    ///
+    /// The format is versioned, but not stable between `usvg` versions.
+    #[inline]
+    pub fn to_binary(&self) -> Vec<u8> {
+        binary::write(self)
+    }
+
+    /// Loads a tree serialized via `to_binary`.
+    ///
+    /// The data isn't referenced after loading,
+    /// so it can be a memory-mapped file.
+    #[inline]
+    pub fn from_binary(data: &[u8]) -> Result<Self, Error> {
+        binary::read(data)
+    }
 }
 
 /// Additional `Node` methods.
@@ -246,7 +379,7 @@ impl NodeExt for Node {
 
     #[inline]
     fn tree(&self) -> Tree {
-        Tree { root: self.root() }
+        Tree::from_root(self.root())
     }
 
     #[inline]
@@ -275,6 +408,16 @@ impl NodeExt for Node {
     }
 }
 
+fn parse_svgtree(text: &str) -> Result<svgtree::Document, Error> {
+    let mut xml_opt = roxmltree::ParsingOptions::default();
+    xml_opt.allow_dtd = true;
+
+    let xml = roxmltree::Document::parse_with_options(text, xml_opt)
+        .map_err(Error::ParsingFailed)?;
+
+    svgtree::Document::parse(&xml)
+}
+
 fn deflate(data: &[u8]) -> Result<String, Error> {
     use std::io::Read;
 
@@ -285,6 +428,92 @@ fn deflate(data: &[u8]) -> Result<String, Error> {
     Ok(decoded)
 }
 
+type WeakNode = rctree::WeakNode<NodeKind>;
+
+/// An ID to node lookup table.
+///
+/// Stores weak references, so removed nodes are not kept alive by the index.
+#[derive(Default)]
+struct IdIndex {
+    /// `defs` children.
+    defs: HashMap<String, WeakNode>,
+    /// Nodes outside `defs`.
+    nodes: HashMap<String, WeakNode>,
+}
+
+impl IdIndex {
+    fn new(root: &Node) -> Self {
+        let mut index = IdIndex::default();
+        let defs = root.first_child();
+        for child in root.children() {
+            if Some(&child) == defs.as_ref() {
+                for n in child.children() {
+                    index_node(&mut index.defs, &n);
+                }
+            } else {
+                for n in child.descendants() {
+                    index_node(&mut index.nodes, &n);
+                }
+            }
+        }
+
+        index
+    }
+}
+
+/// Adds a node to the index, unless a node with the same ID is already present,
+/// since lookups return the first matching node in the tree order.
+fn index_node(map: &mut HashMap<String, WeakNode>, node: &Node) {
+    let id = node.id().to_string();
+    if !id.is_empty() {
+        map.entry(id).or_insert_with(|| node.downgrade());
+    }
+}
+
+fn deep_copy_node(node: &Node) -> Node {
+    let mut new_node = Node::new(deep_copy_kind(&node.borrow()));
+    for child in node.children() {
+        new_node.append(deep_copy_node(&child));
+    }
+
+    new_node
+}
+
+fn deep_copy_kind(kind: &NodeKind) -> NodeKind {
+    match *kind {
+        NodeKind::Path(ref path) => {
+            let mut path = path.clone();
+            path.data = Rc::new(PathData::clone(&path.data));
+            NodeKind::Path(path)
+        }
+        NodeKind::Image(ref img) => {
+            let mut img = img.clone();
+            img.kind = deep_copy_image_kind(&img.kind);
+            NodeKind::Image(img)
+        }
+        NodeKind::Filter(ref filter) => {
+            let mut filter = filter.clone();
+            for primitive in &mut filter.children {
+                if let FilterKind::FeImage(ref mut fe) = primitive.kind {
+                    if let FeImageKind::Image(ref mut kind) = fe.data {
+                        *kind = deep_copy_image_kind(kind);
+                    }
+                }
+            }
+
+            NodeKind::Filter(filter)
+        }
+        _ => kind.clone(),
+    }
+}
+
+fn deep_copy_image_kind(kind: &ImageKind) -> ImageKind {
+    match *kind {
+        ImageKind::SVG(ref tree) => ImageKind::SVG(tree.deep_copy()),
+        _ => kind.clone(),
+    }
+}
+
 fn calc_node_bbox(
     node: &Node,
     ts: Transform,
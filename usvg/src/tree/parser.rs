@@ -0,0 +1,95 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+use std::io::Write;
+
+use crate::{Error, Options, Tree};
+
+/// An incremental SVG data loader.
+///
+/// Accepts SVG data in chunks, like when reading from a file or a network,
+/// so the caller doesn't have to keep the whole file in memory.
+/// A gzip compressed data is decompressed on the fly.
+///
+/// XML parsing still requires the whole document text, so it's done by `finish`.
+/// Intermediate representations are deallocated as soon as they are no longer needed.
+///
+/// # Examples
+///
+/// ```no_run
+/// let mut parser = usvg::Parser::new();
+/// parser.feed(b"<svg xmlns='http://www.w3.org/2000/svg'")?;
+/// parser.feed(b" width='10' height='10'/>")?;
+/// let tree = parser.finish(&usvg::Options::default())?;
+/// # Ok::<(), usvg::Error>(())
+/// ```
+#[derive(Debug)]
+pub struct Parser {
+    state: State,
+}
+
+#[derive(Debug)]
+enum State {
+    /// Not enough data to detect compression yet.
+    Detecting(Vec<u8>),
+    Plain(Vec<u8>),
+    Gzip(flate2::write::GzDecoder<Vec<u8>>),
+}
+
+impl Parser {
+    /// Creates a new parser.
+    pub fn new() -> Self {
+        Parser {
+            state: State::Detecting(Vec::new()),
+        }
+    }
+
+    /// Appends a chunk of SVG data.
+    ///
+    /// Returns `Error::MalformedGZip` when compressed data cannot be decompressed.
+    pub fn feed(&mut self, data: &[u8]) -> Result<(), Error> {
+        match self.state {
+            State::Detecting(ref mut buf) => {
+                buf.extend_from_slice(data);
+                if buf.len() < 2 {
+                    return Ok(());
+                }
+
+                let buf = std::mem::replace(buf, Vec::new());
+                if buf.starts_with(&[0x1f, 0x8b]) {
+                    let mut decoder = flate2::write::GzDecoder::new(Vec::new());
+                    decoder.write_all(&buf).map_err(|_| Error::MalformedGZip)?;
+                    self.state = State::Gzip(decoder);
+                } else {
+                    self.state = State::Plain(buf);
+                }
+            }
+            State::Plain(ref mut buf) => {
+                buf.extend_from_slice(data);
+            }
+            State::Gzip(ref mut decoder) => {
+                decoder.write_all(data).map_err(|_| Error::MalformedGZip)?;
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Parses accumulated data into a `Tree`.
+    pub fn finish(self, opt: &Options) -> Result<Tree, Error> {
+        let data = match self.state {
+            State::Detecting(buf) | State::Plain(buf) => buf,
+            State::Gzip(decoder) => decoder.finish().map_err(|_| Error::MalformedGZip)?,
+        };
+
+        let text = String::from_utf8(data).map_err(|_| Error::NotAnUtf8Str)?;
+        Tree::from_string(text, opt)
+    }
+}
+
+impl Default for Parser {
+    fn default() -> Self {
+        Parser::new()
+    }
+}
@@ -136,3 +136,154 @@ test_size_err!(size_detection_err_1,
 
 test_size_err!(size_detection_err_2,
     "<svg width='0' height='0' viewBox='0 0 10 20' xmlns='http://www.w3.org/2000/svg'>");
+
+fn binary_test_files() -> Vec<std::path::PathBuf> {
+    let mut files = Vec::new();
+    for dir in &["tests/files", "../tests/svg"] {
+        for entry in std::fs::read_dir(dir).unwrap() {
+            let path = entry.unwrap().path();
+            if path.extension().and_then(|e| e.to_str()) == Some("svg") {
+                files.push(path);
+            }
+        }
+    }
+
+    files.sort();
+    files
+}
+
+#[test]
+fn binary_round_trip() {
+    let opt = usvg::Options {
+        resources_dir: Some(std::path::PathBuf::from("../tests/svg")),
+        .. usvg::Options::default()
+    };
+
+    for path in binary_test_files() {
+        let data = std::fs::read(&path).unwrap();
+        let tree = match usvg::Tree::from_data(&data, &opt) {
+            Ok(tree) => tree,
+            Err(_) => continue,
+        };
+
+        let binary = tree.to_binary();
+        let loaded = usvg::Tree::from_binary(&binary).unwrap();
+        let xml_opt = usvg::XmlOptions::default();
+        assert_eq!(MStr(&loaded.to_string(&xml_opt)), MStr(&tree.to_string(&xml_opt)), "{:?}", path);
+        assert!(loaded.to_binary() == binary, "{:?}", path);
+    }
+}
+
+#[test]
+fn binary_truncated() {
+    let data = std::fs::read("tests/files/groups-in.svg").unwrap();
+    let binary = usvg::Tree::from_data(&data, &usvg::Options::default()).unwrap().to_binary();
+    for len in 0..binary.len() {
+        assert!(matches!(usvg::Tree::from_binary(&binary[..len]), Err(usvg::Error::InvalidBinary)));
+    }
+
+    let mut extended = binary.clone();
+    extended.push(0);
+    assert!(matches!(usvg::Tree::from_binary(&extended), Err(usvg::Error::InvalidBinary)));
+}
+
+#[test]
+fn binary_corrupted() {
+    let data = std::fs::read("tests/files/groups-in.svg").unwrap();
+    let binary = usvg::Tree::from_data(&data, &usvg::Options::default()).unwrap().to_binary();
+
+    // Any corruption must be either rejected or loaded, but never panic.
+    for i in 0..binary.len() {
+        for mask in &[0x01, 0x80, 0xFF] {
+            let mut corrupted = binary.clone();
+            corrupted[i] ^= mask;
+            let _ = usvg::Tree::from_binary(&corrupted);
+        }
+    }
+
+    // A wrong version.
+    let mut corrupted = binary.clone();
+    corrupted[4] = corrupted[4].wrapping_add(1);
+    assert!(matches!(usvg::Tree::from_binary(&corrupted), Err(usvg::Error::InvalidBinary)));
+}
+
+#[test]
+fn image_data_is_shared() {
+    let data = std::fs::read("../tests/svg/e-image-001.svg").unwrap();
+    let opt = usvg::Options {
+        resources_dir: Some(std::path::PathBuf::from("../tests/svg")),
+        .. usvg::Options::default()
+    };
+    let tree = usvg::Tree::from_data(&data, &opt).unwrap();
+    let copy = tree.deep_copy();
+
+    let image_data = |tree: &usvg::Tree| {
+        tree.root().descendants().find_map(|node| match *node.borrow() {
+            usvg::NodeKind::Image(ref img) => match img.kind {
+                usvg::ImageKind::JPEG(ref data) | usvg::ImageKind::PNG(ref data) => Some(data.data()),
+                _ => None,
+            },
+            _ => None,
+        }).unwrap()
+    };
+
+    assert!(std::sync::Arc::ptr_eq(&image_data(&tree), &image_data(&copy)));
+}
+
+#[test]
+fn embedded_image_is_decoded_lazily() {
+    let svg = "<svg width='10' height='10' xmlns='http://www.w3.org/2000/svg' \
+               xmlns:xlink='http://www.w3.org/1999/xlink'>\
+               <image width='10' height='10' xlink:href='data:image/png;base64,iVBORw0KGgo='/></svg>";
+    let tree = usvg::Tree::from_str(svg, &usvg::Options::default()).unwrap();
+    let copy = tree.deep_copy();
+
+    let image_data = |tree: &usvg::Tree| {
+        tree.root().descendants().find_map(|node| match *node.borrow() {
+            usvg::NodeKind::Image(ref img) => match img.kind {
+                usvg::ImageKind::PNG(ref data) => Some(data.clone()),
+                _ => None,
+            },
+            _ => None,
+        }).unwrap()
+    };
+
+    let data = image_data(&tree);
+    assert!(!data.is_decoded());
+    assert_eq!(&data.data()[..], b"\x89PNG\r\n\x1a\n");
+
+    // Copies share the decoded bytes.
+    let copied = image_data(&copy);
+    assert!(copied.is_decoded());
+    assert!(std::sync::Arc::ptr_eq(&data.data(), &copied.data()));
+}
+
+#[test]
+fn invalid_data_url() {
+    let svg = "<svg width='10' height='10' xmlns='http://www.w3.org/2000/svg' \
+               xmlns:xlink='http://www.w3.org/1999/xlink'>\
+               <image width='10' height='10' xlink:href='data:image/png;base64,@@@@'/></svg>";
+    let tree = usvg::Tree::from_str(svg, &usvg::Options::default()).unwrap();
+    assert!(!tree.root().descendants().any(|n| matches!(*n.borrow(), usvg::NodeKind::Image(_))));
+}
+
+#[test]
+fn id_index() {
+    let svg = "<svg width='10' height='10' xmlns='http://www.w3.org/2000/svg'>\
+               <linearGradient id='lg1'><stop offset='0'/><stop offset='1' stop-color='red'/></linearGradient>\
+               <rect id='rect1' width='10' height='10' fill='url(#lg1)'/>\
+               <rect id='rect2' width='5' height='5'/></svg>";
+    let tree = usvg::Tree::from_str(svg, &usvg::Options::default()).unwrap();
+    assert!(tree.defs_by_id("lg1").is_some());
+    assert!(tree.node_by_id("lg1").is_none());
+    assert!(tree.node_by_id("rect2").is_some());
+
+    // The index must not keep removed nodes alive.
+    let mut node = tree.node_by_id("rect1").unwrap();
+    let weak = node.downgrade();
+    node.detach();
+    drop(node);
+    assert!(weak.upgrade().is_none());
+    assert!(tree.node_by_id("rect1").is_none());
+    assert!(tree.node_by_id("rect2").is_some());
+}